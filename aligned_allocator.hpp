@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+// Allocates blocks aligned to Alignment bytes (a cache line by default).
+// Requests of at least a page are page aligned, so big Deque buckets never
+// share a page with their neighbours. Deques using it get buckets of about
+// BucketBytes bytes rather than the default 8 elements.
+template <typename T, size_t Alignment = 64, size_t BucketBytes = 512>
+struct AlignedAllocator {
+  static_assert((Alignment & (Alignment - 1)) == 0,
+                "Alignment must be a power of two");
+
+  using value_type = T;
+
+  static constexpr size_t kPageSize = 4096;
+  static constexpr size_t kBucketBytes = BucketBytes;
+
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment, BucketBytes>;
+  };
+
+  AlignedAllocator() = default;
+
+  template <typename U>
+  AlignedAllocator(
+      const AlignedAllocator<U, Alignment, BucketBytes>& /*other*/) {}
+
+  T* allocate(size_t count) {
+    return static_cast<T*>(
+        ::operator new(count * sizeof(T), std::align_val_t{alignment(count)}));
+  }
+
+  void deallocate(T* ptr, size_t count) {
+    ::operator delete(ptr, std::align_val_t{alignment(count)});
+  }
+
+  template <typename U>
+  bool operator==(
+      const AlignedAllocator<U, Alignment, BucketBytes>& /*other*/) const {
+    return true;
+  }
+
+ private:
+  static constexpr size_t alignment(size_t count) {
+    size_t align = Alignment < alignof(T) ? alignof(T) : Alignment;
+    if (count * sizeof(T) >= kPageSize && align < kPageSize) {
+      return kPageSize;
+    }
+    return align;
+  }
+};
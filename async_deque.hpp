@@ -0,0 +1,307 @@
+#pragma once
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+#include "deque.hpp"
+
+namespace deque_async {
+
+// Fire-and-forget coroutine owned by a LocalExecutor. It starts suspended
+// and is first resumed by the executor.
+class Task {
+ public:
+  struct promise_type {
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { exception = std::current_exception(); }
+
+    std::exception_ptr exception;
+  };
+
+  Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  Task& operator=(Task&& other) noexcept;
+
+  ~Task();
+
+ private:
+  friend class LocalExecutor;
+
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+// Single-threaded run queue. Everything that touches an AsyncDeque bound to
+// this executor must run on the thread calling run().
+class LocalExecutor {
+ public:
+  LocalExecutor() = default;
+
+  LocalExecutor(const LocalExecutor&) = delete;
+  LocalExecutor& operator=(const LocalExecutor&) = delete;
+
+  void spawn(Task task);
+
+  void schedule(std::coroutine_handle<> handle) { ready_.push_back(handle); }
+
+  // Resumes coroutines until none is ready, then drops finished tasks and
+  // rethrows the first exception one of them ended with.
+  void run();
+
+  [[nodiscard]] size_t pending() const { return tasks_.size(); }
+
+ private:
+  Deque<std::coroutine_handle<>> ready_;
+  std::vector<Task> tasks_;
+};
+
+// Deque shared between coroutines. pop_front()/pop_back() suspend while the
+// deque is empty and push_back()/push_front() suspend while it holds
+// capacity items. Items handed to a waiting popper go straight into its
+// awaiter, and every resumed coroutine goes through the executor's queue
+// rather than running inside the call that woke it. Awaiters must not be
+// destroyed while suspended on the deque.
+template <typename T, typename Allocator = std::allocator<T>>
+class AsyncDeque {
+ public:
+  class PopAwaiter;
+  class PushAwaiter;
+
+  explicit AsyncDeque(LocalExecutor& executor, size_t capacity = SIZE_MAX,
+                      const Allocator& alloc = Allocator());
+
+  AsyncDeque(const AsyncDeque&) = delete;
+  AsyncDeque& operator=(const AsyncDeque&) = delete;
+
+  [[nodiscard]] size_t size() const { return items_.size(); }
+  [[nodiscard]] bool empty() const { return items_.empty(); }
+  [[nodiscard]] size_t capacity() const { return capacity_; }
+
+  [[nodiscard]] PushAwaiter push_back(T value) {
+    return PushAwaiter(this, std::move(value), false);
+  }
+  [[nodiscard]] PushAwaiter push_front(T value) {
+    return PushAwaiter(this, std::move(value), true);
+  }
+
+  [[nodiscard]] PopAwaiter pop_front() { return PopAwaiter(this, true); }
+  [[nodiscard]] PopAwaiter pop_back() { return PopAwaiter(this, false); }
+
+  std::optional<T> try_pop_front();
+  std::optional<T> try_pop_back();
+
+  // Appends items until the deque is full and returns how many were taken.
+  // Waiting poppers are served first and all of them are scheduled in one
+  // pass.
+  template <std::ranges::input_range Range>
+  size_t append_range(Range&& range);
+
+ private:
+  bool offer(T& value, bool front);
+  bool take(std::optional<T>& slot, bool front);
+  void admit_pusher();
+
+  Deque<T, Allocator> items_;
+  Deque<PopAwaiter*> pop_waiters_;
+  Deque<PushAwaiter*> push_waiters_;
+  LocalExecutor& executor_;
+  size_t capacity_;
+};
+
+template <typename T, typename Allocator>
+class AsyncDeque<T, Allocator>::PopAwaiter {
+ public:
+  bool await_ready() { return owner_->take(slot_, front_); }
+  void await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    owner_->pop_waiters_.push_back(this);
+  }
+  T await_resume() { return std::move(*slot_); }
+
+ private:
+  friend class AsyncDeque;
+
+  PopAwaiter(AsyncDeque* owner, bool front) : owner_(owner), front_(front) {}
+
+  AsyncDeque* owner_;
+  bool front_;
+  std::optional<T> slot_;
+  std::coroutine_handle<> handle_;
+};
+
+template <typename T, typename Allocator>
+class AsyncDeque<T, Allocator>::PushAwaiter {
+ public:
+  bool await_ready() { return owner_->offer(value_, front_); }
+  void await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    owner_->push_waiters_.push_back(this);
+  }
+  void await_resume() {}
+
+ private:
+  friend class AsyncDeque;
+
+  PushAwaiter(AsyncDeque* owner, T&& value, bool front)
+      : owner_(owner), front_(front), value_(std::move(value)) {}
+
+  AsyncDeque* owner_;
+  bool front_;
+  T value_;
+  std::coroutine_handle<> handle_;
+};
+
+// Task
+
+inline Task& Task::operator=(Task&& other) noexcept {
+  if (this != &other) {
+    if (handle_) {
+      handle_.destroy();
+    }
+    handle_ = std::exchange(other.handle_, {});
+  }
+  return *this;
+}
+
+inline Task::~Task() {
+  if (handle_) {
+    handle_.destroy();
+  }
+}
+
+// LocalExecutor
+
+inline void LocalExecutor::spawn(Task task) {
+  schedule(task.handle_);
+  tasks_.push_back(std::move(task));
+}
+
+inline void LocalExecutor::run() {
+  while (!ready_.empty()) {
+    auto handle = *ready_.begin();
+    ready_.pop_front();
+    handle.resume();
+  }
+  std::exception_ptr error;
+  std::erase_if(tasks_, [&error](const Task& task) {
+    if (!task.handle_.done()) {
+      return false;
+    }
+    if (!error) {
+      error = task.handle_.promise().exception;
+    }
+    return true;
+  });
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+// AsyncDeque
+
+template <typename T, typename Allocator>
+AsyncDeque<T, Allocator>::AsyncDeque(LocalExecutor& executor, size_t capacity,
+                                     const Allocator& alloc)
+    : items_(alloc), executor_(executor), capacity_(capacity) {}
+
+template <typename T, typename Allocator>
+std::optional<T> AsyncDeque<T, Allocator>::try_pop_front() {
+  std::optional<T> slot;
+  take(slot, true);
+  return slot;
+}
+
+template <typename T, typename Allocator>
+std::optional<T> AsyncDeque<T, Allocator>::try_pop_back() {
+  std::optional<T> slot;
+  take(slot, false);
+  return slot;
+}
+
+template <typename T, typename Allocator>
+template <std::ranges::input_range Range>
+size_t AsyncDeque<T, Allocator>::append_range(Range&& range) {
+  size_t taken = 0;
+  for (auto&& value : range) {
+    if (pop_waiters_.empty() && items_.size() >= capacity_) {
+      break;
+    }
+    T item(std::forward<decltype(value)>(value));
+    offer(item, false);
+    ++taken;
+  }
+  return taken;
+}
+
+// Hands value to the oldest waiting popper, or stores it if there is room.
+template <typename T, typename Allocator>
+bool AsyncDeque<T, Allocator>::offer(T& value, bool front) {
+  if (!pop_waiters_.empty()) {
+    PopAwaiter* waiter = *pop_waiters_.begin();
+    pop_waiters_.pop_front();
+    waiter->slot_.emplace(std::move(value));
+    executor_.schedule(waiter->handle_);
+    return true;
+  }
+  if (items_.size() >= capacity_) {
+    return false;
+  }
+  if (front) {
+    items_.push_front(std::move(value));
+  } else {
+    items_.push_back(std::move(value));
+  }
+  return true;
+}
+
+// Takes an item, or the value of the oldest waiting pusher when the deque
+// is empty (which only happens with a capacity of zero).
+template <typename T, typename Allocator>
+bool AsyncDeque<T, Allocator>::take(std::optional<T>& slot, bool front) {
+  if (!items_.empty()) {
+    if (front) {
+      slot.emplace(std::move(*items_.begin()));
+      items_.pop_front();
+    } else {
+      slot.emplace(std::move(*(items_.end() - 1)));
+      items_.pop_back();
+    }
+    admit_pusher();
+    return true;
+  }
+  if (!push_waiters_.empty()) {
+    PushAwaiter* waiter = *push_waiters_.begin();
+    push_waiters_.pop_front();
+    slot.emplace(std::move(waiter->value_));
+    executor_.schedule(waiter->handle_);
+    return true;
+  }
+  return false;
+}
+
+template <typename T, typename Allocator>
+void AsyncDeque<T, Allocator>::admit_pusher() {
+  if (push_waiters_.empty() || items_.size() >= capacity_) {
+    return;
+  }
+  PushAwaiter* waiter = *push_waiters_.begin();
+  push_waiters_.pop_front();
+  if (waiter->front_) {
+    items_.push_front(std::move(waiter->value_));
+  } else {
+    items_.push_back(std::move(waiter->value_));
+  }
+  executor_.schedule(waiter->handle_);
+}
+
+}  // namespace deque_async
@@ -0,0 +1,637 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "aligned_allocator.hpp"
+#include "deque.hpp"
+#include "deque_par.hpp"
+#include "deque_scatter.hpp"
+#include "deque_simd.hpp"
+#include "packed_deque.hpp"
+#include "persistent_deque.hpp"
+#include "sorted_deque.hpp"
+#include "spilling_deque.hpp"
+#include "swmr_deque.hpp"
+#include "tree_deque.hpp"
+#include "var_deque.hpp"
+#include "window_deque.hpp"
+
+static constexpr size_t kRepetitions = 5;
+static constexpr size_t kFlushBytes = size_t{64} << 20;
+static constexpr size_t kParallelElements = size_t{1} << 22;
+static constexpr size_t kKernelElements = size_t{1} << 16;
+static constexpr size_t kColdElements = size_t{1} << 22;
+static constexpr size_t kTreeEdits = size_t{1} << 8;
+static constexpr size_t kVersions = size_t{1} << 16;
+static constexpr size_t kEvents = 20'000'000;
+static constexpr size_t kRangeQueries = size_t{1} << 16;
+static constexpr size_t kWindowSlides = size_t{1} << 20;
+static constexpr size_t kInsertBase = size_t{1} << 16;
+static constexpr size_t kMiddleInserts = size_t{1} << 10;
+static constexpr size_t kSpillElements = size_t{1} << 24;
+static constexpr size_t kSpillBudget = size_t{16} << 20;
+static constexpr size_t kScatterElements = size_t{1} << 22;
+static constexpr size_t kRecords = size_t{1} << 20;
+static constexpr size_t kQueuedRecords = size_t{1} << 12;
+static constexpr auto kWriterTime = std::chrono::milliseconds(200);
+static constexpr size_t kHistory = size_t{1} << 14;
+static constexpr size_t kRecentReads = 1024;
+static constexpr size_t kFlags = size_t{1} << 24;
+
+// Three ints: 12 bytes, so unaligned blocks often start mid cache line.
+struct Sample {
+  int32_t key;
+  int32_t value;
+  int32_t weight;
+};
+
+// Owning handles that differ only in whether Deque may relocate them.
+struct Handle {
+  std::unique_ptr<int64_t> value;
+};
+
+struct RelocatableHandle {
+  std::unique_ptr<int64_t> value;
+};
+
+template <>
+struct is_trivially_relocatable<RelocatableHandle> : std::true_type {};
+
+volatile int64_t sink = 0;
+
+void FlushCaches() {
+  static std::vector<char> garbage(kFlushBytes);
+  for (size_t idx = 0; idx < garbage.size(); idx += 64) {
+    garbage[idx] = static_cast<char>(garbage[idx] + 1);
+  }
+  sink = sink + garbage[garbage.size() / 2];
+}
+
+template <typename Func>
+double MedianNsPerOp(size_t ops, bool cold, Func func) {
+  std::vector<double> samples;
+  for (size_t rep = 0; rep < kRepetitions; ++rep) {
+    if (cold) {
+      FlushCaches();
+    }
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto stop = std::chrono::steady_clock::now();
+    samples.push_back(
+        std::chrono::duration<double, std::nano>(stop - start).count() /
+        static_cast<double>(ops));
+  }
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+void Report(const std::string& name, double ns_per_op) {
+  std::cout << std::left << std::setw(48) << name << std::right
+            << std::setw(10) << std::fixed << std::setprecision(3)
+            << ns_per_op << " ns/op\n";
+}
+
+// reduce and transform over the same kParallelElements on a pool of
+// `threads`. Rows past the hardware thread count show oversubscription
+// rather than speedup.
+void BenchParallel(const Deque<int64_t>& source, Deque<int64_t>& dest,
+                   size_t threads) {
+  deque_par::ThreadPool pool(threads);
+  std::string label =
+      std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+  Report(label + " reduce", MedianNsPerOp(kParallelElements, false, [&] {
+           sink = sink + deque_par::reduce(source, int64_t{0}, std::plus<>(),
+                                           pool);
+         }));
+  Report(label + " transform", MedianNsPerOp(kParallelElements, false, [&] {
+           deque_par::transform(
+               source, dest, [](int64_t value) { return value * 3; }, pool);
+           sink = sink + dest[dest.size() / 2];
+         }));
+}
+
+// sum, count_if and find over kKernelElements warm elements, through the
+// portable kernels and through the set Dispatch picks for this CPU. Both
+// walk the same segments, so the difference is the kernels alone.
+template <typename T>
+void BenchKernels(const std::string& label) {
+  using Scalar = deque_simd::detail::ScalarKernels<T>;
+  Deque<T, deque_simd::SimdAllocator<T>> deque;
+  for (size_t idx = 0; idx < kKernelElements; ++idx) {
+    deque.push_back(static_cast<T>(idx % 1000));
+  }
+  auto each_segment = [&deque](auto kernel) {
+    for (size_t seg = 0; seg < deque.segment_count(); ++seg) {
+      auto span = deque.segment(seg);
+      kernel(span.data(), span.size());
+    }
+  };
+  const T threshold = 500;
+  const T missing = 1000;
+  Report(label + " sum scalar", MedianNsPerOp(kKernelElements, false, [&] {
+           deque_simd::SumType<T> total{};
+           each_segment([&](const T* data, size_t count) {
+             total += Scalar::sum(data, count);
+           });
+           sink = sink + static_cast<int64_t>(total);
+         }));
+  Report(label + " sum dispatched",
+         MedianNsPerOp(kKernelElements, false, [&] {
+           sink = sink + static_cast<int64_t>(deque_simd::sum(deque));
+         }));
+  Report(label + " count_if scalar",
+         MedianNsPerOp(kKernelElements, false, [&] {
+           size_t total = 0;
+           each_segment([&](const T* data, size_t count) {
+             total += Scalar::count(data, count, deque_simd::Compare::kLess,
+                                    threshold);
+           });
+           sink = sink + static_cast<int64_t>(total);
+         }));
+  Report(label + " count_if dispatched",
+         MedianNsPerOp(kKernelElements, false, [&] {
+           sink = sink + static_cast<int64_t>(deque_simd::count_if(
+                             deque, deque_simd::Compare::kLess, threshold));
+         }));
+  Report(label + " find scalar", MedianNsPerOp(kKernelElements, false, [&] {
+           size_t seen = 0;
+           each_segment([&](const T* data, size_t count) {
+             seen += Scalar::find(data, count, missing);
+           });
+           sink = sink + static_cast<int64_t>(seen);
+         }));
+  Report(label + " find dispatched",
+         MedianNsPerOp(kKernelElements, false, [&] {
+           sink = sink + (deque_simd::find(deque, missing) - deque.cbegin());
+         }));
+}
+
+template <typename Deq>
+void BenchColdTraversal(const std::string& label) {
+  Deq deque;
+  for (size_t idx = 0; idx < kColdElements; ++idx) {
+    auto key = static_cast<int32_t>(idx);
+    deque.push_back(Sample{key, key * 3, 1});
+  }
+  Report(label + " iterator", MedianNsPerOp(kColdElements, true, [&] {
+           int64_t total = 0;
+           for (const auto& sample : deque) {
+             total += sample.value;
+           }
+           sink = sink + total;
+         }));
+  Report(label + " segments", MedianNsPerOp(kColdElements, true, [&] {
+           int64_t total = 0;
+           for (size_t seg = 0; seg < deque.segment_count(); ++seg) {
+             deque.prefetch_segment(seg + 1);
+             for (const auto& sample : deque.segment(seg)) {
+               total += sample.value;
+             }
+           }
+           sink = sink + total;
+         }));
+}
+
+template <typename Deq>
+void BenchColdSum(const std::string& label) {
+  Deq deque;
+  for (size_t idx = 0; idx < kColdElements; ++idx) {
+    deque.push_back(static_cast<int32_t>(idx));
+  }
+  Report(label + " simd sum", MedianNsPerOp(kColdElements, true, [&] {
+           sink = sink + deque_simd::sum(deque);
+         }));
+}
+
+// Inserts and erases at random interior positions of a deque of size
+// elements, then reads random indices: O(log n) for TreeDeque, where Deque
+// shifts half the elements on every edit.
+template <typename Deq>
+void BenchTreeEdits(const std::string& label, size_t size) {
+  Deq deque;
+  for (size_t idx = 0; idx < size; ++idx) {
+    deque.push_back(static_cast<int64_t>(idx));
+  }
+  std::mt19937_64 rng(1);
+  std::vector<size_t> positions(kTreeEdits);
+  for (auto& pos : positions) {
+    pos = (size / 4) + (rng() % (size / 2));
+  }
+  Report(label + " insert+erase", MedianNsPerOp(kTreeEdits, false, [&] {
+           for (size_t pos : positions) {
+             deque.insert(deque.begin() + pos, int64_t{-1});
+             deque.erase(deque.begin() + pos + 1);
+           }
+         }));
+  Report(label + " random index", MedianNsPerOp(kTreeEdits, false, [&] {
+           int64_t total = 0;
+           for (size_t pos : positions) {
+             total += deque[pos];
+           }
+           sink = sink + total;
+         }));
+}
+
+// Replaces the back element kVersions times, each time keeping only the new
+// version, so the popped slot is reused in place. The cost should not grow
+// with the size of the deque.
+void BenchPersistentChurn(size_t size) {
+  PersistentDeque<int64_t> deque;
+  for (size_t idx = 0; idx < size; ++idx) {
+    deque = deque.push_back(static_cast<int64_t>(idx));
+  }
+  Report("PersistentDeque pop_back+push_back, " + std::to_string(size),
+         MedianNsPerOp(kVersions, false, [&] {
+           for (size_t idx = 0; idx < kVersions; ++idx) {
+             deque = deque.pop_back().push_back(static_cast<int64_t>(idx));
+           }
+         }));
+  Report("PersistentDeque pop_front+push_front, " + std::to_string(size),
+         MedianNsPerOp(kVersions, false, [&] {
+           for (size_t idx = 0; idx < kVersions; ++idx) {
+             deque = deque.pop_front().push_front(static_cast<int64_t>(idx));
+           }
+         }));
+}
+
+// Time-range queries over kEvents timestamps, 10 apart.
+void BenchSortedRange() {
+  SortedDeque<int64_t> events;
+  for (size_t idx = 0; idx < kEvents; ++idx) {
+    events.push_back(static_cast<int64_t>(idx * 10));
+  }
+  std::mt19937_64 rng(1);
+  std::vector<int64_t> starts(kRangeQueries);
+  for (auto& start : starts) {
+    start = static_cast<int64_t>(rng() % (kEvents * 10));
+  }
+  Report("SortedDeque range", MedianNsPerOp(kRangeQueries, false, [&] {
+           int64_t total = 0;
+           for (int64_t start : starts) {
+             total += std::ranges::distance(events.range(start, start + 1000));
+           }
+           sink = sink + total;
+         }));
+}
+
+// Ticks of a sliding window: push one value, drop the oldest, read the
+// aggregate. Recomputing over a Deque gets fewer ticks as windows grow.
+template <typename Monoid>
+void BenchWindow(const std::string& label, size_t window) {
+  WindowDeque<int64_t, Monoid> running;
+  Deque<int64_t> plain;
+  for (size_t idx = 0; idx < window; ++idx) {
+    auto value = static_cast<int64_t>((idx * 7919) % 1000);
+    running.push_back(value);
+    plain.push_back(value);
+  }
+  Monoid monoid;
+  int64_t next = 0;
+  Report(label + " WindowDeque", MedianNsPerOp(kWindowSlides, false, [&] {
+           for (size_t tick = 0; tick < kWindowSlides; ++tick) {
+             running.slide((next++ * 7919) % 1000, window);
+             sink = sink + running.aggregate();
+           }
+         }));
+  size_t ticks =
+      std::max<size_t>(1, std::min(kWindowSlides, (size_t{1} << 26) / window));
+  Report(label + " recompute", MedianNsPerOp(ticks, false, [&] {
+           for (size_t tick = 0; tick < ticks; ++tick) {
+             plain.push_back((next++ * 7919) % 1000);
+             plain.pop_front();
+             auto total = monoid.identity();
+             for (int64_t value : plain) {
+               total = monoid.combine(total, value);
+             }
+             sink = sink + total;
+           }
+         }));
+}
+
+// Inserts into the middle of a deque of kInsertBase elements, then erases
+// them again, so every repetition shifts the same amount.
+template <typename T, typename Make>
+void BenchMiddleInsert(const std::string& label, Make make) {
+  Deque<T> deque;
+  for (size_t idx = 0; idx < kInsertBase; ++idx) {
+    deque.push_back(make(idx));
+  }
+  Report(label + " middle insert+erase",
+         MedianNsPerOp(kMiddleInserts, false, [&] {
+           for (size_t idx = 0; idx < kMiddleInserts; ++idx) {
+             deque.insert(deque.begin() + (deque.size() / 2), make(idx));
+           }
+           for (size_t idx = 0; idx < kMiddleInserts; ++idx) {
+             deque.erase(deque.begin() + (deque.size() / 2));
+           }
+         }));
+}
+
+// Queues 128 MiB through a 16 MiB budget, so most of it goes to disk and
+// comes back, against the same traffic through an in-memory Deque.
+void BenchSpill() {
+  Report("SpillingDeque<int64_t> push_back",
+         MedianNsPerOp(kSpillElements, false, [] {
+           SpillingDeque<int64_t> deque(kSpillBudget);
+           for (size_t idx = 0; idx < kSpillElements; ++idx) {
+             deque.push_back(static_cast<int64_t>(idx));
+           }
+           sink = sink + static_cast<int64_t>(deque.spilled_bytes());
+         }));
+  Report("SpillingDeque<int64_t> push_back+pop_front",
+         MedianNsPerOp(kSpillElements, false, [] {
+           SpillingDeque<int64_t> deque(kSpillBudget);
+           for (size_t idx = 0; idx < kSpillElements; ++idx) {
+             deque.push_back(static_cast<int64_t>(idx));
+           }
+           int64_t total = 0;
+           while (!deque.empty()) {
+             total += deque.front();
+             deque.pop_front();
+           }
+           sink = sink + total;
+         }));
+  Report("Deque<int64_t> push_back+pop_front",
+         MedianNsPerOp(kSpillElements, false, [] {
+           Deque<int64_t> deque;
+           for (size_t idx = 0; idx < kSpillElements; ++idx) {
+             deque.push_back(static_cast<int64_t>(idx));
+           }
+           int64_t total = 0;
+           while (!deque.empty()) {
+             total += *deque.begin();
+             deque.pop_front();
+           }
+           sink = sink + total;
+         }));
+}
+
+// Routes kScatterElements random keys into fanout deques, once with a
+// push_back per element and once through scatter_into's staging buffers.
+void BenchScatter(size_t fanout) {
+  static std::vector<uint64_t> input = [] {
+    std::vector<uint64_t> keys(kScatterElements);
+    std::mt19937_64 rng(42);
+    for (auto& key : keys) {
+      key = rng();
+    }
+    return keys;
+  }();
+  std::vector<Deque<uint64_t>> deques(fanout);
+  std::vector<Deque<uint64_t>*> targets;
+  for (auto& deque : deques) {
+    targets.push_back(&deque);
+  }
+  auto key_fn = [mask = fanout - 1](uint64_t key) { return key & mask; };
+  std::string label = "fan-out " + std::to_string(fanout);
+  Report(label + " push_back", MedianNsPerOp(kScatterElements, false, [&] {
+           for (auto& deque : deques) {
+             deque.clear();
+           }
+           for (uint64_t key : input) {
+             deques[key_fn(key)].push_back(key);
+           }
+         }));
+  Report(label + " scatter_into", MedianNsPerOp(kScatterElements, false, [&] {
+           for (auto& deque : deques) {
+             deque.clear();
+           }
+           deque_scatter::scatter_into(std::span(targets), input, key_fn);
+         }));
+}
+
+int64_t Checksum(std::span<const std::byte> bytes) {
+  int64_t total = 0;
+  for (std::byte value : bytes) {
+    total += static_cast<int64_t>(value);
+  }
+  return total;
+}
+
+// Streams kRecords messages of 16 to 271 bytes through a queue holding
+// kQueuedRecords of them, reading every byte back.
+void BenchRecords() {
+  std::vector<std::byte> payload(512);
+  for (size_t idx = 0; idx < payload.size(); ++idx) {
+    payload[idx] = static_cast<std::byte>(idx);
+  }
+  auto length = [](size_t idx) { return 16 + ((idx * 7919) % 256); };
+  VarDeque<> packed;
+  Report("VarDeque<> push_back+pop_front", MedianNsPerOp(kRecords, false, [&] {
+           int64_t total = 0;
+           for (size_t idx = 0; idx < kRecords; ++idx) {
+             packed.push_back(std::span(payload).first(length(idx)));
+             if (packed.size() > kQueuedRecords) {
+               total += Checksum(packed.front());
+               packed.pop_front();
+             }
+           }
+           packed.clear();
+           sink = sink + total;
+         }));
+  Deque<std::vector<std::byte>> boxed;
+  Report("Deque<std::vector<std::byte>> push_back+pop_front",
+         MedianNsPerOp(kRecords, false, [&] {
+           int64_t total = 0;
+           for (size_t idx = 0; idx < kRecords; ++idx) {
+             boxed.emplace_back(payload.begin(),
+                                payload.begin() + length(idx));
+             if (boxed.size() > kQueuedRecords) {
+               total += Checksum(*boxed.begin());
+               boxed.pop_front();
+             }
+           }
+           boxed.clear();
+           sink = sink + total;
+         }));
+}
+
+// Runs `readers` threads calling read() and one writer calling write()
+// until kWriterTime has passed, and returns the writer's time per call.
+// Readers stop at the deadline on their own, so a writer starved by them
+// still finishes.
+template <typename Read, typename Write>
+double WriterNsPerOp(size_t readers, Read read, Write write) {
+  auto deadline = std::chrono::steady_clock::now() + kWriterTime;
+  std::vector<std::thread> threads;
+  for (size_t idx = 0; idx < readers; ++idx) {
+    threads.emplace_back([&] { read(deadline); });
+  }
+  size_t calls = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto stop = start;
+  while (stop < deadline) {
+    for (size_t idx = 0; idx < 1024; ++idx) {
+      write();
+    }
+    calls += 1024;
+    stop = std::chrono::steady_clock::now();
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return std::chrono::duration<double, std::nano>(stop - start).count() /
+         static_cast<double>(calls);
+}
+
+template <typename Seq>
+int64_t SumRecent(const Seq& seq) {
+  int64_t total = 0;
+  size_t size = seq.size();
+  for (size_t pos = size - std::min(size, kRecentReads); pos < size; ++pos) {
+    total += seq[pos];
+  }
+  return total;
+}
+
+// One writer appends, keeping kHistory values, while `readers` threads keep
+// summing the kRecentReads newest ones.
+void BenchSwmr(size_t readers) {
+  using Clock = std::chrono::steady_clock;
+  std::string label = std::to_string(readers) + " readers";
+
+  SwmrDeque<int64_t> swmr;
+  int64_t next = 0;
+  auto read_swmr = [&](Clock::time_point deadline) {
+    SwmrDeque<int64_t>::Reader reader(swmr);
+    while (Clock::now() < deadline) {
+      sink = sink + SumRecent(reader.snapshot());
+    }
+  };
+  auto write_swmr = [&] {
+    swmr.push_back(next++);
+    if (swmr.size() > kHistory) {
+      swmr.pop_front();
+    }
+  };
+  Report(label + " SwmrDeque", WriterNsPerOp(readers, read_swmr, write_swmr));
+
+  Deque<int64_t> locked;
+  std::shared_mutex mutex;
+  auto read_locked = [&](Clock::time_point deadline) {
+    while (Clock::now() < deadline) {
+      std::shared_lock lock(mutex);
+      sink = sink + SumRecent(locked);
+    }
+  };
+  auto write_locked = [&] {
+    std::unique_lock lock(mutex);
+    locked.push_back(next++);
+    if (locked.size() > kHistory) {
+      locked.pop_front();
+    }
+  };
+  Report(label + " Deque+shared_mutex",
+         WriterNsPerOp(readers, read_locked, write_locked));
+}
+
+// Fills kFlags flags and counts the set ones: word-at-a-time in the packed
+// PackedDeque<1>, one byte per flag in Deque<uint8_t>.
+void BenchFlags() {
+  Report("PackedDeque<1> push_back+count", MedianNsPerOp(kFlags, false, [] {
+           PackedDeque<1> flags;
+           for (size_t idx = 0; idx < kFlags; ++idx) {
+             flags.push_back(idx % 3 == 0);
+           }
+           sink = sink + static_cast<int64_t>(flags.count(true));
+         }));
+  Report("Deque<uint8_t> push_back+count", MedianNsPerOp(kFlags, false, [] {
+           Deque<uint8_t> flags;
+           for (size_t idx = 0; idx < kFlags; ++idx) {
+             flags.push_back(idx % 3 == 0);
+           }
+           sink = sink + std::count(flags.begin(), flags.end(), uint8_t{1});
+         }));
+}
+
+int main() {
+  size_t cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+  std::cout << "Segment-parallel algorithms over " << kParallelElements
+            << " int64_t, " << cores << " hardware threads\n";
+  Deque<int64_t> source;
+  for (size_t idx = 0; idx < kParallelElements; ++idx) {
+    source.push_back(static_cast<int64_t>(idx % 1000));
+  }
+  Deque<int64_t> dest(kParallelElements);
+  for (size_t threads = 1; threads <= 2 * cores; threads *= 2) {
+    BenchParallel(source, dest, threads);
+  }
+
+  std::cout << "SIMD kernels, " << kKernelElements << " warm elements\n";
+  BenchKernels<int32_t>("int32_t");
+  BenchKernels<double>("double");
+
+  std::cout << "Cold-cache traversal, " << kColdElements << " elements\n";
+  BenchColdTraversal<Deque<Sample>>("Deque<Sample>");
+  BenchColdTraversal<Deque<Sample, AlignedAllocator<Sample>>>(
+      "Deque<Sample, AlignedAllocator>");
+  BenchColdSum<Deque<int32_t>>("Deque<int32_t>");
+  BenchColdSum<Deque<int32_t, AlignedAllocator<int32_t>>>(
+      "Deque<int32_t, AlignedAllocator>");
+
+  for (size_t size = size_t{1} << 12; size <= size_t{1} << 20; size <<= 4) {
+    std::cout << "Interior edits in " << size << " int64_t\n";
+    BenchTreeEdits<TreeDeque<int64_t>>("TreeDeque", size);
+    BenchTreeEdits<Deque<int64_t>>("Deque", size);
+  }
+
+  std::cout << "Persistent versions, " << kVersions << " replacements\n";
+  for (size_t size : {size_t{1} << 10, size_t{1} << 20}) {
+    BenchPersistentChurn(size);
+  }
+
+  std::cout << "Range queries over " << kEvents << " sorted events\n";
+  BenchSortedRange();
+
+  for (size_t window = 100; window <= 10'000'000; window *= 10) {
+    std::cout << "Sliding window of " << window << "\n";
+    BenchWindow<monoids::Sum<int64_t>>("sum", window);
+    BenchWindow<monoids::Max<int64_t>>("max", window);
+  }
+
+  std::cout << "Middle inserts into " << kInsertBase << " elements\n";
+  BenchMiddleInsert<std::string>("Deque<std::string>", [](size_t idx) {
+    return std::to_string(idx);
+  });
+  BenchMiddleInsert<Handle>("Deque<Handle>", [](size_t idx) {
+    return Handle{std::make_unique<int64_t>(idx)};
+  });
+  BenchMiddleInsert<RelocatableHandle>(
+      "Deque<RelocatableHandle>", [](size_t idx) {
+        return RelocatableHandle{std::make_unique<int64_t>(idx)};
+      });
+
+  std::cout << "Spilling " << kSpillElements << " int64_t through "
+            << (kSpillBudget >> 20) << " MiB\n";
+  BenchSpill();
+
+  std::cout << "Scatter of " << kScatterElements << " uint64_t\n";
+  for (size_t fanout = 16; fanout <= 4096; fanout *= 4) {
+    BenchScatter(fanout);
+  }
+
+  std::cout << "Variable-length records, " << kQueuedRecords << " queued\n";
+  BenchRecords();
+
+  std::cout << "Single writer, readers of recent history\n";
+  for (size_t readers : {0, 1, 4, 16, 64}) {
+    BenchSwmr(readers);
+  }
+
+  std::cout << kFlags << " flags: " << (kFlags >> 23)
+            << " MiB as PackedDeque<1>, " << (kFlags >> 20)
+            << " MiB as Deque<uint8_t>\n";
+  BenchFlags();
+}
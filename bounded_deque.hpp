@@ -0,0 +1,449 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+// What a full BoundedDeque does with one more element.
+struct OverwriteOldest {};
+struct RejectWhenFull {};
+
+inline constexpr size_t kDynamicCapacity = 0;
+
+// Fixed-capacity deque over a single power-of-two ring. Capacity is either a
+// template argument or, with kDynamicCapacity, a constructor argument rounded
+// up to a power of two. Pushes return whether the element was stored. A
+// moved-from deque is empty, keeps its capacity and allocates a new ring on
+// its next push.
+template <typename T, size_t Capacity = kDynamicCapacity,
+          typename Policy = OverwriteOldest,
+          typename Allocator = std::allocator<T>>
+class BoundedDeque {
+  static_assert(Capacity == kDynamicCapacity || std::has_single_bit(Capacity),
+                "Capacity must be a power of two");
+  static_assert(std::is_same_v<Policy, OverwriteOldest> ||
+                std::is_same_v<Policy, RejectWhenFull>);
+
+ private:
+  template <bool IsConst>
+  class Iterator;
+
+ public:
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  BoundedDeque()
+    requires(Capacity != kDynamicCapacity)
+      : BoundedDeque(Allocator()) {}
+
+  BoundedDeque(const Allocator& alloc)
+    requires(Capacity != kDynamicCapacity);
+
+  explicit BoundedDeque(size_t capacity, const Allocator& alloc = Allocator())
+    requires(Capacity == kDynamicCapacity);
+
+  BoundedDeque(const BoundedDeque& other);
+  BoundedDeque(BoundedDeque&& other) noexcept;
+
+  ~BoundedDeque();
+
+  BoundedDeque& operator=(const BoundedDeque& other);
+  BoundedDeque& operator=(BoundedDeque&& other);
+
+  iterator begin() { return iterator(data_, mask_, head_); }
+  const_iterator begin() const { return const_iterator(data_, mask_, head_); }
+  const_iterator cbegin() const { return begin(); }
+
+  iterator end() { return iterator(data_, mask_, head_ + size_); }
+  const_iterator end() const {
+    return const_iterator(data_, mask_, head_ + size_);
+  }
+  const_iterator cend() const { return end(); }
+
+  reverse_iterator rbegin() { return std::make_reverse_iterator(end()); }
+  const_reverse_iterator rbegin() const {
+    return std::make_reverse_iterator(end());
+  }
+  const_reverse_iterator crbegin() const { return rbegin(); }
+
+  reverse_iterator rend() { return std::make_reverse_iterator(begin()); }
+  const_reverse_iterator rend() const {
+    return std::make_reverse_iterator(begin());
+  }
+  const_reverse_iterator crend() const { return rend(); }
+
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+  [[nodiscard]] bool full() const { return size_ == mask_ + 1; }
+  [[nodiscard]] size_t capacity() const { return mask_ + 1; }
+  [[nodiscard]] Allocator get_allocator() const { return alloc_; }
+
+  T& operator[](size_t idx) { return data_[(head_ + idx) & mask_]; }
+  const T& operator[](size_t idx) const {
+    return data_[(head_ + idx) & mask_];
+  }
+
+  T& at(size_t idx);
+  const T& at(size_t idx) const;
+
+  T& front() { return data_[head_]; }
+  const T& front() const { return data_[head_]; }
+  T& back() { return (*this)[size_ - 1]; }
+  const T& back() const { return (*this)[size_ - 1]; }
+
+  template <typename... Args>
+  bool emplace_back(Args&&... args);
+
+  template <typename... Args>
+  bool emplace_front(Args&&... args);
+
+  bool push_back(const T& value) { return emplace_back(value); }
+  bool push_back(T&& value) { return emplace_back(std::move(value)); }
+  bool push_front(const T& value) { return emplace_front(value); }
+  bool push_front(T&& value) { return emplace_front(std::move(value)); }
+
+  void pop_back();
+  void pop_front();
+
+  void clear();
+
+ private:
+  using alloc_traits = std::allocator_traits<Allocator>;
+
+  template <typename Other>
+    requires std::same_as<std::remove_cvref_t<Other>, BoundedDeque>
+  BoundedDeque(Other&& other, const Allocator& alloc);
+
+  template <typename... Args>
+  static bool may_refer_to(const T& element, const Args&... args);
+
+  void allocate(size_t capacity);
+  void release();
+  void steal(BoundedDeque& other);
+
+  T* data_{nullptr};
+  size_t mask_{0};
+  size_t head_{0};
+  size_t size_{0};
+
+  [[no_unique_address]] Allocator alloc_;
+};
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+template <bool IsConst>
+class BoundedDeque<T, Capacity, Policy, Allocator>::Iterator {
+ public:
+  using value_type = std::conditional_t<IsConst, const T, T>;
+  using pointer = value_type*;
+  using reference = value_type&;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::random_access_iterator_tag;
+  using iterator_concept = std::random_access_iterator_tag;
+
+  Iterator() = default;
+  // pos counts from the ring start without wrapping; it is masked on access.
+  Iterator(pointer data, size_t mask, size_t pos)
+      : data_(data), mask_(mask), pos_(pos) {}
+
+  reference operator*() const { return data_[pos_ & mask_]; }
+  pointer operator->() const { return data_ + (pos_ & mask_); }
+  reference operator[](difference_type value) const {
+    return data_[(pos_ + value) & mask_];
+  }
+
+  Iterator& operator++() {
+    ++pos_;
+    return *this;
+  }
+  Iterator operator++(int) {
+    auto copy = *this;
+    ++pos_;
+    return copy;
+  }
+  Iterator& operator--() {
+    --pos_;
+    return *this;
+  }
+  Iterator operator--(int) {
+    auto copy = *this;
+    --pos_;
+    return copy;
+  }
+
+  Iterator& operator+=(difference_type value) {
+    pos_ += value;
+    return *this;
+  }
+  Iterator& operator-=(difference_type value) {
+    pos_ -= value;
+    return *this;
+  }
+  Iterator operator+(difference_type value) const {
+    return Iterator(data_, mask_, pos_ + value);
+  }
+  friend Iterator operator+(difference_type value, const Iterator& iter) {
+    return iter + value;
+  }
+  Iterator operator-(difference_type value) const {
+    return Iterator(data_, mask_, pos_ - value);
+  }
+  difference_type operator-(const Iterator& other) const {
+    return static_cast<difference_type>(pos_ - other.pos_);
+  }
+
+  bool operator==(const Iterator& other) const { return pos_ == other.pos_; }
+  auto operator<=>(const Iterator& other) const { return pos_ <=> other.pos_; }
+
+  operator Iterator<true>() const { return Iterator<true>(data_, mask_, pos_); }
+
+ private:
+  pointer data_{nullptr};
+  size_t mask_{0};
+  size_t pos_{0};
+};
+
+// BoundedDeque
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+BoundedDeque<T, Capacity, Policy, Allocator>::BoundedDeque(
+    const Allocator& alloc)
+  requires(Capacity != kDynamicCapacity)
+    : alloc_(alloc) {
+  allocate(Capacity);
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+BoundedDeque<T, Capacity, Policy, Allocator>::BoundedDeque(
+    size_t capacity, const Allocator& alloc)
+  requires(Capacity == kDynamicCapacity)
+    : alloc_(alloc) {
+  allocate(std::bit_ceil(std::max<size_t>(capacity, 1)));
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+BoundedDeque<T, Capacity, Policy, Allocator>::BoundedDeque(
+    const BoundedDeque& other)
+    : BoundedDeque(other, alloc_traits::select_on_container_copy_construction(
+                              other.alloc_)) {}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+BoundedDeque<T, Capacity, Policy, Allocator>::BoundedDeque(
+    BoundedDeque&& other) noexcept
+    : alloc_(std::move(other.alloc_)) {
+  steal(other);
+}
+
+// A ring of other's capacity from alloc, holding copies of other's elements,
+// or its elements moved out when other is an rvalue. Assignment builds one of
+// these before releasing its own ring, so a throwing allocation or element
+// constructor leaves the target unchanged.
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+template <typename Other>
+  requires std::same_as<std::remove_cvref_t<Other>,
+                        BoundedDeque<T, Capacity, Policy, Allocator>>
+BoundedDeque<T, Capacity, Policy, Allocator>::BoundedDeque(
+    Other&& other, const Allocator& alloc)
+    : alloc_(alloc) {
+  allocate(other.capacity());
+  try {
+    for (auto& value : other) {
+      if constexpr (std::is_lvalue_reference_v<Other>) {
+        emplace_back(value);
+      } else {
+        emplace_back(std::move(value));
+      }
+    }
+  } catch (...) {
+    release();
+    throw;
+  }
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+BoundedDeque<T, Capacity, Policy, Allocator>::~BoundedDeque() {
+  release();
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+BoundedDeque<T, Capacity, Policy, Allocator>&
+BoundedDeque<T, Capacity, Policy, Allocator>::operator=(
+    const BoundedDeque& other) {
+  if (&other == this) {
+    return *this;
+  }
+  BoundedDeque copy(
+      other, alloc_traits::propagate_on_container_copy_assignment::value
+                 ? other.alloc_
+                 : alloc_);
+  release();
+  alloc_ = copy.alloc_;
+  steal(copy);
+  return *this;
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+BoundedDeque<T, Capacity, Policy, Allocator>&
+BoundedDeque<T, Capacity, Policy, Allocator>::operator=(
+    BoundedDeque&& other) {
+  if (&other == this) {
+    return *this;
+  }
+  if (alloc_traits::propagate_on_container_move_assignment::value ||
+      alloc_ == other.alloc_) {
+    release();
+    if (alloc_traits::propagate_on_container_move_assignment::value) {
+      alloc_ = std::move(other.alloc_);
+    }
+    steal(other);
+    return *this;
+  }
+  BoundedDeque moved(std::move(other), alloc_);
+  release();
+  steal(moved);
+  other.clear();
+  return *this;
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+T& BoundedDeque<T, Capacity, Policy, Allocator>::at(size_t idx) {
+  if (idx >= size_) {
+    throw std::out_of_range("out of range");
+  }
+  return (*this)[idx];
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+const T& BoundedDeque<T, Capacity, Policy, Allocator>::at(size_t idx) const {
+  if (idx >= size_) {
+    throw std::out_of_range("out of range");
+  }
+  return (*this)[idx];
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+template <typename... Args>
+bool BoundedDeque<T, Capacity, Policy, Allocator>::emplace_back(
+    Args&&... args) {
+  if (data_ == nullptr) {
+    allocate(capacity());
+  }
+  if (full()) {
+    if constexpr (std::is_same_v<Policy, RejectWhenFull>) {
+      return false;
+    } else if (std::is_nothrow_constructible_v<T, Args...> &&
+               !may_refer_to(front(), args...)) {
+      pop_front();
+    } else {
+      // Built first, so that a throwing constructor leaves the deque as it
+      // was and args may refer to the element about to be evicted.
+      T value(std::forward<Args>(args)...);
+      pop_front();
+      return emplace_back(std::move(value));
+    }
+  }
+  alloc_traits::construct(alloc_, &data_[(head_ + size_) & mask_],
+                          std::forward<Args>(args)...);
+  ++size_;
+  return true;
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+template <typename... Args>
+bool BoundedDeque<T, Capacity, Policy, Allocator>::emplace_front(
+    Args&&... args) {
+  if (data_ == nullptr) {
+    allocate(capacity());
+  }
+  if (full()) {
+    if constexpr (std::is_same_v<Policy, RejectWhenFull>) {
+      return false;
+    } else if (std::is_nothrow_constructible_v<T, Args...> &&
+               !may_refer_to(back(), args...)) {
+      pop_back();
+    } else {
+      T value(std::forward<Args>(args)...);
+      pop_back();
+      return emplace_front(std::move(value));
+    }
+  }
+  size_t slot = (head_ - 1) & mask_;
+  alloc_traits::construct(alloc_, &data_[slot], std::forward<Args>(args)...);
+  head_ = slot;
+  ++size_;
+  return true;
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+void BoundedDeque<T, Capacity, Policy, Allocator>::pop_back() {
+  if (size_ == 0) {
+    return;
+  }
+  --size_;
+  alloc_traits::destroy(alloc_, &data_[(head_ + size_) & mask_]);
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+void BoundedDeque<T, Capacity, Policy, Allocator>::pop_front() {
+  if (size_ == 0) {
+    return;
+  }
+  alloc_traits::destroy(alloc_, &data_[head_]);
+  head_ = (head_ + 1) & mask_;
+  --size_;
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+void BoundedDeque<T, Capacity, Policy, Allocator>::clear() {
+  while (size_ != 0) {
+    pop_back();
+  }
+  head_ = 0;
+}
+
+// Whether constructing from args might read element. Only a T argument is
+// known not to, unless it is element itself.
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+template <typename... Args>
+bool BoundedDeque<T, Capacity, Policy, Allocator>::may_refer_to(
+    const T& element, const Args&... args) {
+  if constexpr (sizeof...(Args) == 1 && (std::is_same_v<Args, T> && ...)) {
+    return ((std::addressof(args) == std::addressof(element)) || ...);
+  } else {
+    return true;
+  }
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+void BoundedDeque<T, Capacity, Policy, Allocator>::allocate(size_t capacity) {
+  data_ = alloc_traits::allocate(alloc_, capacity);
+  mask_ = capacity - 1;
+  head_ = 0;
+  size_ = 0;
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+void BoundedDeque<T, Capacity, Policy, Allocator>::release() {
+  if (data_ == nullptr) {
+    return;
+  }
+  clear();
+  alloc_traits::deallocate(alloc_, data_, mask_ + 1);
+  data_ = nullptr;
+}
+
+template <typename T, size_t Capacity, typename Policy, typename Allocator>
+void BoundedDeque<T, Capacity, Policy, Allocator>::steal(BoundedDeque& other) {
+  data_ = other.data_;
+  mask_ = other.mask_;
+  head_ = other.head_;
+  size_ = other.size_;
+  other.data_ = nullptr;
+  other.head_ = 0;
+  other.size_ = 0;
+}
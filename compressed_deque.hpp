@@ -0,0 +1,376 @@
+#pragma once
+
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "deque.hpp"
+
+// Integer deque that keeps its two ends as plain values and seals everything
+// in between into frame-of-reference bit-packed frames. Each frame stores
+// kFrameSize values as offsets from the frame minimum, using just enough
+// bits for the largest offset, so random access stays O(1).
+template <std::integral Int, typename Allocator = std::allocator<Int>>
+class CompressedDeque {
+ private:
+  class Iterator;
+
+ public:
+  using value_type = Int;
+  using const_iterator = Iterator;
+  using iterator = const_iterator;
+
+  static constexpr size_t kFrameSize = 256;
+
+  CompressedDeque() = default;
+
+  CompressedDeque(const Allocator& alloc);
+
+  const_iterator begin() const { return Iterator(this, 0); }
+  const_iterator end() const { return Iterator(this, size()); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  [[nodiscard]] size_t size() const {
+    return head_.size() + (frames_.size() * kFrameSize) + tail_.size();
+  }
+  [[nodiscard]] bool empty() const { return size() == 0; }
+
+  // Approximate bytes held by values, frames and packed words.
+  [[nodiscard]] size_t memory_usage() const;
+
+  Int operator[](size_t idx) const;
+  Int at(size_t idx) const;
+
+  Int front() const { return (*this)[0]; }
+  Int back() const { return (*this)[size() - 1]; }
+
+  void push_back(Int value);
+  void push_front(Int value);
+
+  void pop_back();
+  void pop_front();
+
+  void clear();
+
+  // Calls func(value) for every element in order, unpacking one frame at a
+  // time into a local buffer.
+  template <typename Func>
+  void for_each(Func func) const;
+
+ private:
+  using unsigned_type = std::make_unsigned_t<Int>;
+  using word_alloc =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<
+          uint64_t>;
+
+  struct Frame {
+    Int base;
+    uint32_t width;
+    int64_t offset;
+  };
+
+  using frame_alloc =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Frame>;
+
+  static size_t words_for(uint32_t width) {
+    return ((kFrameSize * width) + 63) / 64;
+  }
+  // value - base modulo 2^bits(Int). The subtraction promotes narrow types
+  // to int, so it is cast back before widening, or a negative difference
+  // would sign-extend into the upper bits.
+  static uint64_t distance(Int value, Int base) {
+    return static_cast<unsigned_type>(static_cast<unsigned_type>(value) -
+                                      static_cast<unsigned_type>(base));
+  }
+
+  Frame seal(const Int* values, bool at_front);
+  void unseal(const Frame& frame, Int* out) const;
+  Int decode(const Frame& frame, size_t idx) const;
+  uint64_t word(const Frame& frame, size_t idx) const {
+    return words_[frame.offset - words_front_ + idx];
+  }
+
+  // head_ is stored reversed: head_.back() is the first element.
+  std::vector<Int, Allocator> head_;
+  std::vector<Int, Allocator> tail_;
+  Deque<Frame, frame_alloc> frames_;
+  Deque<uint64_t, word_alloc> words_;
+  int64_t words_front_{0};
+};
+
+template <std::integral Int, typename Allocator>
+class CompressedDeque<Int, Allocator>::Iterator {
+ public:
+  using value_type = Int;
+  using reference = Int;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::input_iterator_tag;
+  using iterator_concept = std::random_access_iterator_tag;
+
+  Iterator() = default;
+  Iterator(const CompressedDeque* owner, size_t idx)
+      : owner_(owner), idx_(idx) {}
+
+  Int operator*() const { return (*owner_)[idx_]; }
+  Int operator[](difference_type value) const {
+    return (*owner_)[idx_ + value];
+  }
+
+  Iterator& operator++() {
+    ++idx_;
+    return *this;
+  }
+  Iterator operator++(int) {
+    auto copy = *this;
+    ++idx_;
+    return copy;
+  }
+  Iterator& operator--() {
+    --idx_;
+    return *this;
+  }
+  Iterator operator--(int) {
+    auto copy = *this;
+    --idx_;
+    return copy;
+  }
+
+  Iterator& operator+=(difference_type value) {
+    idx_ += value;
+    return *this;
+  }
+  Iterator& operator-=(difference_type value) {
+    idx_ -= value;
+    return *this;
+  }
+  Iterator operator+(difference_type value) const {
+    return Iterator(owner_, idx_ + value);
+  }
+  friend Iterator operator+(difference_type value, const Iterator& iter) {
+    return iter + value;
+  }
+  Iterator operator-(difference_type value) const {
+    return Iterator(owner_, idx_ - value);
+  }
+  difference_type operator-(const Iterator& other) const {
+    return static_cast<difference_type>(idx_) -
+           static_cast<difference_type>(other.idx_);
+  }
+
+  bool operator==(const Iterator& other) const { return idx_ == other.idx_; }
+  auto operator<=>(const Iterator& other) const { return idx_ <=> other.idx_; }
+
+ private:
+  const CompressedDeque* owner_{nullptr};
+  size_t idx_{0};
+};
+
+template <std::integral Int, typename Allocator>
+CompressedDeque<Int, Allocator>::CompressedDeque(const Allocator& alloc)
+    : head_(alloc), tail_(alloc), frames_(frame_alloc(alloc)),
+      words_(word_alloc(alloc)) {}
+
+template <std::integral Int, typename Allocator>
+size_t CompressedDeque<Int, Allocator>::memory_usage() const {
+  return ((head_.capacity() + tail_.capacity()) * sizeof(Int)) +
+         (frames_.size() * sizeof(Frame)) + (words_.size() * sizeof(uint64_t));
+}
+
+template <std::integral Int, typename Allocator>
+Int CompressedDeque<Int, Allocator>::operator[](size_t idx) const {
+  if (idx < head_.size()) {
+    return head_[head_.size() - 1 - idx];
+  }
+  idx -= head_.size();
+  if (idx < frames_.size() * kFrameSize) {
+    return decode(frames_[idx / kFrameSize], idx % kFrameSize);
+  }
+  return tail_[idx - (frames_.size() * kFrameSize)];
+}
+
+template <std::integral Int, typename Allocator>
+Int CompressedDeque<Int, Allocator>::at(size_t idx) const {
+  if (idx >= size()) {
+    throw std::out_of_range("out of range");
+  }
+  return (*this)[idx];
+}
+
+template <std::integral Int, typename Allocator>
+void CompressedDeque<Int, Allocator>::push_back(Int value) {
+  if (tail_.size() == 2 * kFrameSize) {
+    frames_.push_back(seal(tail_.data(), false));
+    tail_.erase(tail_.begin(), tail_.begin() + kFrameSize);
+  }
+  if (tail_.capacity() == 0) {
+    tail_.reserve(2 * kFrameSize);
+  }
+  tail_.push_back(value);
+}
+
+template <std::integral Int, typename Allocator>
+void CompressedDeque<Int, Allocator>::push_front(Int value) {
+  if (head_.size() == 2 * kFrameSize) {
+    // head_[0, kFrameSize) are the values next to the frames, reversed.
+    Int values[kFrameSize];
+    for (size_t idx = 0; idx < kFrameSize; ++idx) {
+      values[idx] = head_[kFrameSize - 1 - idx];
+    }
+    frames_.push_front(seal(values, true));
+    head_.erase(head_.begin(), head_.begin() + kFrameSize);
+  }
+  if (head_.capacity() == 0) {
+    head_.reserve(2 * kFrameSize);
+  }
+  head_.push_back(value);
+}
+
+template <std::integral Int, typename Allocator>
+void CompressedDeque<Int, Allocator>::pop_back() {
+  if (tail_.empty() && !frames_.empty()) {
+    tail_.resize(kFrameSize);
+    unseal(frames_[frames_.size() - 1], tail_.data());
+    for (size_t idx = 0; idx < words_for(frames_[frames_.size() - 1].width);
+         ++idx) {
+      words_.pop_back();
+    }
+    frames_.pop_back();
+  }
+  if (!tail_.empty()) {
+    tail_.pop_back();
+  } else if (!head_.empty()) {
+    head_.erase(head_.begin());
+  }
+}
+
+template <std::integral Int, typename Allocator>
+void CompressedDeque<Int, Allocator>::pop_front() {
+  if (head_.empty() && !frames_.empty()) {
+    Int values[kFrameSize];
+    unseal(frames_[0], values);
+    head_.assign(std::make_reverse_iterator(values + kFrameSize),
+                 std::make_reverse_iterator(values));
+    size_t words = words_for(frames_[0].width);
+    for (size_t idx = 0; idx < words; ++idx) {
+      words_.pop_front();
+    }
+    words_front_ += static_cast<int64_t>(words);
+    frames_.pop_front();
+  }
+  if (!head_.empty()) {
+    head_.pop_back();
+  } else if (!tail_.empty()) {
+    tail_.erase(tail_.begin());
+  }
+}
+
+template <std::integral Int, typename Allocator>
+void CompressedDeque<Int, Allocator>::clear() {
+  head_.clear();
+  tail_.clear();
+  frames_.clear();
+  words_.clear();
+  words_front_ = 0;
+}
+
+template <std::integral Int, typename Allocator>
+template <typename Func>
+void CompressedDeque<Int, Allocator>::for_each(Func func) const {
+  for (size_t idx = head_.size(); idx > 0; --idx) {
+    func(head_[idx - 1]);
+  }
+  Int values[kFrameSize];
+  for (size_t frame = 0; frame < frames_.size(); ++frame) {
+    unseal(frames_[frame], values);
+    for (Int value : values) {
+      func(value);
+    }
+  }
+  for (Int value : tail_) {
+    func(value);
+  }
+}
+
+template <std::integral Int, typename Allocator>
+typename CompressedDeque<Int, Allocator>::Frame
+CompressedDeque<Int, Allocator>::seal(const Int* values, bool at_front) {
+  Int low = values[0];
+  Int high = values[0];
+  for (size_t idx = 1; idx < kFrameSize; ++idx) {
+    low = std::min(low, values[idx]);
+    high = std::max(high, values[idx]);
+  }
+  auto width = static_cast<uint32_t>(std::bit_width(distance(high, low)));
+  size_t words = words_for(width);
+  uint64_t packed[kFrameSize] = {};
+  for (size_t idx = 0; width != 0 && idx < kFrameSize; ++idx) {
+    uint64_t delta = distance(values[idx], low);
+    size_t bit = idx * width;
+    packed[bit / 64] |= delta << (bit % 64);
+    if ((bit % 64) + width > 64) {
+      packed[(bit / 64) + 1] |= delta >> (64 - (bit % 64));
+    }
+  }
+  Frame frame{low, width, 0};
+  if (at_front) {
+    for (size_t idx = words; idx > 0; --idx) {
+      words_.push_front(packed[idx - 1]);
+    }
+    words_front_ -= static_cast<int64_t>(words);
+    frame.offset = words_front_;
+  } else {
+    frame.offset = words_front_ + static_cast<int64_t>(words_.size());
+    for (size_t idx = 0; idx < words; ++idx) {
+      words_.push_back(packed[idx]);
+    }
+  }
+  return frame;
+}
+
+template <std::integral Int, typename Allocator>
+Int CompressedDeque<Int, Allocator>::decode(const Frame& frame,
+                                            size_t idx) const {
+  if (frame.width == 0) {
+    return frame.base;
+  }
+  uint64_t mask = frame.width == 64 ? ~uint64_t{0}
+                                    : (uint64_t{1} << frame.width) - 1;
+  size_t bit = idx * frame.width;
+  uint64_t delta = word(frame, bit / 64) >> (bit % 64);
+  if ((bit % 64) + frame.width > 64) {
+    delta |= word(frame, (bit / 64) + 1) << (64 - (bit % 64));
+  }
+  return static_cast<Int>(static_cast<unsigned_type>(frame.base) +
+                          static_cast<unsigned_type>(delta & mask));
+}
+
+template <std::integral Int, typename Allocator>
+void CompressedDeque<Int, Allocator>::unseal(const Frame& frame,
+                                             Int* out) const {
+  if (frame.width == 0) {
+    std::fill(out, out + kFrameSize, frame.base);
+    return;
+  }
+  // Copy the packed words out of the deque first so that the unpacking loop
+  // below runs over a flat array.
+  uint64_t packed[kFrameSize + 1];
+  size_t words = words_for(frame.width);
+  for (size_t idx = 0; idx < words; ++idx) {
+    packed[idx] = word(frame, idx);
+  }
+  packed[words] = 0;
+  uint64_t mask = frame.width == 64 ? ~uint64_t{0}
+                                    : (uint64_t{1} << frame.width) - 1;
+  for (size_t idx = 0; idx < kFrameSize; ++idx) {
+    size_t bit = idx * frame.width;
+    size_t shift = bit % 64;
+    uint64_t low = packed[bit / 64] >> shift;
+    uint64_t high = shift == 0 ? 0 : packed[(bit / 64) + 1] << (64 - shift);
+    auto offset = static_cast<unsigned_type>((low | high) & mask);
+    out[idx] = static_cast<Int>(static_cast<unsigned_type>(frame.base) +
+                                offset);
+  }
+}
@@ -0,0 +1,561 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+
+#include "deque.hpp"
+
+// Deque whose copies share blocks. Copying only duplicates the block map and
+// bumps reference counts, so a snapshot costs O(blocks); a shared block is
+// copied the first time either side writes into it. Reference counts are
+// atomic, so a snapshot may be read on another thread while the original
+// keeps changing.
+template <typename T, typename Allocator = std::allocator<T>>
+class CowDeque {
+ private:
+  struct Block;
+
+  class Iterator;
+
+ public:
+  using value_type = T;
+  using iterator = Iterator;
+  using const_iterator = Iterator;
+  using reverse_iterator = std::reverse_iterator<const_iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  CowDeque() = default;
+
+  CowDeque(const Allocator& alloc);
+
+  CowDeque(std::initializer_list<T> init, const Allocator& alloc = Allocator());
+
+  CowDeque(const CowDeque& other);
+  CowDeque(CowDeque&& other) noexcept;
+
+  ~CowDeque();
+
+  CowDeque& operator=(const CowDeque& other);
+  CowDeque& operator=(CowDeque&& other);
+
+  // Same as copying; spelled out for call sites that take snapshots.
+  [[nodiscard]] CowDeque snapshot() const { return *this; }
+
+  const_iterator begin() const { return Iterator(this, 0); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator end() const { return Iterator(this, size_); }
+  const_iterator cend() const { return end(); }
+
+  const_reverse_iterator rbegin() const {
+    return std::make_reverse_iterator(end());
+  }
+  const_reverse_iterator crbegin() const { return rbegin(); }
+  const_reverse_iterator rend() const {
+    return std::make_reverse_iterator(begin());
+  }
+  const_reverse_iterator crend() const { return rend(); }
+
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+  [[nodiscard]] Allocator get_allocator() const { return alloc_; }
+
+  // The non-const accessors give the block holding idx a private copy first.
+  T& operator[](size_t idx);
+  const T& operator[](size_t idx) const;
+
+  T& at(size_t idx);
+  const T& at(size_t idx) const;
+
+  template <typename... Args>
+  void emplace_back(Args&&... args);
+
+  template <typename... Args>
+  void emplace_front(Args&&... args);
+
+  void push_back(const T& value) { emplace_back(value); }
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+  void push_front(const T& value) { emplace_front(value); }
+  void push_front(T&& value) { emplace_front(std::move(value)); }
+
+  void pop_back();
+  void pop_front();
+
+  void clear();
+
+  const_iterator insert(const_iterator pos, const T& value);
+
+  const_iterator erase(const_iterator pos);
+
+ private:
+  using alloc_traits = std::allocator_traits<Allocator>;
+  using block_alloc = typename alloc_traits::template rebind_alloc<Block>;
+  using block_alloc_traits =
+      typename alloc_traits::template rebind_traits<Block>;
+  using map_type =
+      Deque<Block*, typename alloc_traits::template rebind_alloc<Block*>>;
+
+  static constexpr size_t kBlockSize =
+      std::bit_floor(std::max<size_t>(8, 512 / sizeof(T)));
+
+  // Elements in [lo, hi) are constructed. Every owner's view of the block is
+  // a subrange of it; slots outside an owner's view are trimmed away once
+  // that owner holds the only reference.
+  struct Block {
+    std::atomic<size_t> refs{1};
+    size_t lo{0};
+    size_t hi{0};
+    T* data{nullptr};
+  };
+
+  Block* create_block(size_t pos);
+  void release(Block* block);
+  void trim(Block* block, size_t from, size_t to);
+  Block* own(size_t bucket);
+  [[nodiscard]] size_t view_begin(size_t bucket) const;
+  [[nodiscard]] size_t view_end(size_t bucket) const;
+  void start_block();
+  void share(const CowDeque& other);
+
+  map_type blocks_;
+  size_t front_elem_{0};
+  size_t size_{0};
+
+  [[no_unique_address]] Allocator alloc_;
+  [[no_unique_address]] block_alloc block_alloc_;
+};
+
+template <typename T, typename Allocator>
+class CowDeque<T, Allocator>::Iterator {
+ public:
+  using value_type = T;
+  using pointer = const T*;
+  using reference = const T&;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::random_access_iterator_tag;
+  using iterator_concept = std::random_access_iterator_tag;
+
+  Iterator() = default;
+  Iterator(const CowDeque* owner, size_t idx) : owner_(owner), idx_(idx) {}
+
+  reference operator*() const { return (*owner_)[idx_]; }
+  pointer operator->() const { return &(*owner_)[idx_]; }
+  reference operator[](difference_type value) const {
+    return (*owner_)[idx_ + value];
+  }
+
+  Iterator& operator++() {
+    ++idx_;
+    return *this;
+  }
+  Iterator operator++(int) {
+    auto copy = *this;
+    ++idx_;
+    return copy;
+  }
+  Iterator& operator--() {
+    --idx_;
+    return *this;
+  }
+  Iterator operator--(int) {
+    auto copy = *this;
+    --idx_;
+    return copy;
+  }
+
+  Iterator& operator+=(difference_type value) {
+    idx_ += value;
+    return *this;
+  }
+  Iterator& operator-=(difference_type value) {
+    idx_ -= value;
+    return *this;
+  }
+  Iterator operator+(difference_type value) const {
+    return Iterator(owner_, idx_ + value);
+  }
+  friend Iterator operator+(difference_type value, const Iterator& iter) {
+    return iter + value;
+  }
+  Iterator operator-(difference_type value) const {
+    return Iterator(owner_, idx_ - value);
+  }
+  difference_type operator-(const Iterator& other) const {
+    return static_cast<difference_type>(idx_) -
+           static_cast<difference_type>(other.idx_);
+  }
+
+  bool operator==(const Iterator& other) const { return idx_ == other.idx_; }
+  auto operator<=>(const Iterator& other) const { return idx_ <=> other.idx_; }
+
+ private:
+  friend class CowDeque;
+
+  const CowDeque* owner_{nullptr};
+  size_t idx_{0};
+};
+
+// CowDeque
+
+template <typename T, typename Allocator>
+CowDeque<T, Allocator>::CowDeque(const Allocator& alloc)
+    : blocks_(typename alloc_traits::template rebind_alloc<Block*>(alloc)),
+      alloc_(alloc),
+      block_alloc_(alloc) {}
+
+template <typename T, typename Allocator>
+CowDeque<T, Allocator>::CowDeque(std::initializer_list<T> init,
+                                 const Allocator& alloc)
+    : CowDeque(alloc) {
+  try {
+    for (const auto& value : init) {
+      emplace_back(value);
+    }
+  } catch (...) {
+    clear();
+    throw;
+  }
+}
+
+template <typename T, typename Allocator>
+CowDeque<T, Allocator>::CowDeque(const CowDeque& other)
+    : alloc_(alloc_traits::select_on_container_copy_construction(
+          other.alloc_)),
+      block_alloc_(alloc_) {
+  share(other);
+}
+
+template <typename T, typename Allocator>
+CowDeque<T, Allocator>::CowDeque(CowDeque&& other) noexcept
+    : blocks_(std::move(other.blocks_)),
+      front_elem_(other.front_elem_),
+      size_(other.size_),
+      alloc_(std::move(other.alloc_)),
+      block_alloc_(alloc_) {
+  other.front_elem_ = 0;
+  other.size_ = 0;
+}
+
+template <typename T, typename Allocator>
+CowDeque<T, Allocator>::~CowDeque() {
+  clear();
+}
+
+template <typename T, typename Allocator>
+CowDeque<T, Allocator>& CowDeque<T, Allocator>::operator=(
+    const CowDeque& other) {
+  if (&other == this) {
+    return *this;
+  }
+  clear();
+  if (alloc_traits::propagate_on_container_copy_assignment::value) {
+    alloc_ = other.alloc_;
+    block_alloc_ = block_alloc(alloc_);
+  }
+  share(other);
+  return *this;
+}
+
+template <typename T, typename Allocator>
+CowDeque<T, Allocator>& CowDeque<T, Allocator>::operator=(CowDeque&& other) {
+  if (&other == this) {
+    return *this;
+  }
+  clear();
+  if (alloc_traits::propagate_on_container_move_assignment::value) {
+    alloc_ = std::move(other.alloc_);
+    block_alloc_ = block_alloc(alloc_);
+  }
+  if (alloc_ != other.alloc_) {
+    share(other);
+    other.clear();
+    return *this;
+  }
+  blocks_ = std::move(other.blocks_);
+  front_elem_ = other.front_elem_;
+  size_ = other.size_;
+  other.front_elem_ = 0;
+  other.size_ = 0;
+  return *this;
+}
+
+template <typename T, typename Allocator>
+T& CowDeque<T, Allocator>::operator[](size_t idx) {
+  size_t pos = front_elem_ + idx;
+  return own(pos / kBlockSize)->data[pos % kBlockSize];
+}
+
+template <typename T, typename Allocator>
+const T& CowDeque<T, Allocator>::operator[](size_t idx) const {
+  size_t pos = front_elem_ + idx;
+  return blocks_[pos / kBlockSize]->data[pos % kBlockSize];
+}
+
+template <typename T, typename Allocator>
+T& CowDeque<T, Allocator>::at(size_t idx) {
+  if (idx >= size_) {
+    throw std::out_of_range("out of range");
+  }
+  return (*this)[idx];
+}
+
+template <typename T, typename Allocator>
+const T& CowDeque<T, Allocator>::at(size_t idx) const {
+  if (idx >= size_) {
+    throw std::out_of_range("out of range");
+  }
+  return (*this)[idx];
+}
+
+template <typename T, typename Allocator>
+template <typename... Args>
+void CowDeque<T, Allocator>::emplace_back(Args&&... args) {
+  if (blocks_.empty()) {
+    start_block();
+  }
+  size_t bucket = blocks_.size() - 1;
+  if (view_end(bucket) == kBlockSize) {
+    Block* block = create_block(0);
+    try {
+      blocks_.push_back(block);
+    } catch (...) {
+      release(block);
+      throw;
+    }
+    ++bucket;
+  }
+  size_t elem = view_end(bucket);
+  Block* block = own(bucket);
+  trim(block, block->lo, elem);
+  alloc_traits::construct(alloc_, block->data + elem,
+                          std::forward<Args>(args)...);
+  ++block->hi;
+  ++size_;
+}
+
+template <typename T, typename Allocator>
+template <typename... Args>
+void CowDeque<T, Allocator>::emplace_front(Args&&... args) {
+  if (blocks_.empty()) {
+    start_block();
+  }
+  if (front_elem_ == 0) {
+    Block* block = create_block(kBlockSize);
+    try {
+      blocks_.push_front(block);
+    } catch (...) {
+      release(block);
+      throw;
+    }
+    front_elem_ = kBlockSize;
+  }
+  size_t elem = front_elem_;
+  Block* block = own(0);
+  trim(block, elem, block->hi);
+  alloc_traits::construct(alloc_, block->data + elem - 1,
+                          std::forward<Args>(args)...);
+  --block->lo;
+  --front_elem_;
+  ++size_;
+}
+
+template <typename T, typename Allocator>
+void CowDeque<T, Allocator>::pop_back() {
+  if (size_ == 0) {
+    return;
+  }
+  size_t bucket = blocks_.size() - 1;
+  size_t elem = view_end(bucket);
+  Block* block = blocks_[bucket];
+  if (block->refs.load(std::memory_order_acquire) == 1) {
+    trim(block, view_begin(bucket), elem - 1);
+  }
+  --size_;
+  if (size_ == 0) {
+    clear();
+  } else if (elem - 1 == view_begin(bucket)) {
+    release(block);
+    blocks_.pop_back();
+  }
+}
+
+template <typename T, typename Allocator>
+void CowDeque<T, Allocator>::pop_front() {
+  if (size_ == 0) {
+    return;
+  }
+  Block* block = blocks_[0];
+  if (block->refs.load(std::memory_order_acquire) == 1) {
+    trim(block, front_elem_ + 1, view_end(0));
+  }
+  ++front_elem_;
+  --size_;
+  if (size_ == 0) {
+    clear();
+  } else if (front_elem_ == kBlockSize) {
+    release(block);
+    blocks_.pop_front();
+    front_elem_ = 0;
+  }
+}
+
+template <typename T, typename Allocator>
+void CowDeque<T, Allocator>::clear() {
+  for (Block* block : blocks_) {
+    release(block);
+  }
+  blocks_.clear();
+  front_elem_ = 0;
+  size_ = 0;
+}
+
+template <typename T, typename Allocator>
+typename CowDeque<T, Allocator>::const_iterator CowDeque<T, Allocator>::insert(
+    const_iterator pos, const T& value) {
+  size_t idx = pos.idx_;
+  if (idx == 0) {
+    emplace_front(value);
+    return begin();
+  }
+  if (idx == size_) {
+    emplace_back(value);
+    return end() - 1;
+  }
+  T copy(value);
+  emplace_back(std::move((*this)[size_ - 1]));
+  for (size_t kdx = size_ - 2; kdx > idx; --kdx) {
+    (*this)[kdx] = std::move((*this)[kdx - 1]);
+  }
+  (*this)[idx] = std::move(copy);
+  return begin() + idx;
+}
+
+template <typename T, typename Allocator>
+typename CowDeque<T, Allocator>::const_iterator CowDeque<T, Allocator>::erase(
+    const_iterator pos) {
+  size_t idx = pos.idx_;
+  if (idx >= size_) {
+    throw std::out_of_range("erase at end");
+  }
+  for (size_t kdx = idx; kdx + 1 < size_; ++kdx) {
+    (*this)[kdx] = std::move((*this)[kdx + 1]);
+  }
+  pop_back();
+  return begin() + idx;
+}
+
+template <typename T, typename Allocator>
+typename CowDeque<T, Allocator>::Block* CowDeque<T, Allocator>::create_block(
+    size_t pos) {
+  Block* block = block_alloc_traits::allocate(block_alloc_, 1);
+  try {
+    block_alloc_traits::construct(block_alloc_, block);
+    block->data = alloc_traits::allocate(alloc_, kBlockSize);
+  } catch (...) {
+    block_alloc_traits::deallocate(block_alloc_, block, 1);
+    throw;
+  }
+  block->lo = pos;
+  block->hi = pos;
+  return block;
+}
+
+template <typename T, typename Allocator>
+void CowDeque<T, Allocator>::release(Block* block) {
+  if (block->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+  for (size_t idx = block->lo; idx < block->hi; ++idx) {
+    alloc_traits::destroy(alloc_, block->data + idx);
+  }
+  alloc_traits::deallocate(alloc_, block->data, kBlockSize);
+  block_alloc_traits::destroy(block_alloc_, block);
+  block_alloc_traits::deallocate(block_alloc_, block, 1);
+}
+
+// Shrinks the constructed range of an unshared block to [from, to).
+template <typename T, typename Allocator>
+void CowDeque<T, Allocator>::trim(Block* block, size_t from, size_t to) {
+  for (; block->lo < from; ++block->lo) {
+    alloc_traits::destroy(alloc_, block->data + block->lo);
+  }
+  for (; block->hi > to; --block->hi) {
+    alloc_traits::destroy(alloc_, block->data + block->hi - 1);
+  }
+}
+
+// Returns the block at bucket, replacing it with a private copy of this
+// deque's view of it when another deque still references it.
+template <typename T, typename Allocator>
+typename CowDeque<T, Allocator>::Block* CowDeque<T, Allocator>::own(
+    size_t bucket) {
+  Block* block = blocks_[bucket];
+  if (block->refs.load(std::memory_order_acquire) == 1) {
+    return block;
+  }
+  size_t from = view_begin(bucket);
+  size_t to = view_end(bucket);
+  Block* copy = create_block(from);
+  try {
+    for (; copy->hi < to; ++copy->hi) {
+      alloc_traits::construct(alloc_, copy->data + copy->hi,
+                              block->data[copy->hi]);
+    }
+  } catch (...) {
+    release(copy);
+    throw;
+  }
+  release(block);
+  blocks_[bucket] = copy;
+  return copy;
+}
+
+template <typename T, typename Allocator>
+size_t CowDeque<T, Allocator>::view_begin(size_t bucket) const {
+  return (bucket == 0) ? front_elem_ : 0;
+}
+
+template <typename T, typename Allocator>
+size_t CowDeque<T, Allocator>::view_end(size_t bucket) const {
+  if (bucket + 1 < blocks_.size()) {
+    return kBlockSize;
+  }
+  return front_elem_ + size_ - (bucket * kBlockSize);
+}
+
+template <typename T, typename Allocator>
+void CowDeque<T, Allocator>::start_block() {
+  Block* block = create_block(kBlockSize / 2);
+  try {
+    blocks_.push_back(block);
+  } catch (...) {
+    release(block);
+    throw;
+  }
+  front_elem_ = kBlockSize / 2;
+}
+
+// Shares other's blocks, or copies its elements when the allocators differ
+// and the blocks cannot be released through ours.
+template <typename T, typename Allocator>
+void CowDeque<T, Allocator>::share(const CowDeque& other) {
+  if (alloc_ != other.alloc_) {
+    try {
+      for (const auto& value : other) {
+        emplace_back(value);
+      }
+    } catch (...) {
+      clear();
+      throw;
+    }
+    return;
+  }
+  blocks_ = other.blocks_;
+  for (Block* block : blocks_) {
+    block->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  front_elem_ = other.front_elem_;
+  size_ = other.size_;
+}
@@ -1,7 +1,45 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
 #include <cstring>
 #include <iterator>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <type_traits>
+
+// Types whose objects can be moved to new storage by copying their bytes and
+// forgetting the old copy. Deque then shifts and transfers them with memmove
+// instead of move-constructing and destroying one by one. Defaults to
+// trivially copyable types; specialize it to opt a type in. Types that point
+// into themselves, such as libstdc++'s std::string, must not be opted in.
+template <typename T>
+struct is_trivially_relocatable
+    : std::bool_constant<std::is_trivially_copyable_v<T>> {};
+
+template <typename T>
+struct is_trivially_relocatable<std::unique_ptr<T>> : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_trivially_relocatable_v =
+    is_trivially_relocatable<T>::value;
+
+// Elements per Deque bucket: 8 whatever the type, unless the allocator asks
+// for larger buckets with a static kBucketBytes. The bucket then holds the
+// largest power of two of elements that fits in kBucketBytes, and never
+// fewer than 8.
+template <typename T, typename Allocator>
+constexpr size_t DequeBucketSize() {
+  if constexpr (requires { Allocator::kBucketBytes; }) {
+    return std::bit_floor(
+        std::max<size_t>(8, Allocator::kBucketBytes / sizeof(T)));
+  } else {
+    return 8;
+  }
+}
 
 template <typename T, typename Allocator = std::allocator<T>>
 class Deque {
@@ -17,74 +55,141 @@ class Deque {
 
   Deque() = default;
 
-  Deque(const Allocator& alloc);
+  constexpr Deque(const Allocator& alloc);
 
-  Deque(size_t count, const Allocator& alloc = Allocator());
-  Deque(size_t count, const T& value, const Allocator& alloc = Allocator());
+  constexpr Deque(size_t count, const Allocator& alloc = Allocator());
+  constexpr Deque(size_t count, const T& value,
+                  const Allocator& alloc = Allocator());
 
-  Deque(std::initializer_list<T> init, const Allocator& alloc = Allocator());
+  constexpr Deque(std::initializer_list<T> init,
+                  const Allocator& alloc = Allocator());
 
-  Deque(const Deque& other);
-  Deque(Deque&& other) noexcept;
+  template <std::input_iterator InputIt>
+  constexpr Deque(InputIt first, InputIt last,
+                  const Allocator& alloc = Allocator());
 
-  ~Deque();
+  constexpr Deque(const Deque& other);
+  constexpr Deque(Deque&& other) noexcept;
 
-  Deque& operator=(const Deque& other);
-  Deque& operator=(Deque<T, Allocator>&& other);
+  constexpr ~Deque();
 
-  iterator begin() { return begin_; }
-  const_iterator begin() const { return begin_; }
-  const_iterator cbegin() const { return begin_; }
+  constexpr Deque& operator=(const Deque& other);
+  constexpr Deque& operator=(Deque<T, Allocator>&& other);
 
-  reverse_iterator rbegin() { return std::make_reverse_iterator(end()); }
-  const_reverse_iterator rbegin() const {
+  constexpr iterator begin() { return begin_; }
+  constexpr const_iterator begin() const { return begin_; }
+  constexpr const_iterator cbegin() const { return begin_; }
+
+  constexpr reverse_iterator rbegin() {
+    return std::make_reverse_iterator(end());
+  }
+  constexpr const_reverse_iterator rbegin() const {
     return std::make_reverse_iterator(end());
   }
-  const_reverse_iterator crbegin() const {
+  constexpr const_reverse_iterator crbegin() const {
     return std::make_reverse_iterator(cend());
   }
 
-  iterator end();
-  const_iterator end() const;
-  const_iterator cend() const;
+  constexpr iterator end();
+  constexpr const_iterator end() const;
+  constexpr const_iterator cend() const;
 
-  reverse_iterator rend() { return std::make_reverse_iterator(begin()); }
-  const_reverse_iterator rend() const {
+  constexpr reverse_iterator rend() {
     return std::make_reverse_iterator(begin());
   }
-  const_reverse_iterator crend() const {
+  constexpr const_reverse_iterator rend() const {
+    return std::make_reverse_iterator(begin());
+  }
+  constexpr const_reverse_iterator crend() const {
     return std::make_reverse_iterator(cbegin());
   }
 
-  [[nodiscard]] size_t size() const { return size_; }
-  [[nodiscard]] bool empty() const { return size_ == 0; }
-  [[nodiscard]] Allocator get_allocator() const { return alloc_; }
+  [[nodiscard]] constexpr size_t size() const { return size_; }
+  [[nodiscard]] constexpr bool empty() const { return size_ == 0; }
+  [[nodiscard]] constexpr Allocator get_allocator() const { return alloc_; }
 
-  T& operator[](size_t idx);
-  const T& operator[](size_t idx) const;
+  constexpr T& operator[](size_t idx);
+  constexpr const T& operator[](size_t idx) const;
 
-  T& at(size_t idx);
-  const T& at(size_t idx) const;
+  constexpr T& at(size_t idx);
+  constexpr const T& at(size_t idx) const;
 
   template <typename... Args>
-  void emplace_back(Args&&... args);
+  constexpr void emplace_back(Args&&... args);
 
   template <typename... Args>
-  void emplace_front(Args&&... args);
+  constexpr void emplace_front(Args&&... args);
+
+  constexpr void push_back(const T& value);
+  constexpr void push_back(T&& value);
+  constexpr void push_front(const T& value);
+  constexpr void push_front(T&& value);
+
+  constexpr void pop_back();
+  constexpr void pop_front();
+  // Drops the first count elements (all, if fewer), a block at a time.
+  constexpr void pop_front(size_t count);
+
+  constexpr void clear();
+
+  // These keep every block already in the map and construct block by block
+  // behind the last element, allocating only what does not fit.
+  constexpr void resize(size_t count);
+  constexpr void resize(size_t count, const T& value);
+  // Like resize(count), but trivially default-constructible elements are
+  // left uninitialized.
+  constexpr void resize_for_overwrite(size_t count);
+
+  constexpr void assign(size_t count, const T& value);
+  template <std::input_iterator InputIt>
+  constexpr void assign(InputIt first, InputIt last);
+  constexpr void assign(std::initializer_list<T> init) {
+    assign(init.begin(), init.end());
+  }
+
+  // Appends every element of range. A contiguous range of T goes in with one
+  // memcpy per block when T is trivially copyable.
+  template <std::ranges::input_range Range>
+  constexpr void append_range(Range&& range);
 
-  void push_back(const T& value);
-  void push_back(T&& value);
-  void push_front(const T& value);
-  void push_front(T&& value);
+  template <typename... Args>
+  constexpr iterator emplace(iterator pos, Args&&... args);
+  constexpr iterator insert(iterator pos, const T& value) {
+    return emplace(pos, value);
+  }
+  constexpr iterator insert(iterator pos, T&& value) {
+    return emplace(pos, std::move(value));
+  }
 
-  void pop_back();
-  void pop_front();
+  constexpr iterator erase(iterator pos);
 
-  void clear();
+  // Whole blocks change owner when both deques sit at the same offset within
+  // their blocks; otherwise the shorter side is moved element by element.
+  // Unequal allocators always fall back to moving elements.
+  constexpr void append_deque(Deque&& other);
+  constexpr void prepend_deque(Deque&& other);
 
-  iterator insert(iterator pos, const T& value);
+  // Leaves [begin, pos) here and returns [pos, end). Only the block holding
+  // pos has its elements moved.
+  constexpr Deque split_at(iterator pos);
 
-  iterator erase(iterator pos);
+  [[nodiscard]] constexpr size_t segment_count() const;
+  constexpr std::span<T> segment(size_t idx);
+  constexpr std::span<const T> segment(size_t idx) const;
+  constexpr auto segments() {
+    return std::views::iota(size_t{0}, segment_count()) |
+           std::views::transform([this](size_t idx) { return segment(idx); });
+  }
+  constexpr auto segments() const {
+    return std::views::iota(size_t{0}, segment_count()) |
+           std::views::transform([this](size_t idx) { return segment(idx); });
+  }
+  [[nodiscard]] constexpr size_t segment_offset(size_t idx) const;
+  // Segment that holds element idx.
+  [[nodiscard]] constexpr size_t segment_index(size_t idx) const {
+    return (begin_.elem_ + idx) / kBucketSize;
+  }
+  void prefetch_segment(size_t idx) const;
 
  private:
   using alloc = Allocator;
@@ -92,21 +197,33 @@ class Deque {
   using bucket_alloc = typename alloc_traits::template rebind_alloc<T*>;
   using bucket_alloc_traits = typename alloc_traits::template rebind_traits<T*>;
 
-  void scale(size_t new_buckets_count);
+  constexpr void scale(size_t new_buckets_count);
   template <typename... Args>
-  void init(size_t count, Args&&... args);
+  constexpr void init(size_t count, Args&&... args);
   template <typename... Args>
-  void init_particularly(size_t count, size_t start, size_t end,
-                         Args&&... args);
-  void clear_particularly(size_t count, size_t start, size_t end);
-
-  void set_null();
-  void clear_buckets();
+  constexpr void init_particularly(size_t count, size_t start, size_t end,
+                                   Args&&... args);
+  constexpr void clear_particularly(size_t count, size_t start,
+                                    size_t end);
+
+  constexpr void set_null();
+  constexpr void join_blocks(Deque& other);
+  constexpr void reserve_back(size_t count);
+  template <typename Construct>
+  constexpr void construct_back(size_t count, Construct construct);
+  constexpr void truncate(size_t count);
+  constexpr void relocate(T* dest, T* src, size_t count);
+  constexpr void shift_back_raw(iterator first);
+  constexpr void shift_front_raw(iterator first);
+  constexpr T** allocate_map(size_t count);
+  static constexpr void copy_map(T** dest, T* const* src, size_t count);
+  constexpr void deallocate_map(T** map, size_t count);
 
   template <typename... Args>
-  void set_first(Args&&... value);
+  constexpr void set_first(Args&&... value);
 
-  static const size_t kBucketSize = 8;
+  // Power of two, so that iterator arithmetic is shifts and masks.
+  static constexpr size_t kBucketSize = DequeBucketSize<T, Allocator>();
   T** data_{nullptr};
   size_t size_{0};
   size_t buckets_{0};
@@ -128,58 +245,63 @@ class Deque<T, Allocator>::Iterator {
   using reference = value_type&;
   using difference_type = std::ptrdiff_t;
   using iterator_category = std::random_access_iterator_tag;
-  using iterator_concept = std::contiguous_iterator_tag;
+  using iterator_concept = std::random_access_iterator_tag;
 
-  Iterator(storage_pointer data, size_t bucket, size_t elem)
+  Iterator() = default;
+  constexpr Iterator(storage_pointer data, size_t bucket, size_t elem)
       : data_(data), bucket_(bucket), elem_(elem) {}
 
-  Iterator& operator++();
+  constexpr Iterator& operator++();
 
-  Iterator operator++(int);
+  constexpr Iterator operator++(int);
 
-  Iterator& operator--();
+  constexpr Iterator& operator--();
 
-  Iterator operator--(int);
+  constexpr Iterator operator--(int);
 
-  Iterator operator+(difference_type value);
+  constexpr Iterator operator+(difference_type value);
 
-  Iterator operator+(difference_type value) const;
+  constexpr Iterator operator+(difference_type value) const;
 
-  Iterator operator-(difference_type value);
+  constexpr Iterator operator-(difference_type value);
 
-  Iterator operator-(difference_type value) const;
+  constexpr Iterator operator-(difference_type value) const;
 
-  Iterator& operator+=(difference_type value);
+  constexpr Iterator& operator+=(difference_type value);
 
-  Iterator& operator-=(difference_type value);
+  constexpr Iterator& operator-=(difference_type value);
 
   bool operator==(const Iterator& other) const = default;
   auto operator<=>(const Iterator& other) const = default;
 
-  difference_type operator-(const Iterator& other) const;
+  constexpr difference_type operator-(const Iterator& other) const;
 
-  reference operator*() const { return data_[bucket_][elem_]; }
-  pointer operator->() const { return data_[bucket_] + elem_; }
+  constexpr reference operator*() const { return data_[bucket_][elem_]; }
+  constexpr pointer operator->() const { return data_[bucket_] + elem_; }
 
-  operator Iterator<true>() const {
+  constexpr operator Iterator<true>() const {
     return Iterator<true>(data_, bucket_, elem_);
   }
 
  private:
-  static const size_t kBucketSize = 8;
-  storage_pointer data_;
-  size_t bucket_;
-  size_t elem_;
+  friend class Deque;
+
+  static constexpr size_t kBucketSize = Deque::kBucketSize;
+  storage_pointer data_{nullptr};
+  size_t bucket_{0};
+  size_t elem_{0};
 };
 
 // Deque
 
 template <typename T, typename Allocator>
-Deque<T, Allocator>::Deque(const Allocator& alloc) : alloc_(alloc) {}
+constexpr Deque<T, Allocator>::Deque(const Allocator& alloc)
+    : alloc_(alloc), bucket_alloc_(alloc) {}
 
 template <typename T, typename Allocator>
-void Deque<T, Allocator>::clear_particularly(size_t count, size_t start,
-                                             size_t end) {
+constexpr void Deque<T, Allocator>::clear_particularly(size_t count,
+                                                       size_t start,
+                                                       size_t end) {
   size_t new_cap = ((count - 1) / kBucketSize) + 1;
   size_t deleted_num = 0;
   for (size_t idx = 0; idx < new_cap; ++idx) {
@@ -194,13 +316,14 @@ void Deque<T, Allocator>::clear_particularly(size_t count, size_t start,
     }
     alloc_traits::deallocate(alloc_, data_[idx], kBucketSize);
   }
-  bucket_alloc_traits::deallocate(bucket_alloc_, data_, new_cap);
+  deallocate_map(data_, new_cap);
 }
 
 template <typename T, typename Allocator>
 template <typename... Args>
-void Deque<T, Allocator>::init_particularly(size_t count, size_t start,
-                                            size_t end, Args&&... args) {
+constexpr void Deque<T, Allocator>::init_particularly(size_t count,
+                                                      size_t start, size_t end,
+                                                      Args&&... args) {
   size_t new_cap = ((count - 1) / kBucketSize) + 1;
   try {
     for (size_t idx = start; idx < end; ++idx) {
@@ -221,7 +344,7 @@ void Deque<T, Allocator>::init_particularly(size_t count, size_t start,
 
 template <typename T, typename Allocator>
 template <typename... Args>
-void Deque<T, Allocator>::init(size_t count, Args&&... args) {
+constexpr void Deque<T, Allocator>::init(size_t count, Args&&... args) {
   if (count == 0) {
     return;
   }
@@ -264,27 +387,31 @@ void Deque<T, Allocator>::init(size_t count, Args&&... args) {
 }
 
 template <typename T, typename Allocator>
-Deque<T, Allocator>::Deque(size_t count, const Allocator& alloc)
-    : alloc_(alloc) {
+constexpr Deque<T, Allocator>::Deque(size_t count, const Allocator& alloc)
+    : alloc_(alloc), bucket_alloc_(alloc) {
   init(count);
 }
 
 template <typename T, typename Allocator>
-Deque<T, Allocator>::Deque(size_t count, const T& value, const Allocator& alloc)
-    : alloc_(alloc) {
+constexpr Deque<T, Allocator>::Deque(size_t count, const T& value,
+                                     const Allocator& alloc)
+    : alloc_(alloc), bucket_alloc_(alloc) {
   init(count, value);
 }
 
 template <typename T, typename Allocator>
-Deque<T, Allocator>::Deque(const Deque& other) : size_(other.size_) {
-  if (other.data_ == nullptr) {
-    return;
-  }
+constexpr Deque<T, Allocator>::Deque(const Deque& other) : size_(other.size_) {
   alloc_ = alloc_traits::select_on_container_copy_construction(other.alloc_);
   bucket_alloc_ = bucket_alloc_traits::select_on_container_copy_construction(
       other.bucket_alloc_);
-  scale(other.buckets_);
-  buckets_ = other.buckets_;
+  if (other.size_ == 0) {
+    return;
+  }
+  // Sized to the elements rather than to other's map, so that copies of a
+  // copy do not keep doubling their spare capacity.
+  size_t buckets = ((other.size_ - 1) / kBucketSize) + 1;
+  scale(buckets);
+  buckets_ = buckets;
   begin_ = Iterator<false>(data_, 0, 0);
   end_ = begin_;
   try {
@@ -299,20 +426,20 @@ Deque<T, Allocator>::Deque(const Deque& other) : size_(other.size_) {
     for (size_t kdx = 0; kdx < buckets_; ++kdx) {
       alloc_traits::deallocate(alloc_, data_[kdx], kBucketSize);
     }
-    bucket_alloc_traits::deallocate(bucket_alloc_, data_, buckets_);
+    deallocate_map(data_, buckets_);
     throw;
   }
 }
 
 template <typename T, typename Allocator>
-Deque<T, Allocator>::Deque(Deque&& other) noexcept {
+constexpr Deque<T, Allocator>::Deque(Deque&& other) noexcept {
   *this = std::move(other);
 }
 
 template <typename T, typename Allocator>
-Deque<T, Allocator>::Deque(std::initializer_list<T> init,
-                           const Allocator& alloc)
-    : alloc_(alloc), size_(init.size()) {
+constexpr Deque<T, Allocator>::Deque(std::initializer_list<T> init,
+                                     const Allocator& alloc)
+    : size_(init.size()), alloc_(alloc), bucket_alloc_(alloc) {
   if (init.size() == 0) {
     return;
   }
@@ -326,21 +453,34 @@ Deque<T, Allocator>::Deque(std::initializer_list<T> init,
       ++iter;
     }
   } catch (...) {
+    end_ = iter;
     clear();
-    bucket_alloc_traits::deallocate(bucket_alloc_, data_, buckets_);
     throw;
   }
   end_ = iter;
 }
 
 template <typename T, typename Allocator>
-Deque<T, Allocator>::~Deque() {
+template <std::input_iterator InputIt>
+constexpr Deque<T, Allocator>::Deque(InputIt first, InputIt last,
+                                     const Allocator& alloc)
+    : alloc_(alloc), bucket_alloc_(alloc) {
+  try {
+    assign(first, last);
+  } catch (...) {
+    clear();
+    throw;
+  }
+}
+
+template <typename T, typename Allocator>
+constexpr Deque<T, Allocator>::~Deque() {
   clear();
-  bucket_alloc_traits::deallocate(bucket_alloc_, data_, buckets_);
 }
 
 template <typename T, typename Allocator>
-Deque<T, Allocator>& Deque<T, Allocator>::operator=(const Deque& other) {
+constexpr Deque<T, Allocator>& Deque<T, Allocator>::operator=(
+    const Deque& other) {
   if (&other == this) {
     return *this;
   }
@@ -358,7 +498,7 @@ Deque<T, Allocator>& Deque<T, Allocator>::operator=(const Deque& other) {
 }
 
 template <typename T, typename Allocator>
-Deque<T, Allocator>& Deque<T, Allocator>::operator=(
+constexpr Deque<T, Allocator>& Deque<T, Allocator>::operator=(
     Deque<T, Allocator>&& other) {
   if (&other == this) {
     return *this;
@@ -366,7 +506,6 @@ Deque<T, Allocator>& Deque<T, Allocator>::operator=(
   if (alloc_ == other.alloc_ ||
       alloc_traits::propagate_on_container_move_assignment::value) {
     clear();
-    bucket_alloc_traits::deallocate(bucket_alloc_, data_, buckets_);
     data_ = std::move(other.data_);
     size_ = other.size_;
     buckets_ = other.buckets_;
@@ -381,9 +520,6 @@ Deque<T, Allocator>& Deque<T, Allocator>::operator=(
     return *this;
   }
   clear();
-  if (data_ != nullptr) {
-    bucket_alloc_traits::deallocate(bucket_alloc_, data_, buckets_);
-  }
   scale(other.buckets_);
   buckets_ = other.buckets_;
   begin_ = Iterator<false>(data_, 0, 0);
@@ -396,43 +532,41 @@ Deque<T, Allocator>& Deque<T, Allocator>::operator=(
     size_ = other.size_;
   } catch (...) {
     clear();
-    bucket_alloc_traits::deallocate(bucket_alloc_, data_, buckets_);
-    set_null();
     throw;
   }
   other.clear();
-  other.clear_buckets();
-  other.data_ = nullptr;
   return *this;
 }
 
 template <typename T, typename Allocator>
-typename Deque<T, Allocator>::iterator Deque<T, Allocator>::end() {
+constexpr typename Deque<T, Allocator>::iterator Deque<T, Allocator>::end() {
   return end_;
 }
 
 template <typename T, typename Allocator>
-typename Deque<T, Allocator>::const_iterator Deque<T, Allocator>::end() const {
+constexpr typename Deque<T, Allocator>::const_iterator
+Deque<T, Allocator>::end() const {
   return end_;
 }
 
 template <typename T, typename Allocator>
-typename Deque<T, Allocator>::const_iterator Deque<T, Allocator>::cend() const {
+constexpr typename Deque<T, Allocator>::const_iterator
+Deque<T, Allocator>::cend() const {
   return end_;
 }
 
 template <typename T, typename Allocator>
-T& Deque<T, Allocator>::operator[](size_t idx) {
+constexpr T& Deque<T, Allocator>::operator[](size_t idx) {
   return *(begin_ + idx);
 }
 
 template <typename T, typename Allocator>
-const T& Deque<T, Allocator>::operator[](size_t idx) const {
+constexpr const T& Deque<T, Allocator>::operator[](size_t idx) const {
   return *(begin_ + idx);
 }
 
 template <typename T, typename Allocator>
-T& Deque<T, Allocator>::at(size_t idx) {
+constexpr T& Deque<T, Allocator>::at(size_t idx) {
   if (idx >= size_) {
     throw std::out_of_range("out of range");
   }
@@ -440,7 +574,7 @@ T& Deque<T, Allocator>::at(size_t idx) {
 }
 
 template <typename T, typename Allocator>
-const T& Deque<T, Allocator>::at(size_t idx) const {
+constexpr const T& Deque<T, Allocator>::at(size_t idx) const {
   if (idx >= size_) {
     throw std::out_of_range("out of range");
   }
@@ -449,19 +583,30 @@ const T& Deque<T, Allocator>::at(size_t idx) const {
 
 template <typename T, typename Allocator>
 template <typename... Args>
-void Deque<T, Allocator>::emplace_back(Args&&... args) {
+constexpr void Deque<T, Allocator>::emplace_back(Args&&... args) {
   if (data_ == nullptr) {
     set_first(std::forward<Args>(args)...);
     return;
   }
-  if (&*(end_ - 1) == &data_[buckets_ - 1][kBucketSize - 1]) {
-    size_t new_buckets_count = (buckets_ * 2) + 1;
-    scale(new_buckets_count);
-    end_ = Iterator<false>(data_, ((buckets_ + 1) / 2) + buckets_ - 1,
-                           kBucketSize - 1) +
-           1;
-    begin_ = end_ - size_;
-    buckets_ = new_buckets_count;
+  // Compare positions rather than addresses: an emptied deque may have end_
+  // at the very first slot, where end_ - 1 is outside the map.
+  if (end_.bucket_ == buckets_) {
+    if (begin_.bucket_ > 0 && begin_.bucket_ >= buckets_ / 2) {
+      // Queue-like use leaves free blocks at the front; cycle them to the
+      // back instead of growing the map.
+      size_t shift = begin_.bucket_;
+      std::rotate(data_, data_ + shift, data_ + buckets_);
+      begin_.bucket_ -= shift;
+      end_.bucket_ -= shift;
+    } else {
+      size_t new_buckets_count = (buckets_ * 2) + 1;
+      scale(new_buckets_count);
+      end_ = Iterator<false>(data_, ((buckets_ + 1) / 2) + buckets_ - 1,
+                             kBucketSize - 1) +
+             1;
+      begin_ = end_ - size_;
+      buckets_ = new_buckets_count;
+    }
   }
   alloc_traits::construct(alloc_, &*end_, std::forward<Args>(args)...);
   ++size_;
@@ -469,28 +614,35 @@ void Deque<T, Allocator>::emplace_back(Args&&... args) {
 }
 
 template <typename T, typename Allocator>
-void Deque<T, Allocator>::push_back(const T& value) {
+constexpr void Deque<T, Allocator>::push_back(const T& value) {
   emplace_back(value);
 }
 
 template <typename T, typename Allocator>
-void Deque<T, Allocator>::push_back(T&& value) {
+constexpr void Deque<T, Allocator>::push_back(T&& value) {
   emplace_back(std::move(value));
 }
 
 template <typename T, typename Allocator>
 template <typename... Args>
-void Deque<T, Allocator>::emplace_front(Args&&... args) {
+constexpr void Deque<T, Allocator>::emplace_front(Args&&... args) {
   if (data_ == nullptr) {
     set_first(std::forward<Args>(args)...);
     return;
   }
-  if (&*begin_ == &data_[0][0]) {
-    size_t new_buckets_count = (buckets_ * 2) + 1;
-    scale(new_buckets_count);
-    begin_ = Iterator<false>(data_, (buckets_ + 1) / 2, 0);
-    end_ = begin_ + size_;
-    buckets_ = new_buckets_count;
+  if (begin_.bucket_ == 0 && begin_.elem_ == 0) {
+    size_t free_back = buckets_ - end_.bucket_ - (end_.elem_ != 0 ? 1 : 0);
+    if (free_back > 0 && free_back >= buckets_ / 2) {
+      std::rotate(data_, data_ + buckets_ - free_back, data_ + buckets_);
+      begin_.bucket_ += free_back;
+      end_.bucket_ += free_back;
+    } else {
+      size_t new_buckets_count = (buckets_ * 2) + 1;
+      scale(new_buckets_count);
+      begin_ = Iterator<false>(data_, (buckets_ + 1) / 2, 0);
+      end_ = begin_ + size_;
+      buckets_ = new_buckets_count;
+    }
   }
   alloc_traits::construct(alloc_, &*(begin_ - 1), std::forward<Args>(args)...);
   ++size_;
@@ -498,17 +650,17 @@ void Deque<T, Allocator>::emplace_front(Args&&... args) {
 }
 
 template <typename T, typename Allocator>
-void Deque<T, Allocator>::push_front(const T& value) {
+constexpr void Deque<T, Allocator>::push_front(const T& value) {
   emplace_front(value);
 }
 
 template <typename T, typename Allocator>
-void Deque<T, Allocator>::push_front(T&& value) {
+constexpr void Deque<T, Allocator>::push_front(T&& value) {
   emplace_front(std::move(value));
 }
 
 template <typename T, typename Allocator>
-void Deque<T, Allocator>::pop_back() {
+constexpr void Deque<T, Allocator>::pop_back() {
   if (size_ == 0) {
     return;
   }
@@ -518,7 +670,7 @@ void Deque<T, Allocator>::pop_back() {
 }
 
 template <typename T, typename Allocator>
-void Deque<T, Allocator>::pop_front() {
+constexpr void Deque<T, Allocator>::pop_front() {
   if (size_ == 0) {
     return;
   }
@@ -528,7 +680,23 @@ void Deque<T, Allocator>::pop_front() {
 }
 
 template <typename T, typename Allocator>
-void Deque<T, Allocator>::clear() {
+constexpr void Deque<T, Allocator>::pop_front(size_t count) {
+  count = std::min(count, size_);
+  while (count > 0) {
+    T* block = data_[begin_.bucket_];
+    size_t from = begin_.elem_;
+    size_t to = std::min(kBucketSize, from + count);
+    for (size_t idx = from; idx < to; ++idx) {
+      alloc_traits::destroy(alloc_, block + idx);
+    }
+    begin_ += to - from;
+    size_ -= to - from;
+    count -= to - from;
+  }
+}
+
+template <typename T, typename Allocator>
+constexpr void Deque<T, Allocator>::clear() {
   if (data_ == nullptr) {
     return;
   }
@@ -538,51 +706,328 @@ void Deque<T, Allocator>::clear() {
   for (size_t idx = 0; idx < buckets_; ++idx) {
     alloc_traits::deallocate(alloc_, data_[idx], kBucketSize);
   }
+  deallocate_map(data_, buckets_);
+  data_ = nullptr;
   set_null();
 }
 
 template <typename T, typename Allocator>
-typename Deque<T, Allocator>::iterator Deque<T, Allocator>::insert(
-    Deque::iterator pos, const T& value) {
+constexpr void Deque<T, Allocator>::resize(size_t count) {
+  if (count <= size_) {
+    truncate(count);
+    return;
+  }
+  construct_back(count - size_,
+                 [this](T* slot) { alloc_traits::construct(alloc_, slot); });
+}
+
+template <typename T, typename Allocator>
+constexpr void Deque<T, Allocator>::resize(size_t count, const T& value) {
+  if (count <= size_) {
+    truncate(count);
+    return;
+  }
+  construct_back(count - size_, [this, &value](T* slot) {
+    alloc_traits::construct(alloc_, slot, value);
+  });
+}
+
+template <typename T, typename Allocator>
+constexpr void Deque<T, Allocator>::resize_for_overwrite(size_t count) {
+  if (std::is_trivially_default_constructible_v<T> &&
+      !std::is_constant_evaluated()) {
+    if (count <= size_) {
+      truncate(count);
+      return;
+    }
+    reserve_back(count - size_);
+    end_ += count - size_;
+    size_ = count;
+  } else {
+    resize(count);
+  }
+}
+
+template <typename T, typename Allocator>
+constexpr void Deque<T, Allocator>::assign(size_t count, const T& value) {
+  size_t left = std::min(count, size_);
+  for (size_t seg = 0; left > 0; ++seg) {
+    auto span = segment(seg);
+    size_t step = std::min(left, span.size());
+    std::fill_n(span.data(), step, value);
+    left -= step;
+  }
+  resize(count, value);
+}
+
+template <typename T, typename Allocator>
+template <std::input_iterator InputIt>
+constexpr void Deque<T, Allocator>::assign(InputIt first, InputIt last) {
+  size_t written = 0;
+  for (size_t seg = 0, segs = segment_count(); seg < segs; ++seg) {
+    for (T& slot : segment(seg)) {
+      if (first == last) {
+        truncate(written);
+        return;
+      }
+      slot = *first;
+      ++first;
+      ++written;
+    }
+  }
+  if constexpr (std::forward_iterator<InputIt>) {
+    construct_back(std::distance(first, last), [this, &first](T* slot) {
+      alloc_traits::construct(alloc_, slot, *first);
+      ++first;
+    });
+  } else {
+    for (; first != last; ++first) {
+      emplace_back(*first);
+    }
+  }
+}
+
+template <typename T, typename Allocator>
+template <std::ranges::input_range Range>
+constexpr void Deque<T, Allocator>::append_range(Range&& range) {
+  if constexpr (std::ranges::contiguous_range<Range> &&
+                std::ranges::sized_range<Range> &&
+                std::same_as<std::ranges::range_value_t<Range>, T> &&
+                std::is_trivially_copyable_v<T>) {
+    if (!std::is_constant_evaluated()) {
+      const T* src = std::ranges::data(range);
+      size_t count = std::ranges::size(range);
+      reserve_back(count);
+      while (count > 0) {
+        size_t step = std::min(count, kBucketSize - end_.elem_);
+        std::memcpy(static_cast<void*>(data_[end_.bucket_] + end_.elem_),
+                    static_cast<const void*>(src), step * sizeof(T));
+        end_ += step;
+        size_ += step;
+        src += step;
+        count -= step;
+      }
+      return;
+    }
+  }
+  if constexpr (std::ranges::forward_range<Range>) {
+    auto first = std::ranges::begin(range);
+    construct_back(std::ranges::distance(range), [this, &first](T* slot) {
+      alloc_traits::construct(alloc_, slot, *first);
+      ++first;
+    });
+  } else {
+    for (auto&& value : range) {
+      emplace_back(std::forward<decltype(value)>(value));
+    }
+  }
+}
+
+template <typename T, typename Allocator>
+template <typename... Args>
+constexpr typename Deque<T, Allocator>::iterator Deque<T, Allocator>::emplace(
+    Deque::iterator pos, Args&&... args) {
   if (pos == begin()) {
-    emplace_front(value);
+    emplace_front(std::forward<Args>(args)...);
     return begin();
   }
   if (pos == end()) {
-    emplace_back(value);
+    emplace_back(std::forward<Args>(args)...);
     return end() - 1;
   }
   size_t edge = pos - begin();
-  emplace_back(value);
+  if (is_trivially_relocatable_v<T> && !std::is_constant_evaluated()) {
+    reserve_back(1);
+    alignas(T) std::byte staged[sizeof(T)];
+    alloc_traits::construct(alloc_, reinterpret_cast<T*>(staged),
+                            std::forward<Args>(args)...);
+    auto dest = begin() + edge;
+    shift_back_raw(dest);
+    std::memcpy(static_cast<void*>(&*dest), staged, sizeof(T));
+    ++end_;
+    ++size_;
+    return dest;
+  }
+  // Built first, since args may refer to an element about to be shifted.
+  T value(std::forward<Args>(args)...);
+  emplace_back(std::move(*(end() - 1)));
   auto dest = begin() + edge;
-  for (auto iter = end() - 1; iter != dest; --iter) {
+  for (auto iter = end() - 2; iter != dest; --iter) {
     *iter = std::move(*(iter - 1));
   }
-  *dest = value;
+  *dest = std::move(value);
   return dest;
 }
 
 template <typename T, typename Allocator>
-typename Deque<T, Allocator>::iterator Deque<T, Allocator>::erase(
+constexpr typename Deque<T, Allocator>::iterator Deque<T, Allocator>::erase(
     Deque::iterator pos) {
   if (pos == end()) {
     throw;
   }
-  auto next = pos + 1;
+  size_t edge = pos - begin();
+  if (is_trivially_relocatable_v<T> && !std::is_constant_evaluated()) {
+    alloc_traits::destroy(alloc_, &*pos);
+    shift_front_raw(pos);
+    --end_;
+    --size_;
+    return begin() + edge;
+  }
   for (auto iter = pos; iter != end() - 1; ++iter) {
     *iter = std::move(*(iter + 1));
   }
   pop_back();
-  return next;
+  return begin() + edge;
+}
+
+template <typename T, typename Allocator>
+constexpr void Deque<T, Allocator>::append_deque(Deque&& other) {
+  if (&other == this || other.size_ == 0) {
+    return;
+  }
+  if (alloc_ != other.alloc_) {
+    for (auto iter = other.begin_; iter != other.end_; ++iter) {
+      emplace_back(std::move(*iter));
+    }
+    other.clear();
+    return;
+  }
+  if (size_ == 0) {
+    *this = std::move(other);
+    return;
+  }
+  if (end_.elem_ == other.begin_.elem_) {
+    join_blocks(other);
+    return;
+  }
+  if (other.size_ <= size_) {
+    for (auto iter = other.begin_; iter != other.end_; ++iter) {
+      emplace_back(std::move(*iter));
+    }
+    other.clear();
+    return;
+  }
+  for (auto iter = end_; iter != begin_;) {
+    --iter;
+    other.emplace_front(std::move(*iter));
+  }
+  *this = std::move(other);
 }
 
 template <typename T, typename Allocator>
-void Deque<T, Allocator>::scale(size_t new_buckets_count) {
+constexpr void Deque<T, Allocator>::prepend_deque(Deque&& other) {
+  if (&other == this || other.size_ == 0) {
+    return;
+  }
+  if (alloc_ != other.alloc_) {
+    for (auto iter = other.end_; iter != other.begin_;) {
+      --iter;
+      emplace_front(std::move(*iter));
+    }
+    other.clear();
+    return;
+  }
+  other.append_deque(std::move(*this));
+  *this = std::move(other);
+}
+
+template <typename T, typename Allocator>
+constexpr Deque<T, Allocator> Deque<T, Allocator>::split_at(iterator pos) {
+  Deque result(alloc_);
+  if (pos == end_) {
+    return result;
+  }
+  if (pos == begin_) {
+    result = std::move(*this);
+    return result;
+  }
+  size_t bucket = pos.bucket_;
+  size_t elem = pos.elem_;
+  size_t keep = (elem == 0) ? bucket : bucket + 1;
+  size_t result_buckets = buckets_ - bucket;
+  T** left = allocate_map(keep);
+  T** right = nullptr;
+  T* block = nullptr;
+  try {
+    right = result.allocate_map(result_buckets);
+    if (elem != 0) {
+      block = alloc_traits::allocate(alloc_, kBucketSize);
+    }
+  } catch (...) {
+    if (right != nullptr) {
+      result.deallocate_map(right, result_buckets);
+    }
+    deallocate_map(left, keep);
+    throw;
+  }
+  copy_map(left, data_, keep);
+  copy_map(right, data_ + bucket, result_buckets);
+  if (elem != 0) {
+    size_t last = (end_.bucket_ == bucket) ? end_.elem_ : kBucketSize;
+    relocate(block + elem, data_[bucket] + elem, last - elem);
+    right[0] = block;
+  }
+  result.data_ = right;
+  result.buckets_ = result_buckets;
+  result.size_ = end_ - pos;
+  result.begin_ = Iterator<false>(right, 0, elem);
+  result.end_ = Iterator<false>(right, end_.bucket_ - bucket, end_.elem_);
+  deallocate_map(data_, buckets_);
+  data_ = left;
+  buckets_ = keep;
+  size_ -= result.size_;
+  begin_ = Iterator<false>(data_, begin_.bucket_, begin_.elem_);
+  end_ = Iterator<false>(data_, bucket, elem);
+  return result;
+}
+
+template <typename T, typename Allocator>
+constexpr size_t Deque<T, Allocator>::segment_count() const {
+  if (size_ == 0) {
+    return 0;
+  }
+  auto last = end_ - 1;
+  return last.bucket_ - begin_.bucket_ + 1;
+}
+
+template <typename T, typename Allocator>
+constexpr std::span<T> Deque<T, Allocator>::segment(size_t idx) {
+  auto last = end_ - 1;
+  size_t bucket = begin_.bucket_ + idx;
+  size_t from = (idx == 0) ? begin_.elem_ : 0;
+  size_t to = (bucket == last.bucket_) ? last.elem_ + 1 : kBucketSize;
+  return {data_[bucket] + from, to - from};
+}
+
+template <typename T, typename Allocator>
+constexpr std::span<const T> Deque<T, Allocator>::segment(size_t idx) const {
+  return const_cast<Deque*>(this)->segment(idx);
+}
+
+template <typename T, typename Allocator>
+constexpr size_t Deque<T, Allocator>::segment_offset(size_t idx) const {
+  if (idx == 0) {
+    return 0;
+  }
+  if (idx == segment_count()) {
+    return size_;
+  }
+  return (kBucketSize - begin_.elem_) + ((idx - 1) * kBucketSize);
+}
+
+template <typename T, typename Allocator>
+void Deque<T, Allocator>::prefetch_segment(size_t idx) const {
+  if (idx < segment_count()) {
+    __builtin_prefetch(data_[begin_.bucket_ + idx]);
+  }
+}
+
+template <typename T, typename Allocator>
+constexpr void Deque<T, Allocator>::scale(size_t new_buckets_count) {
   if (new_buckets_count < buckets_ + 1) {
     return;
   }
-  T** new_data =
-      bucket_alloc_traits::allocate(bucket_alloc_, new_buckets_count);
+  T** new_data = allocate_map(new_buckets_count);
   size_t allocated_num = 0;
   try {
     for (size_t idx = 0; idx < (new_buckets_count - buckets_) / 2; ++idx) {
@@ -596,12 +1041,11 @@ void Deque<T, Allocator>::scale(size_t new_buckets_count) {
       }
       alloc_traits::deallocate(alloc_, new_data[idx], kBucketSize);
     }
-    bucket_alloc_traits::deallocate(bucket_alloc_, new_data, new_buckets_count);
+    deallocate_map(new_data, new_buckets_count);
     throw;
   }
   if (data_ != nullptr) {
-    std::memcpy(&new_data[(new_buckets_count - buckets_) / 2], data_,
-                buckets_ * sizeof(T*));
+    copy_map(&new_data[(new_buckets_count - buckets_) / 2], data_, buckets_);
   }
   try {
     for (size_t idx = ((new_buckets_count - buckets_) / 2) + buckets_;
@@ -616,20 +1060,229 @@ void Deque<T, Allocator>::scale(size_t new_buckets_count) {
       }
       alloc_traits::deallocate(alloc_, new_data[idx], kBucketSize);
     }
-    bucket_alloc_traits::deallocate(bucket_alloc_, new_data, new_buckets_count);
+    deallocate_map(new_data, new_buckets_count);
     throw;
   }
-  bucket_alloc_traits::deallocate(bucket_alloc_, data_, buckets_);
+  if (data_ != nullptr) {
+    deallocate_map(data_, buckets_);
+  }
   data_ = new_data;
 }
 
+// Concatenates the maps of two deques whose boundary offsets match. The
+// partial tail block of this deque is folded into the head block of other.
 template <typename T, typename Allocator>
-void Deque<T, Allocator>::clear_buckets() {
-  bucket_alloc_traits::deallocate(bucket_alloc_, data_, buckets_);
+constexpr void Deque<T, Allocator>::join_blocks(Deque& other) {
+  size_t keep = end_.bucket_;
+  size_t first = other.begin_.bucket_;
+  size_t new_buckets = keep + (other.buckets_ - first);
+  T** new_data = allocate_map(new_buckets);
+  if (end_.elem_ != 0) {
+    T* tail = data_[keep];
+    T* head = other.data_[first];
+    size_t from = (begin_.bucket_ == keep) ? begin_.elem_ : 0;
+    relocate(head + from, tail + from, end_.elem_ - from);
+  }
+  copy_map(new_data, data_, keep);
+  copy_map(new_data + keep, other.data_ + first, other.buckets_ - first);
+  for (size_t idx = keep; idx < buckets_; ++idx) {
+    alloc_traits::deallocate(alloc_, data_[idx], kBucketSize);
+  }
+  for (size_t idx = 0; idx < first; ++idx) {
+    alloc_traits::deallocate(alloc_, other.data_[idx], kBucketSize);
+  }
+  size_t end_bucket = keep + (other.end_.bucket_ - first);
+  deallocate_map(data_, buckets_);
+  other.deallocate_map(other.data_, other.buckets_);
+  data_ = new_data;
+  buckets_ = new_buckets;
+  size_ += other.size_;
+  begin_ = Iterator<false>(data_, begin_.bucket_, begin_.elem_);
+  end_ = Iterator<false>(data_, end_bucket, other.end_.elem_);
+  other.data_ = nullptr;
+  other.set_null();
 }
 
+// Makes room for count more elements behind end_. Free blocks in front of
+// begin_ are cycled to the back first; the map only grows if they are not
+// enough.
 template <typename T, typename Allocator>
-void Deque<T, Allocator>::set_null() {
+constexpr void Deque<T, Allocator>::reserve_back(size_t count) {
+  if (count == 0) {
+    return;
+  }
+  if (data_ == nullptr) {
+    size_t blocks = ((count - 1) / kBucketSize) + 1;
+    scale(blocks);
+    buckets_ = blocks;
+    begin_ = Iterator<false>(data_, 0, 0);
+    end_ = begin_;
+    return;
+  }
+  if (size_ == 0) {
+    begin_ = Iterator<false>(data_, 0, 0);
+    end_ = begin_;
+  }
+  size_t free_back = ((buckets_ - end_.bucket_) * kBucketSize) - end_.elem_;
+  if (free_back >= count) {
+    return;
+  }
+  size_t missing = count - free_back;
+  size_t shift = begin_.bucket_;
+  if (shift * kBucketSize >= missing) {
+    std::rotate(data_, data_ + shift, data_ + buckets_);
+    begin_.bucket_ -= shift;
+    end_.bucket_ -= shift;
+    return;
+  }
+  size_t extra = std::max(((missing - 1) / kBucketSize) + 1, buckets_);
+  T** new_data = allocate_map(buckets_ + extra);
+  size_t allocated = buckets_;
+  try {
+    for (; allocated < buckets_ + extra; ++allocated) {
+      new_data[allocated] = alloc_traits::allocate(alloc_, kBucketSize);
+    }
+  } catch (...) {
+    for (size_t idx = buckets_; idx < allocated; ++idx) {
+      alloc_traits::deallocate(alloc_, new_data[idx], kBucketSize);
+    }
+    deallocate_map(new_data, buckets_ + extra);
+    throw;
+  }
+  copy_map(new_data, data_, buckets_);
+  deallocate_map(data_, buckets_);
+  data_ = new_data;
+  buckets_ += extra;
+  begin_ = Iterator<false>(data_, begin_.bucket_, begin_.elem_);
+  end_ = Iterator<false>(data_, end_.bucket_, end_.elem_);
+}
+
+// Constructs count elements behind end_ one block at a time through
+// construct(slot). On an exception the deque is cut back to its old size.
+template <typename T, typename Allocator>
+template <typename Construct>
+constexpr void Deque<T, Allocator>::construct_back(size_t count,
+                                                   Construct construct) {
+  reserve_back(count);
+  size_t old_size = size_;
+  try {
+    while (count > 0) {
+      T* block = data_[end_.bucket_];
+      size_t from = end_.elem_;
+      size_t to = std::min(kBucketSize, from + count);
+      size_t idx = from;
+      try {
+        for (; idx < to; ++idx) {
+          construct(block + idx);
+        }
+      } catch (...) {
+        for (size_t kdx = from; kdx < idx; ++kdx) {
+          alloc_traits::destroy(alloc_, block + kdx);
+        }
+        throw;
+      }
+      end_ += to - from;
+      size_ += to - from;
+      count -= to - from;
+    }
+  } catch (...) {
+    truncate(old_size);
+    throw;
+  }
+}
+
+// Destroys elements from the back until count remain, one block at a time.
+// The blocks stay in the map.
+template <typename T, typename Allocator>
+constexpr void Deque<T, Allocator>::truncate(size_t count) {
+  while (size_ > count) {
+    size_t step =
+        std::min(size_ - count, (end_.elem_ == 0) ? kBucketSize : end_.elem_);
+    auto first = end_ - step;
+    T* block = data_[first.bucket_];
+    for (size_t idx = first.elem_; idx < first.elem_ + step; ++idx) {
+      alloc_traits::destroy(alloc_, block + idx);
+    }
+    end_ = first;
+    size_ -= step;
+  }
+}
+
+// Moves count elements into raw storage at dest, leaving src raw.
+template <typename T, typename Allocator>
+constexpr void Deque<T, Allocator>::relocate(T* dest, T* src, size_t count) {
+  if (is_trivially_relocatable_v<T> && !std::is_constant_evaluated()) {
+    std::memmove(static_cast<void*>(dest), static_cast<const void*>(src),
+                 count * sizeof(T));
+    return;
+  }
+  for (size_t idx = 0; idx < count; ++idx) {
+    alloc_traits::construct(alloc_, dest + idx, std::move(src[idx]));
+    alloc_traits::destroy(alloc_, src + idx);
+  }
+}
+
+// Moves the bytes of [first, end_) one slot towards the back, a block at a
+// time. The slot at end_ must be raw storage; the one at first is left raw.
+template <typename T, typename Allocator>
+constexpr void Deque<T, Allocator>::shift_back_raw(iterator first) {
+  auto hole = end_;
+  while (hole != first) {
+    T* block = data_[hole.bucket_];
+    if (hole.elem_ == 0) {
+      relocate(block, data_[hole.bucket_ - 1] + kBucketSize - 1, 1);
+      hole = Iterator<false>(data_, hole.bucket_ - 1, kBucketSize - 1);
+      continue;
+    }
+    size_t from = (first.bucket_ == hole.bucket_) ? first.elem_ : 0;
+    relocate(block + from + 1, block + from, hole.elem_ - from);
+    hole.elem_ = from;
+  }
+}
+
+// Moves the bytes of (first, end_) one slot towards the front, a block at a
+// time. The slot at first must be raw storage; the one at end_ - 1 is left
+// raw.
+template <typename T, typename Allocator>
+constexpr void Deque<T, Allocator>::shift_front_raw(iterator first) {
+  auto hole = first;
+  auto last = end_ - 1;
+  while (hole != last) {
+    T* block = data_[hole.bucket_];
+    if (hole.elem_ == kBucketSize - 1) {
+      relocate(block + kBucketSize - 1, data_[hole.bucket_ + 1], 1);
+      hole = Iterator<false>(data_, hole.bucket_ + 1, 0);
+      continue;
+    }
+    size_t to = (last.bucket_ == hole.bucket_) ? last.elem_ : kBucketSize - 1;
+    relocate(block + hole.elem_, block + hole.elem_ + 1, to - hole.elem_);
+    hole.elem_ = to;
+  }
+}
+
+template <typename T, typename Allocator>
+constexpr T** Deque<T, Allocator>::allocate_map(size_t count) {
+  return bucket_alloc_traits::allocate(bucket_alloc_, count);
+}
+
+// memcpy is not usable in constant evaluation.
+template <typename T, typename Allocator>
+constexpr void Deque<T, Allocator>::copy_map(T** dest, T* const* src,
+                                             size_t count) {
+  if (std::is_constant_evaluated()) {
+    std::copy_n(src, count, dest);
+  } else {
+    std::memcpy(dest, src, count * sizeof(T*));
+  }
+}
+
+template <typename T, typename Allocator>
+constexpr void Deque<T, Allocator>::deallocate_map(T** map, size_t count) {
+  bucket_alloc_traits::deallocate(bucket_alloc_, map, count);
+}
+
+template <typename T, typename Allocator>
+constexpr void Deque<T, Allocator>::set_null() {
   size_ = 0;
   buckets_ = 0;
   begin_ = Iterator<false>(nullptr, 0, 0);
@@ -638,14 +1291,16 @@ void Deque<T, Allocator>::set_null() {
 
 template <typename T, typename Allocator>
 template <typename... Args>
-void Deque<T, Allocator>::set_first(Args&&... value) {
+constexpr void Deque<T, Allocator>::set_first(Args&&... value) {
   scale(1);
   try {
     alloc_traits::construct(alloc_, &data_[0][kBucketSize / 2],
                             std::forward<Args>(value)...);
   } catch (...) {
     alloc_traits::deallocate(alloc_, data_[0], kBucketSize);
-    bucket_alloc_traits::deallocate(bucket_alloc_, data_, 1);
+    deallocate_map(data_, 1);
+    data_ = nullptr;
+    throw;
   }
   buckets_ = 1;
   size_ = 1;
@@ -657,7 +1312,7 @@ void Deque<T, Allocator>::set_first(Args&&... value) {
 
 template <typename T, typename Allocator>
 template <bool IsConst>
-typename Deque<T, Allocator>::template Iterator<IsConst>&
+constexpr typename Deque<T, Allocator>::template Iterator<IsConst>&
 Deque<T, Allocator>::Iterator<IsConst>::operator++() {
   ++elem_;
   if (elem_ == kBucketSize) {
@@ -669,7 +1324,7 @@ Deque<T, Allocator>::Iterator<IsConst>::operator++() {
 
 template <typename T, typename Allocator>
 template <bool IsConst>
-typename Deque<T, Allocator>::template Iterator<IsConst>
+constexpr typename Deque<T, Allocator>::template Iterator<IsConst>
 Deque<T, Allocator>::Iterator<IsConst>::operator++(int) {
   auto copy = *this;
   ++(*this);
@@ -678,7 +1333,7 @@ Deque<T, Allocator>::Iterator<IsConst>::operator++(int) {
 
 template <typename T, typename Allocator>
 template <bool IsConst>
-typename Deque<T, Allocator>::template Iterator<IsConst>&
+constexpr typename Deque<T, Allocator>::template Iterator<IsConst>&
 Deque<T, Allocator>::Iterator<IsConst>::operator--() {
   if (elem_ == 0) {
     elem_ = kBucketSize - 1;
@@ -691,7 +1346,7 @@ Deque<T, Allocator>::Iterator<IsConst>::operator--() {
 
 template <typename T, typename Allocator>
 template <bool IsConst>
-typename Deque<T, Allocator>::template Iterator<IsConst>
+constexpr typename Deque<T, Allocator>::template Iterator<IsConst>
 Deque<T, Allocator>::Iterator<IsConst>::operator--(int) {
   auto copy = *this;
   --(*this);
@@ -700,7 +1355,7 @@ Deque<T, Allocator>::Iterator<IsConst>::operator--(int) {
 
 template <typename T, typename Allocator>
 template <bool IsConst>
-typename Deque<T, Allocator>::template Iterator<IsConst>
+constexpr typename Deque<T, Allocator>::template Iterator<IsConst>
 Deque<T, Allocator>::Iterator<IsConst>::operator+(
     Deque::Iterator<IsConst>::difference_type value) {
   Iterator temp = *this;
@@ -710,7 +1365,7 @@ Deque<T, Allocator>::Iterator<IsConst>::operator+(
 
 template <typename T, typename Allocator>
 template <bool IsConst>
-typename Deque<T, Allocator>::template Iterator<IsConst>
+constexpr typename Deque<T, Allocator>::template Iterator<IsConst>
 Deque<T, Allocator>::Iterator<IsConst>::operator+(
     Deque::Iterator<IsConst>::difference_type value) const {
   Iterator temp = *this;
@@ -720,7 +1375,7 @@ Deque<T, Allocator>::Iterator<IsConst>::operator+(
 
 template <typename T, typename Allocator>
 template <bool IsConst>
-typename Deque<T, Allocator>::template Iterator<IsConst>
+constexpr typename Deque<T, Allocator>::template Iterator<IsConst>
 Deque<T, Allocator>::Iterator<IsConst>::operator-(
     Deque::Iterator<IsConst>::difference_type value) {
   Iterator temp = *this;
@@ -730,7 +1385,7 @@ Deque<T, Allocator>::Iterator<IsConst>::operator-(
 
 template <typename T, typename Allocator>
 template <bool IsConst>
-typename Deque<T, Allocator>::template Iterator<IsConst>
+constexpr typename Deque<T, Allocator>::template Iterator<IsConst>
 Deque<T, Allocator>::Iterator<IsConst>::operator-(
     Deque::Iterator<IsConst>::difference_type value) const {
   Iterator temp = *this;
@@ -740,7 +1395,7 @@ Deque<T, Allocator>::Iterator<IsConst>::operator-(
 
 template <typename T, typename Allocator>
 template <bool IsConst>
-typename Deque<T, Allocator>::template Iterator<IsConst>&
+constexpr typename Deque<T, Allocator>::template Iterator<IsConst>&
 Deque<T, Allocator>::Iterator<IsConst>::operator+=(
     Deque::Iterator<IsConst>::difference_type value) {
   if (value < 0) {
@@ -753,7 +1408,7 @@ Deque<T, Allocator>::Iterator<IsConst>::operator+=(
 
 template <typename T, typename Allocator>
 template <bool IsConst>
-typename Deque<T, Allocator>::template Iterator<IsConst>&
+constexpr typename Deque<T, Allocator>::template Iterator<IsConst>&
 Deque<T, Allocator>::Iterator<IsConst>::operator-=(
     Deque::Iterator<IsConst>::difference_type value) {
   if (value < 0) {
@@ -771,9 +1426,10 @@ Deque<T, Allocator>::Iterator<IsConst>::operator-=(
 
 template <typename T, typename Allocator>
 template <bool IsConst>
-typename Deque<T, Allocator>::template Iterator<IsConst>::difference_type
-Deque<T, Allocator>::Iterator<IsConst>::operator-(
-    const Iterator<IsConst>& other) const {
+constexpr
+    typename Deque<T, Allocator>::template Iterator<IsConst>::difference_type
+    Deque<T, Allocator>::Iterator<IsConst>::operator-(
+        const Iterator<IsConst>& other) const {
   if (bucket_ == other.bucket_) {
     return elem_ - other.elem_;
   }
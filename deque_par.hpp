@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "deque.hpp"
+
+namespace deque_par {
+
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool();
+
+  [[nodiscard]] size_t size() const { return workers_.size() + 1; }
+
+  // Calls func(idx) for every idx in [0, tasks) and blocks until all calls
+  // are done. The calling thread takes part in the work.
+  template <typename Func>
+  void run(size_t tasks, Func&& func);
+
+ private:
+  void work();
+
+  std::vector<std::thread> workers_;
+  Deque<std::function<void()>> jobs_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_{false};
+};
+
+inline ThreadPool::ThreadPool(size_t threads) {
+  for (size_t idx = 1; idx < std::max<size_t>(threads, 1); ++idx) {
+    workers_.emplace_back([this] { work(); });
+  }
+}
+
+inline ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+inline void ThreadPool::work() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock lock(mutex_);
+      cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+      if (jobs_.empty()) {
+        return;
+      }
+      job = std::move(jobs_[0]);
+      jobs_.pop_front();
+    }
+    job();
+  }
+}
+
+template <typename Func>
+void ThreadPool::run(size_t tasks, Func&& func) {
+  if (tasks == 0) {
+    return;
+  }
+  // Shared with helper jobs: a helper that is scheduled late finds no work
+  // left and never touches func.
+  struct Batch {
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    size_t tasks;
+    std::remove_reference_t<Func>* func;
+    std::exception_ptr error;
+    std::mutex error_mutex;
+  };
+  auto batch = std::make_shared<Batch>();
+  batch->tasks = tasks;
+  batch->func = &func;
+  auto drain = [batch] {
+    for (size_t idx = batch->next++; idx < batch->tasks;
+         idx = batch->next++) {
+      try {
+        (*batch->func)(idx);
+      } catch (...) {
+        std::lock_guard lock(batch->error_mutex);
+        if (!batch->error) {
+          batch->error = std::current_exception();
+        }
+      }
+      if (++batch->done == batch->tasks) {
+        batch->done.notify_all();
+      }
+    }
+  };
+  size_t helpers = std::min(workers_.size(), tasks - 1);
+  if (helpers > 0) {
+    {
+      std::lock_guard lock(mutex_);
+      for (size_t idx = 0; idx < helpers; ++idx) {
+        jobs_.push_back(drain);
+      }
+    }
+    cv_.notify_all();
+  }
+  drain();
+  for (size_t seen = batch->done.load(); seen != tasks;
+       seen = batch->done.load()) {
+    batch->done.wait(seen);
+  }
+  if (batch->error) {
+    std::rethrow_exception(batch->error);
+  }
+}
+
+inline ThreadPool& DefaultPool() {
+  static ThreadPool pool;
+  return pool;
+}
+
+namespace detail {
+
+// Splits segments [0, count) into at most `parts` ranges of whole segments.
+inline std::vector<size_t> SplitSegments(size_t count, size_t parts) {
+  parts = std::clamp<size_t>(parts, 1, std::max<size_t>(count, 1));
+  std::vector<size_t> bounds(parts + 1);
+  for (size_t idx = 0; idx <= parts; ++idx) {
+    bounds[idx] = count * idx / parts;
+  }
+  return bounds;
+}
+
+}  // namespace detail
+
+template <typename T, typename Allocator, typename Func>
+void for_each(Deque<T, Allocator>& deque, Func func,
+              ThreadPool& pool = DefaultPool()) {
+  auto bounds = detail::SplitSegments(deque.segment_count(), pool.size() * 4);
+  pool.run(bounds.size() - 1, [&](size_t task) {
+    for (size_t seg = bounds[task]; seg < bounds[task + 1]; ++seg) {
+      deque.prefetch_segment(seg + 1);
+      for (auto& value : deque.segment(seg)) {
+        func(value);
+      }
+    }
+  });
+}
+
+// dst must already hold at least src.size() elements.
+template <typename T, typename AllocT, typename U, typename AllocU,
+          typename UnaryOp>
+void transform(const Deque<T, AllocT>& src, Deque<U, AllocU>& dst, UnaryOp op,
+               ThreadPool& pool = DefaultPool()) {
+  auto bounds = detail::SplitSegments(src.segment_count(), pool.size() * 4);
+  pool.run(bounds.size() - 1, [&](size_t task) {
+    auto out = dst.begin() + src.segment_offset(bounds[task]);
+    for (size_t seg = bounds[task]; seg < bounds[task + 1]; ++seg) {
+      src.prefetch_segment(seg + 1);
+      for (const auto& value : src.segment(seg)) {
+        *out = op(value);
+        ++out;
+      }
+    }
+  });
+}
+
+// op must be associative; partial results are folded left to right.
+template <typename T, typename Allocator, typename Init,
+          typename BinaryOp = std::plus<>>
+Init reduce(const Deque<T, Allocator>& deque, Init init, BinaryOp op = {},
+            ThreadPool& pool = DefaultPool()) {
+  auto bounds = detail::SplitSegments(deque.segment_count(), pool.size() * 4);
+  std::vector<std::optional<Init>> partial(bounds.size() - 1);
+  pool.run(bounds.size() - 1, [&](size_t task) {
+    for (size_t seg = bounds[task]; seg < bounds[task + 1]; ++seg) {
+      deque.prefetch_segment(seg + 1);
+      for (const auto& value : deque.segment(seg)) {
+        partial[task] = partial[task] ? op(std::move(*partial[task]), value)
+                                      : Init(value);
+      }
+    }
+  });
+  for (auto& value : partial) {
+    if (value) {
+      init = op(std::move(init), std::move(*value));
+    }
+  }
+  return init;
+}
+
+template <typename T, typename Allocator, typename Compare = std::less<>>
+void sort(Deque<T, Allocator>& deque, Compare comp = {},
+          ThreadPool& pool = DefaultPool()) {
+  auto bounds = detail::SplitSegments(deque.segment_count(), pool.size());
+  std::vector<size_t> offsets(bounds.size());
+  for (size_t idx = 0; idx < bounds.size(); ++idx) {
+    offsets[idx] = deque.segment_offset(bounds[idx]);
+  }
+  size_t runs = offsets.size() - 1;
+  pool.run(runs, [&](size_t task) {
+    std::sort(deque.begin() + offsets[task], deque.begin() + offsets[task + 1],
+              comp);
+  });
+  for (size_t width = 1; width < runs; width *= 2) {
+    size_t pairs = (runs + (2 * width) - 1) / (2 * width);
+    pool.run(pairs, [&](size_t task) {
+      size_t first = task * 2 * width;
+      size_t middle = std::min(first + width, runs);
+      size_t last = std::min(first + (2 * width), runs);
+      std::inplace_merge(deque.begin() + offsets[first],
+                         deque.begin() + offsets[middle],
+                         deque.begin() + offsets[last], comp);
+    });
+  }
+}
+
+// Not stable. Returns the first element for which pred is false.
+template <typename T, typename Allocator, typename Pred>
+typename Deque<T, Allocator>::iterator partition(
+    Deque<T, Allocator>& deque, Pred pred, ThreadPool& pool = DefaultPool()) {
+  auto bounds = detail::SplitSegments(deque.segment_count(), pool.size());
+  std::vector<size_t> offsets(bounds.size());
+  for (size_t idx = 0; idx < bounds.size(); ++idx) {
+    offsets[idx] = deque.segment_offset(bounds[idx]);
+  }
+  size_t runs = offsets.size() - 1;
+  std::vector<size_t> splits(runs);
+  pool.run(runs, [&](size_t task) {
+    auto first = deque.begin() + offsets[task];
+    splits[task] =
+        std::partition(first, deque.begin() + offsets[task + 1], pred) -
+        deque.begin();
+  });
+  for (size_t width = 1; width < runs; width *= 2) {
+    size_t pairs = (runs + (2 * width) - 1) / (2 * width);
+    pool.run(pairs, [&](size_t task) {
+      size_t first = task * 2 * width;
+      size_t middle = first + width;
+      if (middle >= runs) {
+        return;
+      }
+      size_t right_split = splits[middle];
+      splits[first] = std::rotate(deque.begin() + splits[first],
+                                  deque.begin() + offsets[middle],
+                                  deque.begin() + right_split) -
+                      deque.begin();
+    });
+  }
+  return deque.begin() + (runs == 0 ? 0 : splits[0]);
+}
+
+}  // namespace deque_par
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ranges>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "deque.hpp"
+
+// Distributes one input stream over many Deques. Pushing each element
+// straight into its target touches a different deque's end_, map and block
+// on every step, which stops scaling once the targets' tails no longer fit
+// in cache. Instead, elements are gathered in a cache-line-sized staging
+// buffer per target, and a full buffer goes into its deque with a single
+// append_range(). The hot working set is then the staging buffers plus a
+// fill count per target.
+namespace deque_scatter {
+
+inline constexpr size_t kCacheLine = 64;
+
+namespace detail {
+
+template <typename T>
+inline constexpr bool kStaged = std::is_trivially_copyable_v<T> &&
+                                std::is_default_constructible_v<T>;
+
+// At least one cache line. Elements too large for four to fit in one get
+// four slots anyway, so each flush still moves several of them.
+template <typename T>
+inline constexpr size_t kStageSize =
+    std::max<size_t>(4, kCacheLine / sizeof(T));
+
+template <typename T>
+struct alignas(kCacheLine) Stage {
+  T values[kStageSize<T>];
+};
+
+}  // namespace detail
+
+// Appends every element of input to *targets[key_fn(element)], keeping the
+// input order within each target. key_fn must return an index into targets.
+// Types that are not trivially copyable are pushed one by one.
+template <typename T, typename Allocator, std::ranges::input_range Range,
+          typename KeyFn>
+void scatter_into(std::span<Deque<T, Allocator>*> targets, Range&& input,
+                  KeyFn key_fn) {
+  if constexpr (!detail::kStaged<T>) {
+    for (auto&& value : input) {
+      size_t target = key_fn(std::as_const(value));
+      targets[target]->push_back(std::forward<decltype(value)>(value));
+    }
+  } else {
+    constexpr size_t kStageSize = detail::kStageSize<T>;
+    std::vector<detail::Stage<T>> stages(targets.size());
+    std::vector<uint32_t> fill(targets.size());
+    for (auto&& value : input) {
+      size_t target = key_fn(std::as_const(value));
+      stages[target].values[fill[target]] = value;
+      if (++fill[target] == kStageSize) {
+        targets[target]->append_range(
+            std::span<const T>(stages[target].values, kStageSize));
+        fill[target] = 0;
+      }
+    }
+    for (size_t target = 0; target < targets.size(); ++target) {
+      targets[target]->append_range(
+          std::span<const T>(stages[target].values, fill[target]));
+    }
+  }
+}
+
+// One radix partitioning pass: scatters input by log2(targets.size()) bits
+// of key_fn(element) starting at bit shift, so targets.size() must be a
+// power of two. Partitioning a target again on other bits splits it further.
+template <typename T, typename Allocator, std::ranges::input_range Range,
+          typename KeyFn>
+void radix_partition(std::span<Deque<T, Allocator>*> targets, Range&& input,
+                     KeyFn key_fn, unsigned shift) {
+  const size_t mask = targets.size() - 1;
+  scatter_into(targets, std::forward<Range>(input),
+               [&key_fn, shift, mask](const T& value) {
+                 return static_cast<size_t>(
+                     (static_cast<uint64_t>(key_fn(value)) >> shift) & mask);
+               });
+}
+
+}  // namespace deque_scatter
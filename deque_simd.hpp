@@ -0,0 +1,598 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include "deque.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DEQUE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace deque_simd {
+
+enum class Compare {
+  kEqual,
+  kNotEqual,
+  kLess,
+  kLessEqual,
+  kGreater,
+  kGreaterEqual
+};
+
+template <typename T>
+using SumType = std::conditional_t<
+    std::is_floating_point_v<T>, T,
+    std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>>;
+
+// std::allocator that asks Deque for buckets of about 512 bytes instead of
+// 8 elements, so that each segment spans many vector widths. The kernels
+// below accept any Deque; this only makes their inner loops longer.
+template <typename T>
+struct SimdAllocator : std::allocator<T> {
+  static constexpr size_t kBucketBytes = 512;
+
+  template <typename U>
+  struct rebind {
+    using other = SimdAllocator<U>;
+  };
+
+  SimdAllocator() = default;
+
+  template <typename U>
+  SimdAllocator(const SimdAllocator<U>& /*other*/) {}
+};
+
+namespace detail {
+
+enum class Isa { kScalar, kSse4, kAvx2 };
+
+inline Isa DetectIsa() {
+#ifdef DEQUE_SIMD_X86
+  static const Isa kIsa = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return Isa::kAvx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+      return Isa::kSse4;
+    }
+    return Isa::kScalar;
+  }();
+  return kIsa;
+#else
+  return Isa::kScalar;
+#endif
+}
+
+template <typename T, typename Pred>
+size_t CountWith(const T* data, size_t count, Pred pred) {
+  size_t result = 0;
+  for (size_t idx = 0; idx < count; ++idx) {
+    result += pred(data[idx]) ? 1 : 0;
+  }
+  return result;
+}
+
+// Plain loops over contiguous spans; the compiler is free to vectorize them.
+template <typename T>
+struct ScalarKernels {
+  static size_t find(const T* data, size_t count, T value) {
+    for (size_t idx = 0; idx < count; ++idx) {
+      if (data[idx] == value) {
+        return idx;
+      }
+    }
+    return count;
+  }
+
+  static size_t count(const T* data, size_t count, Compare cmp, T value) {
+    switch (cmp) {
+      case Compare::kEqual:
+        return CountWith(data, count, [value](T x) { return x == value; });
+      case Compare::kNotEqual:
+        return CountWith(data, count, [value](T x) { return x != value; });
+      case Compare::kLess:
+        return CountWith(data, count, [value](T x) { return x < value; });
+      case Compare::kLessEqual:
+        return CountWith(data, count, [value](T x) { return x <= value; });
+      case Compare::kGreater:
+        return CountWith(data, count, [value](T x) { return x > value; });
+      case Compare::kGreaterEqual:
+        return CountWith(data, count, [value](T x) { return x >= value; });
+    }
+    return 0;
+  }
+
+  static T min(const T* data, size_t count) {
+    T result = data[0];
+    for (size_t idx = 1; idx < count; ++idx) {
+      result = data[idx] < result ? data[idx] : result;
+    }
+    return result;
+  }
+
+  static T max(const T* data, size_t count) {
+    T result = data[0];
+    for (size_t idx = 1; idx < count; ++idx) {
+      result = result < data[idx] ? data[idx] : result;
+    }
+    return result;
+  }
+
+  static SumType<T> sum(const T* data, size_t count) {
+    SumType<T> result{};
+    for (size_t idx = 0; idx < count; ++idx) {
+      result += data[idx];
+    }
+    return result;
+  }
+};
+
+#ifdef DEQUE_SIMD_X86
+
+struct Avx2Int32 {
+  __attribute__((target("avx2"))) static size_t find(const int32_t* data,
+                                                     size_t count,
+                                                     int32_t value) {
+    __m256i needle = _mm256_set1_epi32(value);
+    size_t idx = 0;
+    for (; idx + 8 <= count; idx += 8) {
+      __m256i chunk = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(data + idx));
+      auto mask = static_cast<uint32_t>(_mm256_movemask_ps(
+          _mm256_castsi256_ps(_mm256_cmpeq_epi32(chunk, needle))));
+      if (mask != 0) {
+        return idx + std::countr_zero(mask);
+      }
+    }
+    return idx + ScalarKernels<int32_t>::find(data + idx, count - idx, value);
+  }
+
+  // kind: 0 counts x == value, 1 counts x > value, 2 counts x < value.
+  __attribute__((target("avx2"))) static size_t count_base(
+      const int32_t* data, size_t count, int kind, int32_t value) {
+    __m256i needle = _mm256_set1_epi32(value);
+    __m256i total = _mm256_setzero_si256();
+    size_t idx = 0;
+    for (; idx + 8 <= count; idx += 8) {
+      __m256i chunk = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(data + idx));
+      __m256i mask = kind == 0   ? _mm256_cmpeq_epi32(chunk, needle)
+                     : kind == 1 ? _mm256_cmpgt_epi32(chunk, needle)
+                                 : _mm256_cmpgt_epi32(needle, chunk);
+      total = _mm256_sub_epi32(total, mask);
+    }
+    alignas(32) uint32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), total);
+    size_t result = 0;
+    for (uint32_t lane : lanes) {
+      result += lane;
+    }
+    for (; idx < count; ++idx) {
+      result += kind == 0   ? data[idx] == value
+                : kind == 1 ? data[idx] > value
+                            : data[idx] < value;
+    }
+    return result;
+  }
+
+  static size_t count(const int32_t* data, size_t count, Compare cmp,
+                      int32_t value) {
+    switch (cmp) {
+      case Compare::kEqual:
+        return count_base(data, count, 0, value);
+      case Compare::kNotEqual:
+        return count - count_base(data, count, 0, value);
+      case Compare::kGreater:
+        return count_base(data, count, 1, value);
+      case Compare::kLessEqual:
+        return count - count_base(data, count, 1, value);
+      case Compare::kLess:
+        return count_base(data, count, 2, value);
+      case Compare::kGreaterEqual:
+        return count - count_base(data, count, 2, value);
+    }
+    return 0;
+  }
+
+  __attribute__((target("avx2"))) static int32_t min(const int32_t* data,
+                                                     size_t count) {
+    if (count < 8) {
+      return ScalarKernels<int32_t>::min(data, count);
+    }
+    __m256i best = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    size_t idx = 8;
+    for (; idx + 8 <= count; idx += 8) {
+      best = _mm256_min_epi32(
+          best,
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + idx)));
+    }
+    alignas(32) int32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), best);
+    int32_t result = ScalarKernels<int32_t>::min(lanes, 8);
+    for (; idx < count; ++idx) {
+      result = std::min(result, data[idx]);
+    }
+    return result;
+  }
+
+  __attribute__((target("avx2"))) static int32_t max(const int32_t* data,
+                                                     size_t count) {
+    if (count < 8) {
+      return ScalarKernels<int32_t>::max(data, count);
+    }
+    __m256i best = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    size_t idx = 8;
+    for (; idx + 8 <= count; idx += 8) {
+      best = _mm256_max_epi32(
+          best,
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + idx)));
+    }
+    alignas(32) int32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), best);
+    int32_t result = ScalarKernels<int32_t>::max(lanes, 8);
+    for (; idx < count; ++idx) {
+      result = std::max(result, data[idx]);
+    }
+    return result;
+  }
+
+  __attribute__((target("avx2"))) static int64_t sum(const int32_t* data,
+                                                     size_t count) {
+    __m256i total = _mm256_setzero_si256();
+    size_t idx = 0;
+    for (; idx + 8 <= count; idx += 8) {
+      __m256i chunk = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(data + idx));
+      total = _mm256_add_epi64(
+          total, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(chunk)));
+      total = _mm256_add_epi64(
+          total, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(chunk, 1)));
+    }
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           ScalarKernels<int32_t>::sum(data + idx, count - idx);
+  }
+};
+
+struct Sse4Int32 {
+  __attribute__((target("sse4.1"))) static size_t find(const int32_t* data,
+                                                       size_t count,
+                                                       int32_t value) {
+    __m128i needle = _mm_set1_epi32(value);
+    size_t idx = 0;
+    for (; idx + 4 <= count; idx += 4) {
+      __m128i chunk =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + idx));
+      auto mask = static_cast<uint32_t>(
+          _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(chunk, needle))));
+      if (mask != 0) {
+        return idx + std::countr_zero(mask);
+      }
+    }
+    return idx + ScalarKernels<int32_t>::find(data + idx, count - idx, value);
+  }
+
+  __attribute__((target("sse4.1"))) static size_t count_base(
+      const int32_t* data, size_t count, int kind, int32_t value) {
+    __m128i needle = _mm_set1_epi32(value);
+    __m128i total = _mm_setzero_si128();
+    size_t idx = 0;
+    for (; idx + 4 <= count; idx += 4) {
+      __m128i chunk =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + idx));
+      __m128i mask = kind == 0   ? _mm_cmpeq_epi32(chunk, needle)
+                     : kind == 1 ? _mm_cmpgt_epi32(chunk, needle)
+                                 : _mm_cmplt_epi32(chunk, needle);
+      total = _mm_sub_epi32(total, mask);
+    }
+    alignas(16) uint32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), total);
+    size_t result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; idx < count; ++idx) {
+      result += kind == 0   ? data[idx] == value
+                : kind == 1 ? data[idx] > value
+                            : data[idx] < value;
+    }
+    return result;
+  }
+
+  static size_t count(const int32_t* data, size_t count, Compare cmp,
+                      int32_t value) {
+    switch (cmp) {
+      case Compare::kEqual:
+        return count_base(data, count, 0, value);
+      case Compare::kNotEqual:
+        return count - count_base(data, count, 0, value);
+      case Compare::kGreater:
+        return count_base(data, count, 1, value);
+      case Compare::kLessEqual:
+        return count - count_base(data, count, 1, value);
+      case Compare::kLess:
+        return count_base(data, count, 2, value);
+      case Compare::kGreaterEqual:
+        return count - count_base(data, count, 2, value);
+    }
+    return 0;
+  }
+
+  __attribute__((target("sse4.1"))) static int32_t min(const int32_t* data,
+                                                       size_t count) {
+    if (count < 4) {
+      return ScalarKernels<int32_t>::min(data, count);
+    }
+    __m128i best = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    size_t idx = 4;
+    for (; idx + 4 <= count; idx += 4) {
+      best = _mm_min_epi32(
+          best, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + idx)));
+    }
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), best);
+    int32_t result = ScalarKernels<int32_t>::min(lanes, 4);
+    for (; idx < count; ++idx) {
+      result = std::min(result, data[idx]);
+    }
+    return result;
+  }
+
+  __attribute__((target("sse4.1"))) static int32_t max(const int32_t* data,
+                                                       size_t count) {
+    if (count < 4) {
+      return ScalarKernels<int32_t>::max(data, count);
+    }
+    __m128i best = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    size_t idx = 4;
+    for (; idx + 4 <= count; idx += 4) {
+      best = _mm_max_epi32(
+          best, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + idx)));
+    }
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), best);
+    int32_t result = ScalarKernels<int32_t>::max(lanes, 4);
+    for (; idx < count; ++idx) {
+      result = std::max(result, data[idx]);
+    }
+    return result;
+  }
+
+  __attribute__((target("sse4.1"))) static int64_t sum(const int32_t* data,
+                                                       size_t count) {
+    __m128i total = _mm_setzero_si128();
+    size_t idx = 0;
+    for (; idx + 4 <= count; idx += 4) {
+      __m128i chunk =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + idx));
+      total = _mm_add_epi64(total, _mm_cvtepi32_epi64(chunk));
+      total = _mm_add_epi64(total,
+                            _mm_cvtepi32_epi64(_mm_srli_si128(chunk, 8)));
+    }
+    alignas(16) int64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), total);
+    return lanes[0] + lanes[1] +
+           ScalarKernels<int32_t>::sum(data + idx, count - idx);
+  }
+};
+
+// NaNs are not supported by min/max; sum adds in lane order, so its rounding
+// may differ from a sequential loop.
+struct Avx2Double {
+  __attribute__((target("avx2"))) static size_t find(const double* data,
+                                                     size_t count,
+                                                     double value) {
+    __m256d needle = _mm256_set1_pd(value);
+    size_t idx = 0;
+    for (; idx + 4 <= count; idx += 4) {
+      auto mask = static_cast<uint32_t>(_mm256_movemask_pd(
+          _mm256_cmp_pd(_mm256_loadu_pd(data + idx), needle, _CMP_EQ_OQ)));
+      if (mask != 0) {
+        return idx + std::countr_zero(mask);
+      }
+    }
+    return idx + ScalarKernels<double>::find(data + idx, count - idx, value);
+  }
+
+  template <int kPredicate>
+  __attribute__((target("avx2"))) static size_t count_with(
+      const double* data, size_t count, double value) {
+    __m256d needle = _mm256_set1_pd(value);
+    size_t result = 0;
+    size_t idx = 0;
+    for (; idx + 4 <= count; idx += 4) {
+      result += std::popcount(static_cast<uint32_t>(_mm256_movemask_pd(
+          _mm256_cmp_pd(_mm256_loadu_pd(data + idx), needle, kPredicate))));
+    }
+    return result;
+  }
+
+  static size_t count(const double* data, size_t count, Compare cmp,
+                      double value) {
+    size_t head = count - (count % 4);
+    size_t tail =
+        ScalarKernels<double>::count(data + head, count - head, cmp, value);
+    switch (cmp) {
+      case Compare::kEqual:
+        return tail + count_with<_CMP_EQ_OQ>(data, count, value);
+      case Compare::kNotEqual:
+        return tail + count_with<_CMP_NEQ_UQ>(data, count, value);
+      case Compare::kLess:
+        return tail + count_with<_CMP_LT_OQ>(data, count, value);
+      case Compare::kLessEqual:
+        return tail + count_with<_CMP_LE_OQ>(data, count, value);
+      case Compare::kGreater:
+        return tail + count_with<_CMP_GT_OQ>(data, count, value);
+      case Compare::kGreaterEqual:
+        return tail + count_with<_CMP_GE_OQ>(data, count, value);
+    }
+    return 0;
+  }
+
+  __attribute__((target("avx2"))) static double min(const double* data,
+                                                    size_t count) {
+    if (count < 4) {
+      return ScalarKernels<double>::min(data, count);
+    }
+    __m256d best = _mm256_loadu_pd(data);
+    size_t idx = 4;
+    for (; idx + 4 <= count; idx += 4) {
+      best = _mm256_min_pd(best, _mm256_loadu_pd(data + idx));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, best);
+    double result = ScalarKernels<double>::min(lanes, 4);
+    for (; idx < count; ++idx) {
+      result = std::min(result, data[idx]);
+    }
+    return result;
+  }
+
+  __attribute__((target("avx2"))) static double max(const double* data,
+                                                    size_t count) {
+    if (count < 4) {
+      return ScalarKernels<double>::max(data, count);
+    }
+    __m256d best = _mm256_loadu_pd(data);
+    size_t idx = 4;
+    for (; idx + 4 <= count; idx += 4) {
+      best = _mm256_max_pd(best, _mm256_loadu_pd(data + idx));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, best);
+    double result = ScalarKernels<double>::max(lanes, 4);
+    for (; idx < count; ++idx) {
+      result = std::max(result, data[idx]);
+    }
+    return result;
+  }
+
+  __attribute__((target("avx2"))) static double sum(const double* data,
+                                                    size_t count) {
+    __m256d total = _mm256_setzero_pd();
+    size_t idx = 0;
+    for (; idx + 4 <= count; idx += 4) {
+      total = _mm256_add_pd(total, _mm256_loadu_pd(data + idx));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           ScalarKernels<double>::sum(data + idx, count - idx);
+  }
+};
+
+#endif  // DEQUE_SIMD_X86
+
+// Calls func with the best kernel set for T on this CPU.
+template <typename T, typename Func>
+decltype(auto) Dispatch(Func&& func) {
+#ifdef DEQUE_SIMD_X86
+  if constexpr (std::is_same_v<T, int32_t>) {
+    switch (DetectIsa()) {
+      case Isa::kAvx2:
+        return func(Avx2Int32{});
+      case Isa::kSse4:
+        return func(Sse4Int32{});
+      case Isa::kScalar:
+        break;
+    }
+  } else if constexpr (std::is_same_v<T, double>) {
+    if (DetectIsa() == Isa::kAvx2) {
+      return func(Avx2Double{});
+    }
+  }
+#endif
+  return func(ScalarKernels<T>{});
+}
+
+}  // namespace detail
+
+template <typename T, typename Allocator>
+typename Deque<T, Allocator>::const_iterator find(
+    const Deque<T, Allocator>& deque, T value) {
+  static_assert(std::is_arithmetic_v<T>);
+  return detail::Dispatch<T>([&](auto kernels) {
+    for (size_t seg = 0; seg < deque.segment_count(); ++seg) {
+      deque.prefetch_segment(seg + 1);
+      auto span = deque.segment(seg);
+      size_t idx = kernels.find(span.data(), span.size(), value);
+      if (idx != span.size()) {
+        return deque.cbegin() + (deque.segment_offset(seg) + idx);
+      }
+    }
+    return deque.cend();
+  });
+}
+
+template <typename T, typename Allocator>
+bool contains(const Deque<T, Allocator>& deque, T value) {
+  return find(deque, value) != deque.cend();
+}
+
+// Counts elements x for which `x cmp value` holds.
+template <typename T, typename Allocator>
+size_t count_if(const Deque<T, Allocator>& deque, Compare cmp, T value) {
+  static_assert(std::is_arithmetic_v<T>);
+  return detail::Dispatch<T>([&](auto kernels) {
+    size_t result = 0;
+    for (size_t seg = 0; seg < deque.segment_count(); ++seg) {
+      deque.prefetch_segment(seg + 1);
+      auto span = deque.segment(seg);
+      result += kernels.count(span.data(), span.size(), cmp, value);
+    }
+    return result;
+  });
+}
+
+template <typename T, typename Allocator>
+T min(const Deque<T, Allocator>& deque) {
+  static_assert(std::is_arithmetic_v<T>);
+  if (deque.empty()) {
+    throw std::out_of_range("min of empty deque");
+  }
+  return detail::Dispatch<T>([&](auto kernels) {
+    T result = deque[0];
+    for (size_t seg = 0; seg < deque.segment_count(); ++seg) {
+      deque.prefetch_segment(seg + 1);
+      auto span = deque.segment(seg);
+      result = std::min(result, kernels.min(span.data(), span.size()));
+    }
+    return result;
+  });
+}
+
+template <typename T, typename Allocator>
+T max(const Deque<T, Allocator>& deque) {
+  static_assert(std::is_arithmetic_v<T>);
+  if (deque.empty()) {
+    throw std::out_of_range("max of empty deque");
+  }
+  return detail::Dispatch<T>([&](auto kernels) {
+    T result = deque[0];
+    for (size_t seg = 0; seg < deque.segment_count(); ++seg) {
+      deque.prefetch_segment(seg + 1);
+      auto span = deque.segment(seg);
+      result = std::max(result, kernels.max(span.data(), span.size()));
+    }
+    return result;
+  });
+}
+
+template <typename T, typename Allocator>
+SumType<T> sum(const Deque<T, Allocator>& deque) {
+  static_assert(std::is_arithmetic_v<T>);
+  return detail::Dispatch<T>([&](auto kernels) {
+    SumType<T> result{};
+    for (size_t seg = 0; seg < deque.segment_count(); ++seg) {
+      deque.prefetch_segment(seg + 1);
+      auto span = deque.segment(seg);
+      result += kernels.sum(span.data(), span.size());
+    }
+    return result;
+  });
+}
+
+}  // namespace deque_simd
@@ -0,0 +1,1879 @@
+#include <algorithm>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "aligned_allocator.hpp"
+#include "async_deque.hpp"
+#include "bounded_deque.hpp"
+#include "compressed_deque.hpp"
+#include "cow_deque.hpp"
+#include "deque.hpp"
+#include "deque_par.hpp"
+#include "deque_scatter.hpp"
+#include "deque_simd.hpp"
+#include "lane_deque.hpp"
+#include "monoids.hpp"
+#include "packed_deque.hpp"
+#include "persistent_deque.hpp"
+#include "pool_allocator.hpp"
+#include "sequenced_deque.hpp"
+#include "soa_deque.hpp"
+#include "sorted_deque.hpp"
+#include "spilling_deque.hpp"
+#include "summary_deque.hpp"
+#include "swmr_deque.hpp"
+#include "tree_deque.hpp"
+#include "var_deque.hpp"
+#include "window_deque.hpp"
+
+// Drives each container and std::deque with the same random operations, then
+// checks the contract cases a random run rarely reaches: edge positions,
+// error paths, moved-from objects and arguments that alias the container.
+// Meant to run under the sanitizers; exits with 1 on failure.
+
+static size_t failures = 0;
+
+#define EXPECT(cond) Expect((cond), #cond, __FILE__, __LINE__)
+
+void Expect(bool ok, const char* what, const char* file, int line) {
+  if (!ok) {
+    ++failures;
+    std::cerr << file << ':' << line << ": expected " << what << '\n';
+  }
+}
+
+template <typename Func>
+void ExpectThrows(Func func, const char* what, int line) {
+  bool threw = false;
+  try {
+    func();
+  } catch (const std::exception&) {
+    threw = true;
+  }
+  Expect(threw, what, __FILE__, line);
+}
+
+// Long enough to live on the heap, so ASan sees use of dead elements.
+std::string Value(size_t idx) {
+  return std::string(24, 'v') + std::to_string(idx);
+}
+
+template <typename Seq, typename Ref>
+bool Same(const Seq& seq, const Ref& ref) {
+  return seq.size() == ref.size() &&
+         std::equal(ref.begin(), ref.end(), seq.begin());
+}
+
+// Counts copies and moves, for the complexity checks.
+struct Tracked {
+  static size_t copies;
+  static size_t moves;
+
+  Tracked(int64_t value) : value(value) {}
+  Tracked(const Tracked& other) : value(other.value) { ++copies; }
+  Tracked(Tracked&& other) noexcept : value(other.value) { ++moves; }
+  Tracked& operator=(const Tracked& other) {
+    value = other.value;
+    ++copies;
+    return *this;
+  }
+  Tracked& operator=(Tracked&& other) noexcept {
+    value = other.value;
+    ++moves;
+    return *this;
+  }
+
+  bool operator==(const Tracked& other) const = default;
+
+  int64_t value;
+};
+
+size_t Tracked::copies = 0;
+size_t Tracked::moves = 0;
+
+// Copying throws once `budget` copies have been made.
+struct Fragile {
+  static int budget;
+
+  Fragile(int value) : value(std::to_string(value)) {}
+  Fragile(const Fragile& other) : value(other.value) {
+    if (--budget < 0) {
+      throw std::runtime_error("copy");
+    }
+  }
+  Fragile(Fragile&&) = default;
+  Fragile& operator=(const Fragile&) = default;
+  Fragile& operator=(Fragile&&) = default;
+
+  std::string value;
+};
+
+int Fragile::budget = 0;
+
+// Counts the blocks held from every allocator it is rebound to.
+size_t live_allocations = 0;
+
+template <typename T>
+struct CountingAllocator {
+  using value_type = T;
+
+  CountingAllocator() = default;
+
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U>& /*other*/) {}
+
+  T* allocate(size_t count) {
+    ++live_allocations;
+    return std::allocator<T>().allocate(count);
+  }
+
+  void deallocate(T* ptr, size_t count) {
+    --live_allocations;
+    std::allocator<T>().deallocate(ptr, count);
+  }
+
+  template <typename U>
+  bool operator==(const CountingAllocator<U>& /*other*/) const {
+    return true;
+  }
+};
+
+// Deque
+
+void TestDeque() {
+  std::mt19937 rng(1);
+  Deque<std::string> deque;
+  std::deque<std::string> ref;
+  for (size_t step = 0; step < 20000; ++step) {
+    switch (rng() % 9) {
+      case 0:
+      case 1:
+        deque.push_back(Value(step));
+        ref.push_back(Value(step));
+        break;
+      case 2:
+      case 3:
+        deque.push_front(Value(step));
+        ref.push_front(Value(step));
+        break;
+      case 4:
+        deque.pop_back();
+        if (!ref.empty()) {
+          ref.pop_back();
+        }
+        break;
+      case 5:
+        deque.pop_front();
+        if (!ref.empty()) {
+          ref.pop_front();
+        }
+        break;
+      case 6: {
+        size_t pos = ref.empty() ? 0 : rng() % (ref.size() + 1);
+        deque.insert(deque.begin() + pos, Value(step));
+        ref.insert(ref.begin() + pos, Value(step));
+        break;
+      }
+      case 7:
+        if (!ref.empty()) {
+          size_t pos = rng() % ref.size();
+          deque.erase(deque.begin() + pos);
+          ref.erase(ref.begin() + pos);
+        }
+        break;
+      default:
+        if (!ref.empty()) {
+          size_t pos = rng() % ref.size();
+          deque[pos] = Value(step);
+          ref[pos] = Value(step);
+        }
+        break;
+    }
+  }
+  EXPECT(Same(deque, ref));
+  EXPECT(std::equal(ref.rbegin(), ref.rend(), deque.rbegin()));
+
+  size_t offset = 0;
+  for (auto segment : deque.segments()) {
+    EXPECT(std::equal(segment.begin(), segment.end(), ref.begin() + offset));
+    offset += segment.size();
+  }
+  EXPECT(offset == ref.size());
+
+  Deque<std::string> copy = deque;
+  copy[0] = Value(1000000);
+  EXPECT(Same(deque, ref) && copy[0] == Value(1000000));
+
+  Deque<std::string> moved(std::move(deque));
+  EXPECT(Same(moved, ref));
+  EXPECT(deque.empty());
+  deque.push_back(Value(1));
+  deque.push_front(Value(0));
+  EXPECT(deque.size() == 2 && *deque.begin() == Value(0));
+  deque = std::move(moved);
+  EXPECT(Same(deque, ref));
+  moved.push_back(Value(2));
+  EXPECT(moved.size() == 1);
+}
+
+void TestDequeContract() {
+  // Arguments that refer into the deque itself.
+  Deque<std::string> alias;
+  for (size_t idx = 0; idx < 3; ++idx) {
+    alias.push_back(Value(idx));
+  }
+  for (size_t idx = 0; idx < 200; ++idx) {
+    alias.push_back(*alias.begin());
+    alias.push_front(*(alias.end() - 1));
+  }
+  EXPECT(alias.size() == 403 && alias[0] == Value(0));
+  EXPECT(alias[201] == Value(1) && alias[402] == Value(0));
+  alias = alias;
+  EXPECT(alias.size() == 403 && alias[202] == Value(2));
+
+  // The edges of insert and erase, and the iterators they return.
+  Deque<int> edges;
+  for (int idx = 1; idx <= 3; ++idx) {
+    edges.push_back(idx);
+  }
+  EXPECT(edges.at(2) == 3);
+  ExpectThrows([&] { (void)edges.at(3); }, "at() past the end throws",
+               __LINE__);
+  EXPECT(*edges.insert(edges.begin(), 0) == 0);
+  EXPECT(*edges.insert(edges.end(), 4) == 4);
+  auto after = edges.erase(edges.end() - 1);
+  EXPECT(after == edges.end());
+  EXPECT(*edges.erase(edges.begin()) == 1);
+  EXPECT(Same(edges, std::vector<int>{1, 2, 3}));
+
+  Deque<std::string> empty;
+  empty.pop_back();
+  empty.pop_front();
+  empty.pop_front(3);
+  EXPECT(empty.empty() && empty.begin() == empty.end());
+  EXPECT(empty.segment_count() == 0);
+  ExpectThrows([&] { (void)empty.at(0); }, "at() on empty throws", __LINE__);
+  const Deque<std::string>& view = empty;
+  ExpectThrows([&] { (void)view.at(0); }, "const at() on empty throws",
+               __LINE__);
+  empty.push_back(Value(1));
+  EXPECT(empty.size() == 1 && empty[0] == Value(1));
+
+  // A copy that throws part way leaves the source intact and leaks nothing.
+  Deque<Fragile> fragile;
+  Fragile::budget = 100;
+  for (int idx = 0; idx < 40; ++idx) {
+    fragile.push_back(Fragile(idx));
+  }
+  Fragile::budget = 20;
+  ExpectThrows([&] { Deque<Fragile> copy = fragile; }, "throwing copy",
+               __LINE__);
+  EXPECT(fragile.size() == 40 && fragile[39].value == "39");
+}
+
+// append_deque, prepend_deque and split_at against the same edits on a
+// std::deque, interleaved with pushes so the block offsets vary.
+void TestDequeSplitAppend() {
+  std::mt19937 rng(19);
+  Deque<std::string> deque;
+  std::deque<std::string> ref;
+  for (size_t step = 0; step < 20000; ++step) {
+    switch (rng() % 4) {
+      case 0:
+        deque.push_back(Value(step));
+        ref.push_back(Value(step));
+        break;
+      case 1:
+        deque.push_front(Value(step));
+        ref.push_front(Value(step));
+        break;
+      case 2:
+        deque.pop_front();
+        if (!ref.empty()) {
+          ref.pop_front();
+        }
+        break;
+      default: {
+        size_t pos = ref.empty() ? 0 : rng() % (ref.size() + 1);
+        Deque<std::string> tail = deque.split_at(deque.begin() + pos);
+        EXPECT(deque.size() == pos && tail.size() == ref.size() - pos);
+        if (rng() % 2 == 0) {
+          deque.append_deque(std::move(tail));
+        } else {
+          tail.prepend_deque(std::move(deque));
+          deque = std::move(tail);
+        }
+        break;
+      }
+    }
+  }
+  EXPECT(Same(deque, ref));
+
+  // Splitting at either end, and joining empty deques.
+  Deque<std::string> all = deque.split_at(deque.begin());
+  EXPECT(deque.empty() && Same(all, ref));
+  Deque<std::string> none = all.split_at(all.end());
+  EXPECT(none.empty() && Same(all, ref));
+  all.append_deque(std::move(none));
+  all.prepend_deque(Deque<std::string>());
+  EXPECT(Same(all, ref));
+  deque.append_deque(std::move(all));
+  EXPECT(Same(deque, ref) && all.empty());
+  all.push_back(Value(1));
+  EXPECT(all.size() == 1);
+}
+
+void TestDequeResize() {
+  Deque<std::string> deque;
+  std::deque<std::string> ref;
+  std::mt19937 rng(20);
+  for (size_t step = 0; step < 2000; ++step) {
+    size_t count = rng() % 300;
+    if (rng() % 2 == 0) {
+      deque.resize(count, Value(step));
+      ref.resize(count, Value(step));
+    } else {
+      deque.resize(count);
+      ref.resize(count);
+    }
+    if (step % 7 == 0) {
+      deque.push_front(Value(step));
+      ref.push_front(Value(step));
+    }
+  }
+  EXPECT(Same(deque, ref));
+  deque.resize(5);
+  deque.resize(400, deque[1]);
+  EXPECT(deque.size() == 400 && deque[399] == deque[1]);
+
+  deque.assign(50, Value(7));
+  EXPECT(deque.size() == 50 && deque[49] == Value(7));
+  deque.assign({Value(1), Value(2)});
+  EXPECT(Same(deque, std::vector<std::string>{Value(1), Value(2)}));
+  deque.assign(3, deque[1]);
+  EXPECT(Same(deque, std::vector<std::string>(3, Value(2))));
+
+  // An input-only range, which can be walked once.
+  std::list<int> source = {1, 2, 3, 4, 5};
+  Deque<int> ranged(source.begin(), source.end());
+  EXPECT(Same(ranged, source));
+  ranged.resize_for_overwrite(1000);
+  EXPECT(ranged.size() == 1000 && ranged[4] == 5);
+  ranged.resize(0);
+  EXPECT(ranged.empty());
+}
+
+// Trivially relocatable elements are moved with memmove, others one by one;
+// both have to end up in the same order and with nothing leaked.
+struct Owned {
+  std::unique_ptr<int64_t> value;
+};
+
+template <>
+struct is_trivially_relocatable<Owned> : std::true_type {};
+
+void TestDequeRelocation() {
+  Deque<Owned> owned;
+  Deque<std::string> strings;
+  std::deque<int64_t> ref;
+  std::mt19937 rng(21);
+  for (size_t step = 0; step < 5000; ++step) {
+    auto value = static_cast<int64_t>(step);
+    size_t pos = ref.empty() ? 0 : rng() % (ref.size() + 1);
+    if (rng() % 3 != 0 || ref.empty()) {
+      owned.emplace(owned.begin() + pos,
+                    Owned{std::make_unique<int64_t>(value)});
+      strings.insert(strings.begin() + pos, Value(step));
+      ref.insert(ref.begin() + pos, value);
+    } else {
+      pos = rng() % ref.size();
+      owned.erase(owned.begin() + pos);
+      strings.erase(strings.begin() + pos);
+      ref.erase(ref.begin() + pos);
+    }
+  }
+  bool same = owned.size() == ref.size() && strings.size() == ref.size();
+  for (size_t idx = 0; same && idx < ref.size(); ++idx) {
+    same = *owned[idx].value == ref[idx] &&
+           strings[idx] == Value(static_cast<size_t>(ref[idx]));
+  }
+  EXPECT(same);
+
+  // An argument referring to an element that the insert shifts.
+  size_t middle = strings.size() / 2;
+  std::string expected = strings[middle + 3];
+  strings.insert(strings.begin() + middle, strings[middle + 3]);
+  strings.emplace(strings.begin() + middle, strings[middle]);
+  EXPECT(strings[middle] == expected && strings[middle + 1] == expected);
+}
+
+// clear() returns the blocks and the map; the deque is usable afterwards.
+void TestDequeClear() {
+  {
+    Deque<std::string, CountingAllocator<std::string>> deque;
+    for (size_t idx = 0; idx < 1000; ++idx) {
+      deque.push_back(Value(idx));
+      deque.push_front(Value(idx));
+    }
+    deque.clear();
+    EXPECT(deque.empty() && live_allocations == 0);
+    deque.clear();
+    deque.push_back(Value(1));
+    deque.push_front(Value(0));
+    EXPECT(deque.size() == 2 && deque[1] == Value(1));
+    deque.clear();
+    EXPECT(live_allocations == 0);
+    deque.push_front(Value(2));
+    auto copy = deque;
+    EXPECT(copy.size() == 1 && copy[0] == Value(2));
+  }
+  EXPECT(live_allocations == 0);
+}
+
+static_assert([] {
+  Deque<int> deque;
+  for (int idx = 0; idx < 100; ++idx) {
+    deque.push_back(idx);
+    deque.push_front(-idx);
+  }
+  deque.pop_front();
+  deque.insert(deque.begin() + 50, 7);
+  return deque.size() == 200 && *deque.begin() == -98 && deque[50] == 7;
+}());
+
+// deque_par
+
+void TestDequePar() {
+  Deque<int64_t> deque;
+  std::mt19937 rng(2);
+  for (size_t idx = 0; idx < 100000; ++idx) {
+    deque.push_back(static_cast<int64_t>(rng() % 100000));
+  }
+  std::vector<int64_t> ref(deque.begin(), deque.end());
+
+  deque_par::ThreadPool pool(3);
+  EXPECT(deque_par::reduce(deque, int64_t{0}, std::plus<>(), pool) ==
+         std::accumulate(ref.begin(), ref.end(), int64_t{0}));
+
+  Deque<int64_t> doubled(deque.size());
+  deque_par::transform(
+      deque, doubled, [](int64_t value) { return value * 2; }, pool);
+  EXPECT(doubled[12345] == ref[12345] * 2);
+
+  deque_par::for_each(deque, [](int64_t& value) { ++value; }, pool);
+  EXPECT(deque[777] == ref[777] + 1);
+
+  auto middle = deque_par::partition(
+      deque, [](int64_t value) { return value % 2 == 0; }, pool);
+  EXPECT(std::all_of(deque.begin(), middle,
+                     [](int64_t value) { return value % 2 == 0; }));
+  EXPECT(std::none_of(middle, deque.end(),
+                      [](int64_t value) { return value % 2 == 0; }));
+
+  deque_par::sort(deque, std::less<>(), pool);
+  std::sort(ref.begin(), ref.end());
+  for (auto& value : ref) {
+    ++value;
+  }
+  EXPECT(Same(deque, ref));
+
+  // An exception in one task reaches the caller once every task is done,
+  // and the pool keeps working.
+  ExpectThrows(
+      [&] {
+        deque_par::for_each(
+            deque,
+            [](int64_t& value) {
+              if (value == 1) {
+                throw std::runtime_error("task");
+              }
+            },
+            pool);
+      },
+      "a throwing task rethrows", __LINE__);
+  EXPECT(deque_par::reduce(deque, int64_t{0}, std::plus<>(), pool) ==
+         std::accumulate(ref.begin(), ref.end(), int64_t{0}));
+
+  deque_par::ThreadPool inline_pool(0);
+  EXPECT(inline_pool.size() == 1);
+  Deque<int64_t> single(1, 41);
+  deque_par::for_each(single, [](int64_t& value) { ++value; }, inline_pool);
+  EXPECT(deque_par::reduce(single, int64_t{0}, std::plus<>(), inline_pool) ==
+         42);
+
+  Deque<int64_t> empty;
+  deque_par::sort(empty, std::less<>(), pool);
+  EXPECT(deque_par::partition(empty, [](int64_t) { return true; }, pool) ==
+         empty.end());
+  EXPECT(deque_par::reduce(empty, int64_t{5}, std::plus<>(), pool) == 5);
+}
+
+// deque_simd
+
+// The bucket size reads sizeof(T) only for allocators that ask for it.
+struct TreeNode {
+  Deque<TreeNode> children;
+};
+
+void TestDequeSimd() {
+  Deque<int32_t> ints;
+  Deque<float> floats;
+  Deque<int32_t, deque_simd::SimdAllocator<int32_t>> wide;
+  std::mt19937 rng(3);
+  for (size_t idx = 0; idx < 5000; ++idx) {
+    ints.push_back(static_cast<int32_t>(rng() % 1000) - 500);
+    floats.push_front(static_cast<float>(rng() % 1000));
+    wide.push_front(ints[ints.size() - 1]);
+  }
+  EXPECT(ints.segment(1).size() == 8 && wide.segment(1).size() == 128);
+  EXPECT(deque_simd::min(ints) == *std::min_element(ints.begin(), ints.end()));
+  EXPECT(deque_simd::max(ints) == *std::max_element(ints.begin(), ints.end()));
+  EXPECT(deque_simd::sum(ints) ==
+         std::accumulate(ints.begin(), ints.end(), int64_t{0}));
+  EXPECT(deque_simd::sum(wide) == deque_simd::sum(ints));
+  EXPECT(deque_simd::count_if(ints, deque_simd::Compare::kLess, 0) ==
+         static_cast<size_t>(std::count_if(ints.begin(), ints.end(),
+                                           [](int32_t v) { return v < 0; })));
+  EXPECT(deque_simd::count_if(wide, deque_simd::Compare::kLess, 0) ==
+         deque_simd::count_if(ints, deque_simd::Compare::kLess, 0));
+  EXPECT(deque_simd::find(ints, ints[4321]) ==
+         std::find(ints.cbegin(), ints.cend(), ints[4321]));
+  EXPECT(deque_simd::find(wide, wide[4321]) ==
+         std::find(wide.cbegin(), wide.cend(), wide[4321]));
+  EXPECT(!deque_simd::contains(ints, 10000));
+  EXPECT(deque_simd::max(floats) ==
+         *std::max_element(floats.begin(), floats.end()));
+
+  Deque<int32_t> empty;
+  EXPECT(deque_simd::find(empty, 1) == empty.cend());
+  EXPECT(deque_simd::sum(empty) == 0);
+  EXPECT(deque_simd::count_if(empty, deque_simd::Compare::kEqual, 0) == 0);
+  ExpectThrows([&] { (void)deque_simd::min(empty); }, "min of empty throws",
+               __LINE__);
+  ExpectThrows([&] { (void)deque_simd::max(empty); }, "max of empty throws",
+               __LINE__);
+
+  TreeNode root;
+  root.children.push_back(TreeNode());
+  root.children[0].children.push_back(TreeNode());
+  EXPECT(root.children[0].children.size() == 1);
+}
+
+// Blocks from AlignedAllocator start on a cache line, and hold about
+// 512 bytes.
+void TestAlignedAllocator() {
+  Deque<int64_t, AlignedAllocator<int64_t>> aligned(1000, 7);
+  for (size_t seg = 0; seg < aligned.segment_count(); ++seg) {
+    auto address = reinterpret_cast<uintptr_t>(aligned.segment(seg).data());
+    EXPECT(seg == 0 || address % 64 == 0);
+  }
+  EXPECT(aligned.segment(1).size() == 64);
+  EXPECT(std::count(aligned.begin(), aligned.end(), 7) == 1000);
+
+  Deque<int64_t, AlignedAllocator<int64_t, 4096>> paged;
+  for (int64_t idx = 0; idx < 1000; ++idx) {
+    paged.push_front(idx);
+  }
+  auto address = reinterpret_cast<uintptr_t>(paged.segment(1).data());
+  EXPECT(address % 4096 == 0 && paged[999] == 0);
+}
+
+// deque_scatter
+
+void TestScatter() {
+  std::vector<uint64_t> input(50000);
+  std::mt19937_64 rng(4);
+  for (auto& value : input) {
+    value = rng();
+  }
+  std::vector<Deque<uint64_t>> targets(64);
+  std::vector<Deque<uint64_t>*> pointers;
+  for (auto& target : targets) {
+    pointers.push_back(&target);
+  }
+  deque_scatter::radix_partition(
+      std::span(pointers), input, [](uint64_t value) { return value; }, 6);
+  std::vector<std::deque<uint64_t>> ref(64);
+  for (uint64_t value : input) {
+    ref[(value >> 6) & 63].push_back(value);
+  }
+  for (size_t idx = 0; idx < 64; ++idx) {
+    EXPECT(Same(targets[idx], ref[idx]));
+  }
+
+  std::vector<Deque<std::string>> strings(3);
+  std::vector<Deque<std::string>*> string_pointers = {&strings[0], &strings[1],
+                                                      &strings[2]};
+  std::vector<std::string> words = {Value(0), Value(1), Value(2), Value(3)};
+  deque_scatter::scatter_into(
+      std::span(string_pointers), words,
+      [](const std::string& word) { return word.back() % 3; });
+  EXPECT(strings[0].size() == 2 && strings[0][1] == Value(3));
+  deque_scatter::scatter_into(std::span(string_pointers),
+                              std::vector<std::string>(),
+                              [](const std::string&) { return 0; });
+  EXPECT(strings[0].size() == 2);
+
+  Deque<int> ranged;
+  std::vector<int> source(10000);
+  std::iota(source.begin(), source.end(), 0);
+  ranged.push_front(-1);
+  ranged.append_range(source);
+  ranged.append_range(std::span<const int>(source).first(3));
+  ranged.append_range(std::vector<int>());
+  EXPECT(ranged.size() == 10004 && ranged[0] == -1 && ranged[10003] == 2);
+  EXPECT(std::equal(source.begin(), source.end(), ranged.begin() + 1));
+  Deque<std::string> texts;
+  texts.append_range(words);
+  EXPECT(Same(texts, words));
+}
+
+// SoaDeque
+
+void TestSoaDeque() {
+  SoaDeque<int, bool, std::string> soa;
+  std::deque<std::tuple<int, bool, std::string>> ref;
+  std::mt19937 rng(5);
+  for (size_t step = 0; step < 5000; ++step) {
+    auto row = std::make_tuple(static_cast<int>(step), step % 3 == 0,
+                               Value(step));
+    switch (rng() % 4) {
+      case 0:
+        soa.push_back(row);
+        ref.push_back(row);
+        break;
+      case 1:
+        soa.push_front(row);
+        ref.push_front(row);
+        break;
+      case 2:
+        soa.pop_back();
+        if (!ref.empty()) {
+          ref.pop_back();
+        }
+        break;
+      default:
+        soa.pop_front();
+        if (!ref.empty()) {
+          ref.pop_front();
+        }
+        break;
+    }
+  }
+  EXPECT(soa.size() == ref.size());
+  bool same = true;
+  for (size_t idx = 0; idx < ref.size(); ++idx) {
+    same = same && std::tuple(soa.get<0>(idx), soa.get<1>(idx),
+                              soa.get<2>(idx)) == ref[idx];
+  }
+  EXPECT(same);
+  EXPECT(std::equal(soa.begin(), soa.end(), ref.begin(), ref.end(),
+                    [](const auto& lhs, const auto& rhs) {
+                      return lhs == rhs;
+                    }));
+  size_t offset = 0;
+  for (auto segment : soa.segments<2>()) {
+    for (const auto& text : segment) {
+      same = same && text == std::get<2>(ref[offset++]);
+    }
+  }
+  EXPECT(same && offset == ref.size());
+
+  if (!ref.empty()) {
+    std::get<1>(soa[0]) = !std::get<1>(ref[0]);
+    EXPECT(soa.get<1>(0) != std::get<1>(ref[0]));
+    std::get<1>(soa[0]) = std::get<1>(ref[0]);
+  }
+  SoaDeque<int, bool, std::string> copy = soa;
+  SoaDeque<int, bool, std::string> moved = std::move(soa);
+  EXPECT(copy.size() == ref.size() && moved.size() == ref.size());
+  EXPECT(soa.empty() && soa.begin() == soa.end());
+  soa.push_front(ref.front());
+  soa.push_back(soa[0]);
+  EXPECT(soa.size() == 2 && soa.get<2>(1) == std::get<2>(ref.front()));
+  soa = copy;
+  EXPECT(soa.size() == ref.size() && soa.get<2>(0) == std::get<2>(ref[0]));
+  soa.clear();
+  soa.pop_back();
+  soa.pop_front();
+  EXPECT(soa.empty() && soa.segment_count() == 0);
+
+  // A field that throws while copying leaves neither the row nor a new
+  // block behind.
+  SoaDeque<int, Fragile> fragile;
+  std::tuple<int, Fragile> row(1, Fragile(1));
+  Fragile::budget = 1000;
+  for (size_t idx = 0; idx < 2 * fragile.kBlockSize; ++idx) {
+    fragile.push_back(row);
+  }
+  Fragile::budget = 0;
+  ExpectThrows([&] { fragile.push_back(row); }, "throwing field", __LINE__);
+  ExpectThrows([&] { fragile.push_front(row); }, "throwing field", __LINE__);
+  EXPECT(fragile.size() == 2 * fragile.kBlockSize &&
+         fragile.segment_count() == 2);
+  fragile.emplace_back(2, Fragile(2));
+  EXPECT(fragile.get<1>(fragile.size() - 1).value == "2");
+}
+
+// CompressedDeque
+
+void TestCompressedDeque() {
+  CompressedDeque<int64_t> compressed;
+  std::deque<int64_t> ref;
+  std::mt19937_64 rng(6);
+  for (size_t step = 0; step < 40000; ++step) {
+    auto value = static_cast<int64_t>(step * 3 + rng() % 50);
+    switch (rng() % 5) {
+      case 0:
+      case 1:
+        compressed.push_back(value);
+        ref.push_back(value);
+        break;
+      case 2:
+        compressed.push_front(-value);
+        ref.push_front(-value);
+        break;
+      case 3:
+        compressed.pop_back();
+        if (!ref.empty()) {
+          ref.pop_back();
+        }
+        break;
+      default:
+        compressed.pop_front();
+        if (!ref.empty()) {
+          ref.pop_front();
+        }
+        break;
+    }
+  }
+  EXPECT(Same(compressed, ref));
+  int64_t total = 0;
+  compressed.for_each([&total](int64_t value) { total += value; });
+  EXPECT(total == std::accumulate(ref.begin(), ref.end(), int64_t{0}));
+  compressed.clear();
+  compressed.pop_front();
+  compressed.pop_back();
+  EXPECT(compressed.empty());
+  ExpectThrows([&] { (void)compressed.at(0); }, "at() on empty throws",
+               __LINE__);
+
+  // Extreme values use the full width without overflowing the offsets.
+  CompressedDeque<int64_t> extremes;
+  for (size_t idx = 0; idx < 3 * extremes.kFrameSize; ++idx) {
+    extremes.push_back(idx % 2 == 0 ? INT64_MIN : INT64_MAX);
+  }
+  EXPECT(extremes[600] == INT64_MIN && extremes[601] == INT64_MAX);
+}
+
+// Small values of both signs in narrow types pack into a few bits each.
+template <typename Int>
+void TestCompressedNarrow() {
+  CompressedDeque<Int> compressed;
+  std::deque<Int> ref;
+  for (size_t idx = 0; idx < 40000; ++idx) {
+    auto value = static_cast<Int>(static_cast<int>(idx % 7) - 3);
+    compressed.push_back(value);
+    ref.push_back(value);
+  }
+  compressed.push_front(std::numeric_limits<Int>::min());
+  compressed.push_back(std::numeric_limits<Int>::max());
+  ref.push_front(std::numeric_limits<Int>::min());
+  ref.push_back(std::numeric_limits<Int>::max());
+  EXPECT(Same(compressed, ref));
+  EXPECT(compressed.memory_usage() < ref.size() * sizeof(Int) / 2);
+}
+
+// BoundedDeque
+
+void TestBoundedDeque() {
+  BoundedDeque<std::string, 64> ring;
+  std::deque<std::string> ref;
+  std::mt19937 rng(7);
+  for (size_t step = 0; step < 20000; ++step) {
+    switch (rng() % 4) {
+      case 0:
+        ring.push_back(Value(step));
+        ref.push_back(Value(step));
+        if (ref.size() > 64) {
+          ref.pop_front();
+        }
+        break;
+      case 1:
+        ring.push_front(Value(step));
+        ref.push_front(Value(step));
+        if (ref.size() > 64) {
+          ref.pop_back();
+        }
+        break;
+      case 2:
+        ring.pop_back();
+        if (!ref.empty()) {
+          ref.pop_back();
+        }
+        break;
+      default:
+        ring.pop_front();
+        if (!ref.empty()) {
+          ref.pop_front();
+        }
+        break;
+    }
+  }
+  EXPECT(Same(ring, ref));
+  EXPECT(std::equal(ref.rbegin(), ref.rend(), ring.rbegin()));
+
+  BoundedDeque<std::string, 4, RejectWhenFull> reject;
+  for (size_t idx = 0; idx < 4; ++idx) {
+    EXPECT(reject.push_back(Value(idx)));
+  }
+  EXPECT(reject.full());
+  EXPECT(!reject.push_back(Value(9)) && !reject.push_front(Value(9)));
+  EXPECT(reject.front() == Value(0) && reject.back() == Value(3));
+  ExpectThrows([&] { (void)reject.at(4); }, "at() past the end throws",
+               __LINE__);
+
+  // Pushing a copy of the element that the push evicts.
+  BoundedDeque<std::string, 4> full;
+  for (size_t idx = 0; idx < 4; ++idx) {
+    full.push_back(Value(idx));
+  }
+  full.push_back(full.front());
+  EXPECT(full.back() == Value(0) && full.front() == Value(1));
+  full.push_front(full.back());
+  EXPECT(full.front() == Value(0) && full.back() == Value(3));
+  BoundedDeque<int64_t, 4> ints;
+  for (int64_t idx = 0; idx < 4; ++idx) {
+    ints.push_back(idx);
+  }
+  ints.push_back(ints.front());
+  ints.push_front(ints.back());
+  EXPECT(ints.front() == 0 && ints[1] == 1 && ints.back() == 3);
+
+  // Elements are built in place while there is room; a full ring builds
+  // the element first, since that constructor may throw.
+  BoundedDeque<Tracked, 2> tracked;
+  Tracked::copies = 0;
+  Tracked::moves = 0;
+  tracked.emplace_back(int64_t{1});
+  tracked.emplace_front(int64_t{0});
+  EXPECT(Tracked::copies == 0 && Tracked::moves == 0);
+  tracked.emplace_back(int64_t{2});
+  EXPECT(Tracked::copies == 0 && Tracked::moves == 1);
+  EXPECT(tracked.front().value == 1 && tracked.back().value == 2);
+
+  BoundedDeque<std::string> dynamic(5);
+  EXPECT(dynamic.capacity() == 8);
+  dynamic.push_back(Value(1));
+  BoundedDeque<std::string> taken(std::move(dynamic));
+  EXPECT(dynamic.empty() && dynamic.capacity() == 8);
+  dynamic.pop_back();
+  dynamic.push_back(Value(2));
+  dynamic.push_front(Value(3));
+  EXPECT(dynamic.size() == 2 && dynamic.front() == Value(3));
+  dynamic = std::move(taken);
+  EXPECT(dynamic.size() == 1 && dynamic.front() == Value(1));
+  taken.push_back(Value(4));
+  EXPECT(taken.size() == 1);
+
+  BoundedDeque<Fragile, 8> target;
+  BoundedDeque<Fragile, 8> source;
+  for (int idx = 0; idx < 3; ++idx) {
+    target.push_back(Fragile(idx));
+    source.push_back(Fragile(idx + 10));
+  }
+  Fragile::budget = 1;
+  ExpectThrows([&] { target = source; }, "throwing copy assignment",
+               __LINE__);
+  EXPECT(target.size() == 3 && target.front().value == "0");
+  Fragile::budget = 100;
+  target = source;
+  EXPECT(target.size() == 3 && target.front().value == "10");
+  target = target;
+  EXPECT(target.size() == 3 && target.back().value == "12");
+}
+
+// TreeDeque
+
+void TestTreeDeque() {
+  TreeDeque<std::string> tree;
+  std::deque<std::string> ref;
+  std::mt19937 rng(8);
+  for (size_t step = 0; step < 30000; ++step) {
+    switch (rng() % 7) {
+      case 0:
+        tree.push_back(Value(step));
+        ref.push_back(Value(step));
+        break;
+      case 1:
+        tree.push_front(Value(step));
+        ref.push_front(Value(step));
+        break;
+      case 2:
+        tree.pop_back();
+        if (!ref.empty()) {
+          ref.pop_back();
+        }
+        break;
+      case 3:
+        tree.pop_front();
+        if (!ref.empty()) {
+          ref.pop_front();
+        }
+        break;
+      case 4:
+      case 5: {
+        size_t pos = ref.empty() ? 0 : rng() % (ref.size() + 1);
+        tree.insert(tree.begin() + pos, Value(step));
+        ref.insert(ref.begin() + pos, Value(step));
+        break;
+      }
+      default:
+        if (!ref.empty()) {
+          size_t pos = rng() % ref.size();
+          tree.erase(tree.begin() + pos);
+          ref.erase(ref.begin() + pos);
+        }
+        break;
+    }
+  }
+  EXPECT(Same(tree, ref));
+  EXPECT(std::equal(ref.rbegin(), ref.rend(), tree.rbegin()));
+
+  TreeDeque<std::string> copy = tree;
+  TreeDeque<std::string> moved = std::move(tree);
+  EXPECT(Same(copy, ref) && Same(moved, ref) && tree.empty());
+  tree.push_back(Value(1));
+  tree.insert(tree.begin(), tree[0]);
+  EXPECT(tree.size() == 2 && tree[0] == Value(1));
+  ExpectThrows([&] { (void)tree.at(2); }, "at() past the end throws",
+               __LINE__);
+  tree = moved;
+  EXPECT(Same(tree, ref));
+  tree.clear();
+  tree.pop_front();
+  tree.pop_back();
+  EXPECT(tree.empty() && tree.begin() == tree.end());
+  ExpectThrows([&] { (void)tree.at(0); }, "at() on empty throws", __LINE__);
+}
+
+// Arguments that refer to an element the insert moves: within a block, at
+// a full edge block, and across a split.
+void TestTreeDequeAliasing() {
+  TreeDeque<std::string> tree;
+  std::deque<std::string> ref;
+  for (size_t idx = 0; idx < 40; ++idx) {
+    tree.push_back(Value(idx));
+    ref.push_back(Value(idx));
+  }
+  tree.insert(tree.begin() + 25, tree[30]);
+  ref.insert(ref.begin() + 25, ref[30]);
+  tree.emplace(tree.begin() + 2, tree[3]);
+  ref.insert(ref.begin() + 2, ref[3]);
+  EXPECT(Same(tree, ref));
+
+  // Fill until the edge blocks are full and every push has to split one.
+  for (size_t idx = 0; idx < 3000; ++idx) {
+    tree.push_back(tree[tree.size() - 1]);
+    ref.push_back(ref.back());
+    tree.emplace_front(tree[0]);
+    ref.push_front(ref.front());
+    size_t pos = (idx * 7919) % ref.size();
+    tree.insert(tree.begin() + pos, tree[ref.size() - 1 - pos]);
+    ref.insert(ref.begin() + pos, ref[ref.size() - 1 - pos]);
+  }
+  EXPECT(Same(tree, ref));
+}
+
+// insert and erase in the middle move O(block) elements, independent of
+// the size, where Deque moves half the elements.
+void TestTreeDequeMiddleMoves() {
+  auto moves_per_edit = [](size_t size) {
+    TreeDeque<Tracked> tree;
+    for (size_t idx = 0; idx < size; ++idx) {
+      tree.push_back(Tracked(static_cast<int64_t>(idx)));
+    }
+    Tracked::moves = 0;
+    Tracked::copies = 0;
+    constexpr size_t kEdits = 1000;
+    std::mt19937 rng(9);
+    for (size_t idx = 0; idx < kEdits; ++idx) {
+      size_t pos = (size / 4) + (rng() % (size / 2));
+      tree.insert(tree.begin() + pos, Tracked(-1));
+      tree.erase(tree.begin() + pos + 1);
+    }
+    return (Tracked::moves + Tracked::copies) / kEdits;
+  };
+  size_t small = moves_per_edit(size_t{1} << 12);
+  size_t large = moves_per_edit(size_t{1} << 18);
+  EXPECT(large < 256);
+  EXPECT(large <= 2 * small + 64);
+}
+
+// CowDeque
+
+void TestCowDeque() {
+  CowDeque<std::string> cow;
+  std::deque<std::string> ref;
+  std::vector<std::pair<CowDeque<std::string>, std::deque<std::string>>>
+      snapshots;
+  std::mt19937 rng(10);
+  for (size_t step = 0; step < 20000; ++step) {
+    switch (rng() % 8) {
+      case 0:
+      case 1:
+        cow.push_back(Value(step));
+        ref.push_back(Value(step));
+        break;
+      case 2:
+        cow.push_front(Value(step));
+        ref.push_front(Value(step));
+        break;
+      case 3:
+        cow.pop_back();
+        if (!ref.empty()) {
+          ref.pop_back();
+        }
+        break;
+      case 4:
+        cow.pop_front();
+        if (!ref.empty()) {
+          ref.pop_front();
+        }
+        break;
+      case 5:
+        if (!ref.empty()) {
+          size_t pos = rng() % ref.size();
+          cow[pos] = Value(step);
+          ref[pos] = Value(step);
+        }
+        break;
+      case 6:
+        if (!ref.empty()) {
+          size_t pos = rng() % ref.size();
+          cow.erase(cow.begin() + pos);
+          ref.erase(ref.begin() + pos);
+        }
+        break;
+      default:
+        if (rng() % 50 == 0) {
+          snapshots.emplace_back(cow.snapshot(), ref);
+        }
+        break;
+    }
+  }
+  EXPECT(Same(cow, ref));
+  for (const auto& [snapshot, expected] : snapshots) {
+    EXPECT(Same(snapshot, expected));
+  }
+
+  // Writing to a snapshot leaves the deque it was taken from alone.
+  CowDeque<std::string> snapshot = cow.snapshot();
+  if (!ref.empty()) {
+    snapshot[0] = Value(1000000);
+    snapshot.insert(snapshot.begin(), snapshot[ref.size() - 1]);
+    EXPECT(Same(cow, ref) && snapshot[1] == Value(1000000));
+    EXPECT(snapshot[0] == ref.back());
+  }
+  ExpectThrows([&] { (void)cow.at(ref.size()); }, "at() past the end throws",
+               __LINE__);
+
+  CowDeque<std::string> moved = std::move(cow);
+  EXPECT(Same(moved, ref) && cow.empty());
+  cow.push_back(Value(1));
+  cow.push_back(cow[0]);
+  cow.push_front(cow[1]);
+  EXPECT(cow.size() == 3 && cow[0] == Value(1) && cow[2] == Value(1));
+  cow = moved;
+  EXPECT(Same(cow, ref));
+  cow.clear();
+  cow.pop_back();
+  cow.pop_front();
+  EXPECT(cow.empty() && Same(moved, ref));
+}
+
+// PersistentDeque
+
+void TestPersistentDeque() {
+  using Version = std::pair<PersistentDeque<std::string>,
+                            std::deque<std::string>>;
+  std::vector<Version> versions(1);
+  std::mt19937 rng(11);
+  for (size_t step = 0; step < 20000; ++step) {
+    const auto& [base, base_ref] = versions[rng() % versions.size()];
+    Version next{base, base_ref};
+    switch (rng() % 4) {
+      case 0:
+        next.first = base.push_back(Value(step));
+        next.second.push_back(Value(step));
+        break;
+      case 1:
+        next.first = base.push_front(Value(step));
+        next.second.push_front(Value(step));
+        break;
+      case 2:
+        next.first = base.pop_back();
+        if (!next.second.empty()) {
+          next.second.pop_back();
+        }
+        break;
+      default:
+        next.first = base.pop_front();
+        if (!next.second.empty()) {
+          next.second.pop_front();
+        }
+        break;
+    }
+    if (versions.size() < 32 && rng() % 4 == 0) {
+      versions.push_back(std::move(next));
+    } else {
+      versions[rng() % versions.size()] = std::move(next);
+    }
+  }
+  for (const auto& [version, ref] : versions) {
+    EXPECT(Same(version, ref));
+  }
+
+  Deque<std::string> source;
+  for (size_t idx = 0; idx < 3; ++idx) {
+    source.push_back(Value(idx));
+  }
+  auto loaded = PersistentDeque<std::string>::from(source);
+  EXPECT(Same(loaded, source));
+  // Two versions pushing onto the same base each keep their own element.
+  auto left = loaded.push_back(Value(3));
+  auto right = loaded.push_back(Value(4));
+  EXPECT(left.size() == 4 && left[3] == Value(3) && right[3] == Value(4));
+  auto grown = loaded.push_back(loaded[0]).push_front(loaded[2]);
+  EXPECT(grown.size() == 5 && grown[0] == Value(2) && grown[4] == Value(0));
+  ExpectThrows([&] { (void)loaded.at(3); }, "at() past the end throws",
+               __LINE__);
+  auto empty = PersistentDeque<std::string>().pop_back().pop_front();
+  EXPECT(empty.empty() && empty.begin() == empty.end());
+}
+
+// Alternating pops and pushes reuse the popped slot: no element is copied
+// beyond the pushed one.
+void TestPersistentDequeChurn() {
+  PersistentDeque<Tracked> deque;
+  for (int64_t idx = 0; idx < 100; ++idx) {
+    deque = deque.push_back(Tracked(idx)).push_front(Tracked(-idx));
+  }
+  constexpr size_t kRounds = 1000;
+  Tracked::copies = 0;
+  Tracked::moves = 0;
+  for (size_t idx = 0; idx < kRounds; ++idx) {
+    deque = deque.pop_back();
+    deque = deque.push_back(Tracked(1));
+    deque = deque.pop_front();
+    deque = deque.push_front(Tracked(2));
+  }
+  EXPECT(Tracked::copies == 0);
+  EXPECT(Tracked::moves == 2 * kRounds);
+
+  // A version kept alive still sees its elements.
+  auto kept = deque;
+  auto changed = deque.pop_back().push_back(Tracked(3));
+  EXPECT(kept[kept.size() - 1].value == 1);
+  EXPECT(changed[changed.size() - 1].value == 3);
+}
+
+// AsyncDeque
+
+using deque_async::AsyncDeque;
+using deque_async::LocalExecutor;
+using deque_async::Task;
+
+Task Produce(AsyncDeque<std::string>& queue, size_t count) {
+  for (size_t idx = 0; idx < count; ++idx) {
+    co_await queue.push_back(Value(idx));
+  }
+}
+
+Task Consume(AsyncDeque<std::string>& queue, size_t count,
+             std::vector<std::string>& out) {
+  for (size_t idx = 0; idx < count; ++idx) {
+    out.push_back(co_await queue.pop_front());
+  }
+}
+
+Task ConsumeBack(AsyncDeque<std::string>& queue, std::string& out) {
+  out = co_await queue.pop_back();
+}
+
+void TestAsyncDeque() {
+  LocalExecutor executor;
+  AsyncDeque<std::string> queue(executor, 4);
+  std::vector<std::string> out;
+  executor.spawn(Consume(queue, 1000, out));
+  executor.spawn(Produce(queue, 1000));
+  executor.run();
+  EXPECT(out.size() == 1000 && out[999] == Value(999));
+  EXPECT(queue.empty() && executor.pending() == 0);
+  EXPECT(!queue.try_pop_front() && !queue.try_pop_back());
+
+  // A producer past the capacity waits for a consumer.
+  executor.spawn(Produce(queue, 6));
+  executor.run();
+  EXPECT(queue.size() == 4 && executor.pending() == 1);
+  out.clear();
+  executor.spawn(Consume(queue, 6, out));
+  executor.run();
+  EXPECT(out.size() == 6 && out[5] == Value(5) && executor.pending() == 0);
+
+  // A consumer of an empty queue waits for a producer.
+  std::string back;
+  executor.spawn(ConsumeBack(queue, back));
+  executor.run();
+  EXPECT(back.empty() && executor.pending() == 1);
+  executor.spawn(Produce(queue, 1));
+  executor.run();
+  EXPECT(back == Value(0) && executor.pending() == 0);
+
+  std::vector<std::string> batch = {Value(0), Value(1), Value(2), Value(3),
+                                    Value(4)};
+  EXPECT(queue.append_range(batch) == 4);
+  EXPECT(queue.append_range(batch) == 0);
+  EXPECT(queue.try_pop_back() == Value(3));
+  EXPECT(queue.try_pop_front() == Value(0));
+}
+
+// LaneDeque
+
+void TestLaneDeque() {
+  constexpr size_t kLanes = 200;
+  LaneDeque<std::string, kLanes> lanes;
+  std::vector<std::deque<std::string>> ref(kLanes);
+  std::mt19937 rng(12);
+  for (size_t step = 0; step < 20000; ++step) {
+    size_t lane = rng() % kLanes;
+    switch (rng() % 5) {
+      case 0:
+      case 1:
+        lanes.push_back(lane, Value(step));
+        ref[lane].push_back(Value(step));
+        break;
+      case 2:
+        lanes.push_front(lane, Value(step));
+        ref[lane].push_front(Value(step));
+        break;
+      case 3: {
+        auto popped = lanes.pop_highest();
+        auto highest = std::find_if(ref.rbegin(), ref.rend(),
+                                    [](const auto& q) { return !q.empty(); });
+        EXPECT(popped.has_value() == (highest != ref.rend()));
+        if (highest != ref.rend()) {
+          EXPECT(popped == highest->front());
+          highest->pop_front();
+        }
+        break;
+      }
+      default: {
+        size_t to = rng() % kLanes;
+        size_t count = rng() % 40;
+        size_t moved = lanes.move_batch(lane, to, count);
+        size_t expected = lane == to ? 0 : std::min(count, ref[lane].size());
+        EXPECT(moved == expected);
+        for (size_t idx = 0; idx < expected; ++idx) {
+          ref[to].push_back(std::move(ref[lane].front()));
+          ref[lane].pop_front();
+        }
+        break;
+      }
+    }
+  }
+  size_t total = 0;
+  for (size_t lane = 0; lane < kLanes; ++lane) {
+    EXPECT(Same(lanes.lane(lane), ref[lane]));
+    total += ref[lane].size();
+  }
+  EXPECT(lanes.size() == total);
+
+  // Two deques on one pool hand blocks back and forth.
+  LaneDeque<std::string, 4> first;
+  LaneDeque<std::string, 4> second(first.pool());
+  for (size_t idx = 0; idx < 1000; ++idx) {
+    first.push_back(idx % 4, Value(idx));
+  }
+  first.clear();
+  for (size_t idx = 0; idx < 1000; ++idx) {
+    second.push_front(3, Value(idx));
+  }
+  EXPECT(second.highest() == 3 && second.lane(3)[0] == Value(999));
+  EXPECT(first.empty() && !first.highest());
+
+  lanes.clear();
+  lanes.pop_front(3);
+  lanes.pop_back(3);
+  EXPECT(lanes.empty() && !lanes.highest() && !lanes.pop_highest());
+  EXPECT(lanes.move_batch(3, 4) == 0);
+}
+
+// SortedDeque
+
+void TestSortedDeque() {
+  SortedDeque<int64_t> sorted;
+  std::mt19937 rng(13);
+  for (size_t step = 0; step < 20000; ++step) {
+    sorted.push_back(static_cast<int64_t>(rng() % 100000));
+  }
+  sorted.sort();
+  EXPECT(sorted.is_sorted());
+  EXPECT(std::is_sorted(sorted.begin(), sorted.end()));
+  for (int64_t key : {int64_t{-1}, int64_t{500}, int64_t{99999},
+                      int64_t{100000}}) {
+    EXPECT(sorted.lower_bound(key) ==
+           std::lower_bound(sorted.begin(), sorted.end(), key));
+    EXPECT(sorted.upper_bound(key) ==
+           std::upper_bound(sorted.begin(), sorted.end(), key));
+  }
+
+  SortedDeque<int64_t> other;
+  std::vector<int64_t> all(sorted.begin(), sorted.end());
+  for (size_t step = 0; step < 5000; ++step) {
+    auto value = static_cast<int64_t>(rng() % 200000);
+    other.push_back(value);
+    all.push_back(value);
+  }
+  sorted.merge_sorted(std::move(other));
+  std::sort(all.begin(), all.end());
+  EXPECT(Same(sorted, all));
+  EXPECT(other.empty());
+
+  // Only the sorted suffix is searched until sort().
+  SortedDeque<int64_t> partial;
+  for (int64_t value : {9, 8, 1, 2, 3}) {
+    partial.push_back(value);
+  }
+  EXPECT(partial.sorted_suffix() == 3 && !partial.is_sorted());
+  EXPECT(partial.lower_bound(2) - partial.begin() == 3);
+  partial.push_front(0);
+  EXPECT(partial.sorted_suffix() == 3);
+  partial.pop_back();
+  partial.pop_back();
+  partial.pop_back();
+  EXPECT(partial.sorted_suffix() == 1 && partial[2] == 8);
+
+  // Merging an empty run still sorts.
+  SortedDeque<int64_t> unsorted;
+  for (int64_t value : {5, 1, 4, 2}) {
+    unsorted.push_back(value);
+  }
+  unsorted.merge_sorted(SortedDeque<int64_t>());
+  EXPECT(unsorted.is_sorted() && unsorted[0] == 1 && unsorted[3] == 5);
+  unsorted.merge_sorted(std::move(unsorted));
+  EXPECT(unsorted.size() == 4);
+
+  SortedDeque<int64_t> empty;
+  empty.pop_back();
+  empty.pop_front();
+  EXPECT(empty.empty() && empty.lower_bound(0) == empty.end());
+  EXPECT(empty.range(0, 10).empty());
+}
+
+// SummaryDeque
+
+void TestSummaryDeque() {
+  SummaryDeque<int64_t, monoids::Sum<int64_t>> summary;
+  std::deque<int64_t> ref;
+  std::mt19937 rng(14);
+  for (size_t step = 0; step < 20000; ++step) {
+    auto value = static_cast<int64_t>(rng() % 1000);
+    switch (rng() % 7) {
+      case 0:
+      case 1:
+        summary.push_back(value);
+        ref.push_back(value);
+        break;
+      case 2:
+        summary.push_front(value);
+        ref.push_front(value);
+        break;
+      case 3:
+        summary.pop_back();
+        if (!ref.empty()) {
+          ref.pop_back();
+        }
+        break;
+      case 4:
+        summary.pop_front();
+        if (!ref.empty()) {
+          ref.pop_front();
+        }
+        break;
+      case 5:
+        if (!ref.empty()) {
+          size_t pos = rng() % ref.size();
+          summary.assign(pos, value);
+          ref[pos] = value;
+        }
+        break;
+      default:
+        if (!ref.empty()) {
+          size_t pos = rng() % ref.size();
+          summary.erase(summary.begin() + pos);
+          ref.erase(ref.begin() + pos);
+        }
+        break;
+    }
+    if (step % 100 == 0 && !ref.empty()) {
+      size_t first = rng() % ref.size();
+      size_t last = first + (rng() % (ref.size() - first + 1));
+      EXPECT(summary.reduce(first, last) ==
+             std::accumulate(ref.begin() + first, ref.begin() + last,
+                             int64_t{0}));
+    }
+  }
+  EXPECT(Same(summary, ref));
+  size_t matches = summary.query(
+      0, summary.size(), [](int64_t) { return true; },
+      [](int64_t value) { return value < 10; }, [](int64_t) {});
+  EXPECT(matches == static_cast<size_t>(std::count_if(
+                        ref.begin(), ref.end(),
+                        [](int64_t value) { return value < 10; })));
+  EXPECT(summary.reduce(0, 0) == 0);
+
+  // A block predicate that rejects everything visits nothing.
+  size_t visited = 0;
+  EXPECT(summary.query(
+             0, summary.size(), [](int64_t) { return false; },
+             [](int64_t) { return true; }, [&](int64_t) { ++visited; }) ==
+         0);
+  EXPECT(visited == 0);
+
+  summary.clear();
+  summary.pop_back();
+  summary.pop_front();
+  EXPECT(summary.empty() && summary.block_count() == 0);
+}
+
+// WindowDeque
+
+void TestWindowDeque() {
+  WindowDeque<int64_t, monoids::Sum<int64_t>> sum;
+  WindowDeque<int64_t, monoids::Max<int64_t>> max;
+  std::deque<int64_t> ref;
+  std::mt19937 rng(15);
+  bool same = true;
+  for (size_t step = 0; step < 20000; ++step) {
+    auto value = static_cast<int64_t>(rng() % 1000);
+    size_t window = 1 + (rng() % 100);
+    sum.slide(value, window);
+    max.slide(value, window);
+    ref.push_back(value);
+    while (ref.size() > window) {
+      ref.pop_front();
+    }
+    same = same &&
+           sum.aggregate() ==
+               std::accumulate(ref.begin(), ref.end(), int64_t{0}) &&
+           max.aggregate() == *std::max_element(ref.begin(), ref.end());
+  }
+  EXPECT(same);
+  EXPECT(Same(sum, ref) && Same(max, ref));
+
+  // Popping down to one element and refilling.
+  while (max.size() > 1) {
+    max.pop_front();
+  }
+  EXPECT(max.aggregate() == ref.back());
+  max.push_back(-1);
+  EXPECT(max.aggregate() == ref.back() && max.size() == 2);
+
+  sum.clear();
+  sum.pop_front();
+  EXPECT(sum.empty() && sum.aggregate() == 0);
+}
+
+// SequencedDeque
+
+void TestSequencedDeque() {
+  SequencedDeque<std::string> sequenced(100);
+  for (size_t idx = 0; idx < 1000; ++idx) {
+    EXPECT(sequenced.push_back(Value(idx)) == 100 + idx);
+  }
+  sequenced.erase_until_seq(600);
+  sequenced.pop_front();
+  EXPECT(sequenced.front_seq() == 601 && sequenced.size() == 499);
+  EXPECT(sequenced.at_seq(700) == Value(600));
+  EXPECT(*sequenced.find_seq(1099) == Value(999));
+  EXPECT(!sequenced.contains_seq(600) && sequenced.find_seq(50) ==
+                                             sequenced.end());
+  ExpectThrows([&] { (void)sequenced.at_seq(2000); }, "at_seq past the end",
+               __LINE__);
+  ExpectThrows([&] { (void)sequenced.at_seq(99); }, "at_seq before the front",
+               __LINE__);
+  sequenced.erase_until_seq(50);
+  EXPECT(sequenced.front_seq() == 601);
+  sequenced.erase_until_seq(5000);
+  EXPECT(sequenced.empty() && sequenced.front_seq() == 1100);
+  sequenced.pop_front();
+  EXPECT(sequenced.empty() && sequenced.next_seq() == 1100);
+  EXPECT(sequenced.push_back(Value(0)) == 1100);
+
+  Deque<int> deque = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  deque.pop_front(0);
+  deque.pop_front(9);
+  EXPECT(deque.size() == 1 && deque[0] == 10);
+  deque.pop_front(5);
+  EXPECT(deque.empty());
+}
+
+// SpillingDeque
+
+void TestSpillingDeque() {
+  using Spilling = SpillingDeque<int64_t>;
+  Spilling spilling(2 * Spilling::kChunkBytes);
+  std::deque<int64_t> ref;
+  std::mt19937 rng(16);
+  size_t spilled = 0;
+  for (size_t round = 0; round < 6; ++round) {
+    size_t pushes = (rng() % 4 + 4) * Spilling::kChunkSize;
+    for (size_t idx = 0; idx < pushes; ++idx) {
+      auto value = static_cast<int64_t>(rng());
+      if (idx % 5 == 0) {
+        spilling.push_front(value);
+        ref.push_front(value);
+      } else {
+        spilling.push_back(value);
+        ref.push_back(value);
+      }
+    }
+    spilled = std::max(spilled, spilling.spilled_bytes());
+    size_t pops = rng() % (ref.size() + 1);
+    bool same = true;
+    for (size_t idx = 0; idx < pops; ++idx) {
+      if (idx % 7 == 0) {
+        same = same && spilling.back() == ref.back();
+        spilling.pop_back();
+        ref.pop_back();
+      } else {
+        same = same && spilling.front() == ref.front();
+        spilling.pop_front();
+        ref.pop_front();
+      }
+    }
+    EXPECT(same && spilling.size() == ref.size());
+  }
+  EXPECT(spilled > 0);
+  while (!ref.empty()) {
+    EXPECT(spilling.front() == ref.front());
+    spilling.pop_front();
+    ref.pop_front();
+  }
+  spilling.pop_front();
+  spilling.pop_back();
+  EXPECT(spilling.empty() && spilling.spilled_bytes() == 0);
+  spilling.push_back(7);
+  EXPECT(spilling.front() == 7 && spilling.back() == 7);
+}
+
+// VarDeque
+
+template <RecordLayout Layout>
+std::vector<std::byte> Bytes(const typename VarDeque<Layout>::value_type& rec) {
+  std::vector<std::byte> bytes(rec.size());
+  if constexpr (Layout == RecordLayout::kPad) {
+    std::copy(rec.begin(), rec.end(), bytes.begin());
+  } else {
+    rec.copy_to(bytes.data());
+  }
+  return bytes;
+}
+
+template <RecordLayout Layout>
+void TestVarDeque() {
+  VarDeque<Layout> records(256);
+  std::deque<std::vector<std::byte>> ref;
+  std::mt19937 rng(17);
+  for (size_t step = 0; step < 20000; ++step) {
+    std::vector<std::byte> record(rng() % (records.max_record_size() + 1));
+    for (auto& byte : record) {
+      byte = static_cast<std::byte>(rng());
+    }
+    switch (rng() % 4) {
+      case 0:
+        records.push_back(record);
+        ref.push_back(record);
+        break;
+      case 1:
+        records.push_front(record);
+        ref.push_front(record);
+        break;
+      case 2:
+        records.pop_back();
+        if (!ref.empty()) {
+          ref.pop_back();
+        }
+        break;
+      default:
+        records.pop_front();
+        if (!ref.empty()) {
+          ref.pop_front();
+        }
+        break;
+    }
+    if (!ref.empty()) {
+      EXPECT(Bytes<Layout>(records.front()) == ref.front());
+      EXPECT(Bytes<Layout>(records.back()) == ref.back());
+    }
+  }
+  EXPECT(records.size() == ref.size());
+  size_t idx = 0;
+  for (const auto& record : records) {
+    EXPECT(Bytes<Layout>(record) == ref[idx++]);
+  }
+
+  std::vector<std::byte> oversized(records.max_record_size() + 1);
+  ExpectThrows([&] { records.push_back(oversized); }, "oversized record",
+               __LINE__);
+  EXPECT(records.size() == ref.size());
+  std::vector<std::byte> largest(records.max_record_size(), std::byte{1});
+  records.push_front(largest);
+  records.pop_front();
+
+  VarDeque<Layout> copy = records;
+  VarDeque<Layout> moved = std::move(records);
+  EXPECT(copy.size() == ref.size() && moved.size() == ref.size());
+  EXPECT(records.empty());
+  std::vector<std::byte> small(10, std::byte{7});
+  records.push_back(small);
+  records.push_front(small);
+  EXPECT(records.size() == 2);
+  records = std::move(moved);
+  EXPECT(records.size() == ref.size());
+  records.swap(copy);
+  EXPECT(records.size() == ref.size() && copy.size() == ref.size());
+
+  VarDeque<Layout> empty(64);
+  empty.pop_back();
+  empty.pop_front();
+  EXPECT(empty.empty() && empty.begin() == empty.end());
+  empty.push_back(small);
+  EXPECT(empty.size() == 1 && Bytes<Layout>(empty.front()) == small);
+  empty.push_back(std::vector<std::byte>());
+  EXPECT(empty.size() == 2 && Bytes<Layout>(empty.back()).empty());
+}
+
+// SwmrDeque
+
+void TestSwmrDeque() {
+  SwmrDeque<std::string> swmr;
+  swmr.pop_front();
+  EXPECT(swmr.empty());
+  std::thread reader([&swmr] {
+    SwmrDeque<std::string>::Reader handle(swmr);
+    for (size_t round = 0; round < 2000; ++round) {
+      auto snapshot = handle.snapshot();
+      uint64_t first = snapshot.first_index();
+      for (size_t idx = 0; idx < snapshot.size(); idx += 97) {
+        EXPECT(snapshot[idx] == Value(first + idx));
+      }
+    }
+  });
+  for (size_t idx = 0; idx < 50000; ++idx) {
+    swmr.push_back(Value(idx));
+    if (swmr.size() > 3000) {
+      swmr.pop_front(idx % 3);
+    }
+  }
+  reader.join();
+  EXPECT(swmr.back() == Value(49999));
+  EXPECT(swmr.front() == Value(swmr.first_index()));
+  swmr.push_back(swmr.back());
+  EXPECT(swmr.back() == Value(49999) && swmr.next_index() == 50001);
+
+  std::vector<std::unique_ptr<SwmrDeque<std::string>::Reader>> readers;
+  for (size_t idx = 0; idx < SwmrDeque<std::string>::kMaxReaders; ++idx) {
+    readers.push_back(
+        std::make_unique<SwmrDeque<std::string>::Reader>(swmr));
+  }
+  ExpectThrows([&] { SwmrDeque<std::string>::Reader extra(swmr); },
+               "a reader past kMaxReaders throws", __LINE__);
+  readers.pop_back();
+  SwmrDeque<std::string>::Reader freed(swmr);
+  EXPECT(freed.snapshot().size() == swmr.size());
+
+  swmr.pop_front(swmr.size() + 10);
+  EXPECT(swmr.empty() && swmr.first_index() == 50001);
+}
+
+// PackedDeque
+
+template <unsigned Bits>
+void TestPackedDeque() {
+  using Packed = PackedDeque<Bits>;
+  using V = typename Packed::value_type;
+  constexpr uint64_t kMask =
+      Bits == 64 ? ~uint64_t{0} : (uint64_t{1} << Bits) - 1;
+  std::mt19937_64 rng(18 + Bits);
+  auto random_value = [&] { return static_cast<V>(rng() & kMask); };
+  Packed packed;
+  std::deque<V> ref;
+  for (size_t step = 0; step < 20000; ++step) {
+    V value = random_value();
+    switch (rng() % 6) {
+      case 0:
+      case 1:
+        packed.push_back(value);
+        ref.push_back(value);
+        break;
+      case 2:
+        packed.push_front(value);
+        ref.push_front(value);
+        break;
+      case 3:
+        packed.pop_back();
+        if (!ref.empty()) {
+          ref.pop_back();
+        }
+        break;
+      case 4:
+        packed.pop_front();
+        if (!ref.empty()) {
+          ref.pop_front();
+        }
+        break;
+      default:
+        if (!ref.empty()) {
+          size_t pos = rng() % ref.size();
+          packed[pos] = value;
+          ref[pos] = value;
+        }
+        break;
+    }
+  }
+  EXPECT(Same(packed, ref));
+  const Packed& view = packed;
+  for (V value : {V(0), V(1), random_value()}) {
+    EXPECT(view.count(value) ==
+           static_cast<size_t>(std::count(ref.begin(), ref.end(), value)));
+    EXPECT(view.find_first(value) - view.begin() ==
+           std::find(ref.begin(), ref.end(), value) - ref.begin());
+  }
+  ExpectThrows([&] { (void)view.at(ref.size()); }, "at() past the end throws",
+               __LINE__);
+
+  // The other operand starts at a different slot within its first word.
+  Packed other;
+  std::deque<V> other_ref;
+  for (size_t idx = 0; idx < ref.size() + 5; ++idx) {
+    V value = random_value();
+    other.push_back(value);
+    other_ref.push_back(value);
+  }
+  for (size_t idx = 0; idx < 5; ++idx) {
+    other.pop_front();
+    other_ref.pop_front();
+  }
+  Packed anded = packed;
+  anded &= other;
+  Packed xored = packed;
+  xored ^= other;
+  bool same = true;
+  for (size_t idx = 0; idx < ref.size(); ++idx) {
+    same = same && anded[idx] == V(ref[idx] & other_ref[idx]) &&
+           xored[idx] == V(ref[idx] ^ other_ref[idx]);
+  }
+  EXPECT(same);
+  ExpectThrows([&] { anded |= Packed(3); }, "size mismatch", __LINE__);
+  xored ^= xored;
+  EXPECT(xored.count(V(0)) == ref.size());
+
+  // Assigning through a reference to another element of the same deque.
+  if (ref.size() > 2) {
+    packed[0] = packed[ref.size() - 1];
+    EXPECT(packed[0] == ref.back());
+    packed[0] = ref[0];
+  }
+
+  Packed moved = std::move(packed);
+  EXPECT(Same(moved, ref));
+  packed.clear();
+  packed.pop_back();
+  packed.pop_front();
+  EXPECT(packed.empty() && packed.word_count() == 0);
+  packed.push_back(V(1));
+  EXPECT(packed.size() == 1 && packed[0] == V(1));
+}
+
+static_assert([] {
+  PackedDeque<4> packed = {1, 2, 3};
+  packed.push_front(15);
+  packed.pop_back();
+  return packed.size() == 3 && packed[0] == 15 && packed[2] == 2;
+}());
+
+// Deque<bool> stays an ordinary Deque of bytes; PackedDeque<1> is opt-in.
+void TestDequeOfBool() {
+  Deque<bool> flags = {true, false, true};
+  flags.insert(flags.begin() + 1, true);
+  bool& first = flags[0];
+  first = false;
+  EXPECT(flags.size() == 4 && !flags[0] && flags[1]);
+  EXPECT(flags.segment_count() == 1);
+  EXPECT(deque_simd::count_if(flags, deque_simd::Compare::kEqual, true) == 2);
+}
+
+int main() {
+  std::vector<std::pair<const char*, void (*)()>> tests = {
+      {"Deque", TestDeque},
+      {"Deque contract", TestDequeContract},
+      {"Deque clear", TestDequeClear},
+      {"Deque split/append", TestDequeSplitAppend},
+      {"Deque resize/assign", TestDequeResize},
+      {"Deque relocation", TestDequeRelocation},
+      {"Deque<bool>", TestDequeOfBool},
+      {"deque_par", TestDequePar},
+      {"deque_simd", TestDequeSimd},
+      {"AlignedAllocator", TestAlignedAllocator},
+      {"deque_scatter", TestScatter},
+      {"SoaDeque", TestSoaDeque},
+      {"CompressedDeque", TestCompressedDeque},
+      {"CompressedDeque<int8_t>", TestCompressedNarrow<int8_t>},
+      {"CompressedDeque<int16_t>", TestCompressedNarrow<int16_t>},
+      {"BoundedDeque", TestBoundedDeque},
+      {"TreeDeque", TestTreeDeque},
+      {"TreeDeque aliasing", TestTreeDequeAliasing},
+      {"TreeDeque middle moves", TestTreeDequeMiddleMoves},
+      {"CowDeque", TestCowDeque},
+      {"PersistentDeque", TestPersistentDeque},
+      {"PersistentDeque churn", TestPersistentDequeChurn},
+      {"AsyncDeque", TestAsyncDeque},
+      {"LaneDeque", TestLaneDeque},
+      {"SortedDeque", TestSortedDeque},
+      {"SummaryDeque", TestSummaryDeque},
+      {"WindowDeque", TestWindowDeque},
+      {"SequencedDeque", TestSequencedDeque},
+      {"SpillingDeque", TestSpillingDeque},
+      {"SwmrDeque", TestSwmrDeque},
+      {"VarDeque<kPad>", TestVarDeque<RecordLayout::kPad>},
+      {"VarDeque<kSplit>", TestVarDeque<RecordLayout::kSplit>},
+      {"PackedDeque<1>", TestPackedDeque<1>},
+      {"PackedDeque<4>", TestPackedDeque<4>},
+      {"PackedDeque<16>", TestPackedDeque<16>},
+      {"PackedDeque<64>", TestPackedDeque<64>},
+  };
+  for (const auto& [name, test] : tests) {
+    size_t before = failures;
+    test();
+    std::cout << (failures == before ? "ok     " : "FAILED ") << name << '\n';
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "deque.hpp"
+#include "pool_allocator.hpp"
+
+// One Deque per priority lane plus a two-level bitmap of non-empty lanes, so
+// finding the highest non-empty lane is two countl_zero calls whatever the
+// number of lanes. Higher lane numbers are higher priorities. All lanes
+// allocate from one BlockPool, and a lane that runs empty releases its
+// blocks to the pool for the other lanes to reuse.
+template <typename T, size_t Lanes>
+class LaneDeque {
+  static_assert(Lanes > 0 && Lanes <= 64 * 64, "up to 4096 lanes");
+
+ public:
+  using lane_type = Deque<T, PoolAllocator<T>>;
+
+  LaneDeque() : LaneDeque(std::make_shared<BlockPool>()) {}
+
+  explicit LaneDeque(std::shared_ptr<BlockPool> pool);
+
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+  [[nodiscard]] static constexpr size_t lanes() { return Lanes; }
+
+  [[nodiscard]] const lane_type& lane(size_t idx) const { return lanes_[idx]; }
+  [[nodiscard]] const std::shared_ptr<BlockPool>& pool() const { return pool_; }
+
+  // Highest non-empty lane, if any.
+  [[nodiscard]] std::optional<size_t> highest() const;
+
+  template <typename... Args>
+  void emplace_back(size_t lane, Args&&... args);
+
+  template <typename... Args>
+  void emplace_front(size_t lane, Args&&... args);
+
+  void push_back(size_t lane, const T& value) { emplace_back(lane, value); }
+  void push_back(size_t lane, T&& value) {
+    emplace_back(lane, std::move(value));
+  }
+  void push_front(size_t lane, const T& value) { emplace_front(lane, value); }
+  void push_front(size_t lane, T&& value) {
+    emplace_front(lane, std::move(value));
+  }
+
+  // Pops the front of the highest non-empty lane.
+  std::optional<T> pop_highest();
+
+  void pop_front(size_t lane);
+  void pop_back(size_t lane);
+
+  // Moves up to count items from the front of lane `from` to the back of
+  // lane `to` and returns how many moved. Whole blocks change lanes where
+  // Deque::append_deque and split_at allow it.
+  size_t move_batch(size_t from, size_t to, size_t count = SIZE_MAX);
+
+  void clear();
+
+ private:
+  static constexpr size_t kWords = (Lanes + 63) / 64;
+
+  template <size_t... Is>
+  static std::array<lane_type, Lanes> make_lanes(
+      const PoolAllocator<T>& alloc, std::index_sequence<Is...> /*unused*/) {
+    return {((void)Is, lane_type(alloc))...};
+  }
+
+  void mark(size_t lane);
+  void release_if_empty(size_t lane);
+
+  std::shared_ptr<BlockPool> pool_;
+  std::array<lane_type, Lanes> lanes_;
+  std::array<uint64_t, kWords> words_{};
+  uint64_t summary_{0};
+  size_t size_{0};
+};
+
+template <typename T, size_t Lanes>
+LaneDeque<T, Lanes>::LaneDeque(std::shared_ptr<BlockPool> pool)
+    : pool_(std::move(pool)),
+      lanes_(make_lanes(PoolAllocator<T>(pool_),
+                        std::make_index_sequence<Lanes>{})) {}
+
+template <typename T, size_t Lanes>
+std::optional<size_t> LaneDeque<T, Lanes>::highest() const {
+  if (summary_ == 0) {
+    return std::nullopt;
+  }
+  size_t word = 63 - std::countl_zero(summary_);
+  size_t bit = 63 - std::countl_zero(words_[word]);
+  return (word * 64) + bit;
+}
+
+template <typename T, size_t Lanes>
+template <typename... Args>
+void LaneDeque<T, Lanes>::emplace_back(size_t lane, Args&&... args) {
+  lanes_[lane].emplace_back(std::forward<Args>(args)...);
+  ++size_;
+  mark(lane);
+}
+
+template <typename T, size_t Lanes>
+template <typename... Args>
+void LaneDeque<T, Lanes>::emplace_front(size_t lane, Args&&... args) {
+  lanes_[lane].emplace_front(std::forward<Args>(args)...);
+  ++size_;
+  mark(lane);
+}
+
+template <typename T, size_t Lanes>
+std::optional<T> LaneDeque<T, Lanes>::pop_highest() {
+  auto lane = highest();
+  if (!lane) {
+    return std::nullopt;
+  }
+  std::optional<T> value(std::move(*lanes_[*lane].begin()));
+  pop_front(*lane);
+  return value;
+}
+
+template <typename T, size_t Lanes>
+void LaneDeque<T, Lanes>::pop_front(size_t lane) {
+  if (lanes_[lane].empty()) {
+    return;
+  }
+  lanes_[lane].pop_front();
+  --size_;
+  release_if_empty(lane);
+}
+
+template <typename T, size_t Lanes>
+void LaneDeque<T, Lanes>::pop_back(size_t lane) {
+  if (lanes_[lane].empty()) {
+    return;
+  }
+  lanes_[lane].pop_back();
+  --size_;
+  release_if_empty(lane);
+}
+
+template <typename T, size_t Lanes>
+size_t LaneDeque<T, Lanes>::move_batch(size_t from, size_t to, size_t count) {
+  auto& source = lanes_[from];
+  if (from == to || source.empty() || count == 0) {
+    return 0;
+  }
+  size_t moved = std::min(count, source.size());
+  if (moved == source.size()) {
+    lanes_[to].append_deque(std::move(source));
+  } else {
+    lane_type rest = source.split_at(source.begin() + moved);
+    lanes_[to].append_deque(std::move(source));
+    source = std::move(rest);
+  }
+  mark(to);
+  release_if_empty(from);
+  return moved;
+}
+
+template <typename T, size_t Lanes>
+void LaneDeque<T, Lanes>::clear() {
+  for (auto& lane : lanes_) {
+    lane.clear();
+  }
+  words_.fill(0);
+  summary_ = 0;
+  size_ = 0;
+}
+
+template <typename T, size_t Lanes>
+void LaneDeque<T, Lanes>::mark(size_t lane) {
+  words_[lane / 64] |= uint64_t{1} << (lane % 64);
+  summary_ |= uint64_t{1} << (lane / 64);
+}
+
+template <typename T, size_t Lanes>
+void LaneDeque<T, Lanes>::release_if_empty(size_t lane) {
+  if (!lanes_[lane].empty()) {
+    return;
+  }
+  lanes_[lane].clear();
+  words_[lane / 64] &= ~(uint64_t{1} << (lane % 64));
+  if (words_[lane / 64] == 0) {
+    summary_ &= ~(uint64_t{1} << (lane / 64));
+  }
+}
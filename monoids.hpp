@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+// Monoids for SummaryDeque and WindowDeque. Each one lifts an element to a
+// value_type through a projection and combines values associatively, with
+// identity() as the neutral value.
+namespace monoids {
+
+template <typename Value, typename Proj = std::identity>
+struct Sum {
+  using value_type = Value;
+
+  Value identity() const { return Value{}; }
+  template <typename T>
+  Value lift(const T& value) const {
+    return static_cast<Value>(std::invoke(proj, value));
+  }
+  Value combine(const Value& lhs, const Value& rhs) const { return lhs + rhs; }
+
+  [[no_unique_address]] Proj proj;
+};
+
+template <typename Value, typename Proj = std::identity>
+struct Min {
+  using value_type = Value;
+
+  Value identity() const { return std::numeric_limits<Value>::max(); }
+  template <typename T>
+  Value lift(const T& value) const {
+    return static_cast<Value>(std::invoke(proj, value));
+  }
+  Value combine(const Value& lhs, const Value& rhs) const {
+    return std::min(lhs, rhs);
+  }
+
+  [[no_unique_address]] Proj proj;
+};
+
+template <typename Value, typename Proj = std::identity>
+struct Max {
+  using value_type = Value;
+
+  Value identity() const { return std::numeric_limits<Value>::lowest(); }
+  template <typename T>
+  Value lift(const T& value) const {
+    return static_cast<Value>(std::invoke(proj, value));
+  }
+  Value combine(const Value& lhs, const Value& rhs) const {
+    return std::max(lhs, rhs);
+  }
+
+  [[no_unique_address]] Proj proj;
+};
+
+// Both bounds at once, which is what range pruning usually wants. An empty
+// range is {max, lowest}.
+template <typename Value, typename Proj = std::identity>
+struct MinMax {
+  using value_type = std::pair<Value, Value>;
+
+  value_type identity() const {
+    return {std::numeric_limits<Value>::max(),
+            std::numeric_limits<Value>::lowest()};
+  }
+  template <typename T>
+  value_type lift(const T& value) const {
+    auto key = static_cast<Value>(std::invoke(proj, value));
+    return {key, key};
+  }
+  value_type combine(const value_type& lhs, const value_type& rhs) const {
+    return {std::min(lhs.first, rhs.first), std::max(lhs.second, rhs.second)};
+  }
+
+  [[no_unique_address]] Proj proj;
+};
+
+// Number of elements matching pred.
+template <typename Pred>
+struct Count {
+  using value_type = size_t;
+
+  size_t identity() const { return 0; }
+  template <typename T>
+  size_t lift(const T& value) const {
+    return std::invoke(pred, value) ? 1 : 0;
+  }
+  size_t combine(size_t lhs, size_t rhs) const { return lhs + rhs; }
+
+  [[no_unique_address]] Pred pred;
+};
+
+// Monoids whose combine() always returns one of its operands. Windows over
+// them keep a monotonic deque of candidates instead of partial aggregates.
+template <typename Monoid>
+struct is_selective : std::false_type {};
+
+template <typename Value, typename Proj>
+struct is_selective<Min<Value, Proj>> : std::true_type {};
+
+template <typename Value, typename Proj>
+struct is_selective<Max<Value, Proj>> : std::true_type {};
+
+}  // namespace monoids
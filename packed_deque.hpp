@@ -0,0 +1,525 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "deque.hpp"
+
+// Deque of Bits-wide unsigned values packed into 64-bit words, which are kept
+// in a Deque<uint64_t> with 4 KiB buckets. The first element may sit anywhere
+// in the first word, so both ends push and pop without shifting. Element
+// references are proxies. count(), find_first() and the bitwise operators
+// work a word at a time. PackedDeque<1> holds bools. Popping an empty deque
+// does nothing, as in Deque.
+//
+// PackedDeque<1> does not reach 64x less memory than a deque of bools: that
+// figure assumes 8-byte slots, and a bool already takes one byte, so the
+// payload shrinks 8x. Most of the rest of the gain comes from allocations.
+// For 1 << 24 flags, Deque<uint8_t> with its 8-element buckets takes about
+// 160 MiB including malloc headers, and PackedDeque<1> about 4 MiB, roughly
+// 40x.
+template <unsigned Bits, typename Allocator = std::allocator<uint64_t>>
+class PackedDeque {
+  static_assert(Bits >= 1 && Bits <= 64 && 64 % Bits == 0,
+                "Bits must divide 64");
+
+ private:
+  template <bool IsConst>
+  class Iterator;
+
+ public:
+  class Reference;
+
+  using value_type = std::conditional_t<
+      Bits == 1, bool,
+      std::conditional_t<
+          Bits <= 8, uint8_t,
+          std::conditional_t<Bits <= 16, uint16_t,
+                             std::conditional_t<Bits <= 32, uint32_t,
+                                                uint64_t>>>>;
+  using reference = Reference;
+  using const_reference = value_type;
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  static constexpr size_t kPerWord = 64 / Bits;
+
+  PackedDeque() = default;
+
+  constexpr PackedDeque(const Allocator& alloc) : words_(word_alloc(alloc)) {}
+
+  constexpr PackedDeque(size_t count, value_type value = value_type(),
+                        const Allocator& alloc = Allocator());
+
+  constexpr PackedDeque(std::initializer_list<value_type> init,
+                        const Allocator& alloc = Allocator());
+
+  template <std::input_iterator InputIt>
+  constexpr PackedDeque(InputIt first, InputIt last,
+                        const Allocator& alloc = Allocator());
+
+  constexpr iterator begin() { return iterator(this, 0); }
+  constexpr const_iterator begin() const { return const_iterator(this, 0); }
+  constexpr const_iterator cbegin() const { return begin(); }
+  constexpr iterator end() { return iterator(this, size_); }
+  constexpr const_iterator end() const { return const_iterator(this, size_); }
+  constexpr const_iterator cend() const { return end(); }
+
+  constexpr reverse_iterator rbegin() { return reverse_iterator(end()); }
+  constexpr const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  constexpr const_reverse_iterator crbegin() const { return rbegin(); }
+  constexpr reverse_iterator rend() { return reverse_iterator(begin()); }
+  constexpr const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+  constexpr const_reverse_iterator crend() const { return rend(); }
+
+  [[nodiscard]] constexpr size_t size() const { return size_; }
+  [[nodiscard]] constexpr bool empty() const { return size_ == 0; }
+  [[nodiscard]] constexpr Allocator get_allocator() const {
+    return Allocator(words_.get_allocator());
+  }
+  // Number of 64-bit words holding the elements.
+  [[nodiscard]] constexpr size_t word_count() const { return words_.size(); }
+
+  constexpr Reference operator[](size_t idx);
+  constexpr value_type operator[](size_t idx) const;
+
+  constexpr Reference at(size_t idx);
+  constexpr value_type at(size_t idx) const;
+
+  constexpr void push_back(value_type value);
+  constexpr void push_front(value_type value);
+  template <typename... Args>
+  constexpr void emplace_back(Args&&... args) {
+    push_back(value_type(std::forward<Args>(args)...));
+  }
+  template <typename... Args>
+  constexpr void emplace_front(Args&&... args) {
+    push_front(value_type(std::forward<Args>(args)...));
+  }
+
+  constexpr void pop_back();
+  constexpr void pop_front();
+
+  constexpr void clear();
+
+  constexpr void resize(size_t count, value_type value = value_type());
+
+  // Number of elements equal to value.
+  [[nodiscard]] constexpr size_t count(value_type value) const;
+  // First element equal to value, or end().
+  constexpr const_iterator find_first(value_type value) const;
+
+  // Element-wise, over deques of equal size; throws std::invalid_argument
+  // otherwise. The two may start at different offsets within their words.
+  constexpr PackedDeque& operator&=(const PackedDeque& other);
+  constexpr PackedDeque& operator|=(const PackedDeque& other);
+  constexpr PackedDeque& operator^=(const PackedDeque& other);
+
+  constexpr bool operator==(const PackedDeque& other) const {
+    return size_ == other.size_ && std::equal(begin(), end(), other.begin());
+  }
+
+ private:
+  // The caller's allocator, asking Deque for 4 KiB buckets of words: 32768
+  // flags per bucket, so the map and the per-allocation overhead stay small
+  // next to the packed payload.
+  template <typename Base>
+  struct WordAllocator : Base {
+    static constexpr size_t kBucketBytes = 4096;
+
+    template <typename U>
+    struct rebind {
+      using other = WordAllocator<
+          typename std::allocator_traits<Base>::template rebind_alloc<U>>;
+    };
+
+    constexpr WordAllocator() = default;
+    constexpr WordAllocator(const Base& base) : Base(base) {}
+    template <typename Other>
+    constexpr WordAllocator(const WordAllocator<Other>& other)
+        : Base(static_cast<const Other&>(other)) {}
+  };
+
+  using word_alloc = WordAllocator<typename std::allocator_traits<
+      Allocator>::template rebind_alloc<uint64_t>>;
+
+  static constexpr uint64_t kFieldMask =
+      Bits == 64 ? ~uint64_t{0} : (uint64_t{1} << Bits) - 1;
+  // The lowest and highest bit of every field.
+  static constexpr uint64_t kLowBits = ~uint64_t{0} / kFieldMask;
+  static constexpr uint64_t kHighBits = kLowBits << (Bits - 1);
+
+  static constexpr uint64_t BitRange(size_t from, size_t to) {
+    uint64_t upper = to == 64 ? ~uint64_t{0} : (uint64_t{1} << to) - 1;
+    return upper & ~((uint64_t{1} << from) - 1);
+  }
+
+  constexpr uint64_t valid_bits(size_t word) const;
+  constexpr uint64_t matches(uint64_t word, value_type value) const;
+  constexpr uint64_t chunk(int64_t bit) const;
+  template <typename Op>
+  constexpr void combine(const PackedDeque& other, Op op);
+
+  Deque<uint64_t, word_alloc> words_;
+  // Slot of the first element within the first word.
+  size_t first_{0};
+  size_t size_{0};
+};
+
+template <unsigned Bits, typename Allocator>
+class PackedDeque<Bits, Allocator>::Reference {
+ public:
+  constexpr operator value_type() const {
+    return static_cast<value_type>((*word_ >> shift_) & kFieldMask);
+  }
+
+  constexpr const Reference& operator=(value_type value) const {
+    *word_ = (*word_ & ~(kFieldMask << shift_)) |
+             ((static_cast<uint64_t>(value) & kFieldMask) << shift_);
+    return *this;
+  }
+  constexpr const Reference& operator=(const Reference& other) const {
+    return *this = static_cast<value_type>(other);
+  }
+
+  // Swaps the referenced values, so algorithms like std::sort work.
+  friend constexpr void swap(Reference a, Reference b) {
+    value_type value = a;
+    a = static_cast<value_type>(b);
+    b = value;
+  }
+
+ private:
+  friend PackedDeque;
+
+  constexpr Reference(uint64_t* word, unsigned shift)
+      : word_(word), shift_(shift) {}
+
+  uint64_t* word_;
+  unsigned shift_;
+};
+
+template <unsigned Bits, typename Allocator>
+template <bool IsConst>
+class PackedDeque<Bits, Allocator>::Iterator {
+ public:
+  using owner_pointer =
+      std::conditional_t<IsConst, const PackedDeque*, PackedDeque*>;
+  using value_type = PackedDeque::value_type;
+  using reference = std::conditional_t<IsConst, value_type, Reference>;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::input_iterator_tag;
+  using iterator_concept = std::random_access_iterator_tag;
+
+  Iterator() = default;
+  constexpr Iterator(owner_pointer owner, size_t idx)
+      : owner_(owner), idx_(idx) {}
+
+  constexpr reference operator*() const { return (*owner_)[idx_]; }
+  constexpr reference operator[](difference_type value) const {
+    return (*owner_)[idx_ + value];
+  }
+
+  constexpr Iterator& operator++() {
+    ++idx_;
+    return *this;
+  }
+  constexpr Iterator operator++(int) {
+    auto copy = *this;
+    ++idx_;
+    return copy;
+  }
+  constexpr Iterator& operator--() {
+    --idx_;
+    return *this;
+  }
+  constexpr Iterator operator--(int) {
+    auto copy = *this;
+    --idx_;
+    return copy;
+  }
+
+  constexpr Iterator& operator+=(difference_type value) {
+    idx_ += value;
+    return *this;
+  }
+  constexpr Iterator& operator-=(difference_type value) {
+    idx_ -= value;
+    return *this;
+  }
+  constexpr Iterator operator+(difference_type value) const {
+    return Iterator(owner_, idx_ + value);
+  }
+  friend constexpr Iterator operator+(difference_type value,
+                                      const Iterator& iter) {
+    return iter + value;
+  }
+  constexpr Iterator operator-(difference_type value) const {
+    return Iterator(owner_, idx_ - value);
+  }
+  constexpr difference_type operator-(const Iterator& other) const {
+    return static_cast<difference_type>(idx_) -
+           static_cast<difference_type>(other.idx_);
+  }
+
+  constexpr bool operator==(const Iterator& other) const {
+    return idx_ == other.idx_;
+  }
+  constexpr auto operator<=>(const Iterator& other) const {
+    return idx_ <=> other.idx_;
+  }
+
+  constexpr operator Iterator<true>() const {
+    return Iterator<true>(owner_, idx_);
+  }
+
+ private:
+  friend PackedDeque;
+
+  owner_pointer owner_{nullptr};
+  size_t idx_{0};
+};
+
+template <unsigned Bits, typename Allocator>
+constexpr PackedDeque<Bits, Allocator>::PackedDeque(size_t count,
+                                                    value_type value,
+                                                    const Allocator& alloc)
+    : PackedDeque(alloc) {
+  resize(count, value);
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr PackedDeque<Bits, Allocator>::PackedDeque(
+    std::initializer_list<value_type> init, const Allocator& alloc)
+    : PackedDeque(init.begin(), init.end(), alloc) {}
+
+template <unsigned Bits, typename Allocator>
+template <std::input_iterator InputIt>
+constexpr PackedDeque<Bits, Allocator>::PackedDeque(InputIt first,
+                                                    InputIt last,
+                                                    const Allocator& alloc)
+    : PackedDeque(alloc) {
+  for (; first != last; ++first) {
+    push_back(static_cast<value_type>(*first));
+  }
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr typename PackedDeque<Bits, Allocator>::Reference
+PackedDeque<Bits, Allocator>::operator[](size_t idx) {
+  size_t slot = first_ + idx;
+  return Reference(&words_[slot / kPerWord], (slot % kPerWord) * Bits);
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr typename PackedDeque<Bits, Allocator>::value_type
+PackedDeque<Bits, Allocator>::operator[](size_t idx) const {
+  size_t slot = first_ + idx;
+  return static_cast<value_type>(
+      (words_[slot / kPerWord] >> ((slot % kPerWord) * Bits)) & kFieldMask);
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr typename PackedDeque<Bits, Allocator>::Reference
+PackedDeque<Bits, Allocator>::at(size_t idx) {
+  if (idx >= size_) {
+    throw std::out_of_range("out of range");
+  }
+  return (*this)[idx];
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr typename PackedDeque<Bits, Allocator>::value_type
+PackedDeque<Bits, Allocator>::at(size_t idx) const {
+  if (idx >= size_) {
+    throw std::out_of_range("out of range");
+  }
+  return (*this)[idx];
+}
+
+// words_ always holds exactly the words that slots [0, first_ + size_) touch.
+template <unsigned Bits, typename Allocator>
+constexpr void PackedDeque<Bits, Allocator>::push_back(value_type value) {
+  if ((first_ + size_) % kPerWord == 0) {
+    words_.push_back(0);
+  }
+  ++size_;
+  (*this)[size_ - 1] = value;
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr void PackedDeque<Bits, Allocator>::push_front(value_type value) {
+  if (first_ == 0) {
+    words_.push_front(0);
+    first_ = kPerWord;
+  }
+  --first_;
+  ++size_;
+  (*this)[0] = value;
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr void PackedDeque<Bits, Allocator>::pop_back() {
+  if (size_ == 0) {
+    return;
+  }
+  --size_;
+  if ((first_ + size_) % kPerWord == 0) {
+    words_.pop_back();
+    if (words_.empty()) {
+      first_ = 0;
+    }
+  }
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr void PackedDeque<Bits, Allocator>::pop_front() {
+  if (size_ == 0) {
+    return;
+  }
+  --size_;
+  if (++first_ == kPerWord) {
+    words_.pop_front();
+    first_ = 0;
+  }
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr void PackedDeque<Bits, Allocator>::clear() {
+  words_.clear();
+  first_ = 0;
+  size_ = 0;
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr void PackedDeque<Bits, Allocator>::resize(size_t count,
+                                                    value_type value) {
+  while (size_ > count) {
+    pop_back();
+  }
+  while (size_ < count && (first_ + size_) % kPerWord != 0) {
+    push_back(value);
+  }
+  uint64_t fill = static_cast<uint64_t>(value) * kLowBits;
+  while (count - size_ >= kPerWord) {
+    words_.push_back(fill);
+    size_ += kPerWord;
+  }
+  while (size_ < count) {
+    push_back(value);
+  }
+}
+
+// Mask of the bits of word that belong to elements.
+template <unsigned Bits, typename Allocator>
+constexpr uint64_t PackedDeque<Bits, Allocator>::valid_bits(
+    size_t word) const {
+  size_t from = word == 0 ? first_ : 0;
+  size_t to = std::min(kPerWord, first_ + size_ - (word * kPerWord));
+  return from < to ? BitRange(from * Bits, to * Bits) : 0;
+}
+
+// Sets the high bit of every field of word that equals value. A field
+// differs from value exactly when it has a bit set after the xor; adding
+// the low bits carries any of them into the high bit without crossing into
+// the next field.
+template <unsigned Bits, typename Allocator>
+constexpr uint64_t PackedDeque<Bits, Allocator>::matches(
+    uint64_t word, value_type value) const {
+  uint64_t diff = word ^ (static_cast<uint64_t>(value) * kLowBits);
+  uint64_t differs = (((diff & ~kHighBits) + ~kHighBits) | diff) & kHighBits;
+  return ~differs & kHighBits;
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr size_t PackedDeque<Bits, Allocator>::count(value_type value) const {
+  size_t total = 0;
+  size_t word = 0;
+  for (uint64_t bits : words_) {
+    total += std::popcount(matches(bits, value) & valid_bits(word));
+    ++word;
+  }
+  return total;
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr typename PackedDeque<Bits, Allocator>::const_iterator
+PackedDeque<Bits, Allocator>::find_first(value_type value) const {
+  size_t word = 0;
+  for (uint64_t bits : words_) {
+    uint64_t found = matches(bits, value) & valid_bits(word);
+    if (found != 0) {
+      size_t slot = (word * kPerWord) + (std::countr_zero(found) / Bits);
+      return const_iterator(this, slot - first_);
+    }
+    ++word;
+  }
+  return end();
+}
+
+// The 64 bits starting at bit position bit of the word stream, reading
+// zeros outside it. bit is never below -63.
+template <unsigned Bits, typename Allocator>
+constexpr uint64_t PackedDeque<Bits, Allocator>::chunk(int64_t bit) const {
+  auto load = [this](int64_t word) -> uint64_t {
+    return word >= 0 && static_cast<size_t>(word) < words_.size()
+               ? words_[word]
+               : 0;
+  };
+  int64_t word = bit < 0 ? -1 : bit / 64;
+  auto shift = static_cast<unsigned>(bit - (word * 64));
+  uint64_t low = load(word) >> shift;
+  return shift == 0 ? low : low | (load(word + 1) << (64 - shift));
+}
+
+template <unsigned Bits, typename Allocator>
+template <typename Op>
+constexpr void PackedDeque<Bits, Allocator>::combine(const PackedDeque& other,
+                                                     Op op) {
+  if (other.size_ != size_) {
+    throw std::invalid_argument("size mismatch");
+  }
+  auto offset = (static_cast<int64_t>(other.first_) -
+                 static_cast<int64_t>(first_)) * Bits;
+  size_t word = 0;
+  for (uint64_t& bits : words_) {
+    uint64_t valid = valid_bits(word);
+    uint64_t theirs = other.chunk(static_cast<int64_t>(word * 64) + offset);
+    bits = (bits & ~valid) | (op(bits, theirs) & valid);
+    ++word;
+  }
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr PackedDeque<Bits, Allocator>&
+PackedDeque<Bits, Allocator>::operator&=(const PackedDeque& other) {
+  combine(other, [](uint64_t lhs, uint64_t rhs) { return lhs & rhs; });
+  return *this;
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr PackedDeque<Bits, Allocator>&
+PackedDeque<Bits, Allocator>::operator|=(const PackedDeque& other) {
+  combine(other, [](uint64_t lhs, uint64_t rhs) { return lhs | rhs; });
+  return *this;
+}
+
+template <unsigned Bits, typename Allocator>
+constexpr PackedDeque<Bits, Allocator>&
+PackedDeque<Bits, Allocator>::operator^=(const PackedDeque& other) {
+  combine(other, [](uint64_t lhs, uint64_t rhs) { return lhs ^ rhs; });
+  return *this;
+}
@@ -0,0 +1,682 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "deque.hpp"
+
+// Immutable deque: every modification returns a new version and leaves the
+// old one intact, with unchanged chunks shared between versions. Elements
+// live in chunks of about 512 bytes. Up to two chunks per side sit in a
+// finger-like digit; the chunks between them hang off a persistent treap
+// that carries subtree sizes, so pushes and pops at the ends are O(1)
+// amortized and indexing is O(log n).
+//
+// Versions that share chunks must be used from one thread at a time: a push
+// extends a shared chunk in place, and a pop lets the next push reuse the
+// popped slot, without synchronization. Hand a version to another thread
+// only once no version it shares chunks with is used anymore.
+template <typename T, typename Allocator = std::allocator<T>>
+class PersistentDeque {
+ private:
+  struct Chunk;
+  struct ChunkRef;
+  struct Node;
+
+  class Iterator;
+
+ public:
+  using value_type = T;
+  using iterator = Iterator;
+  using const_iterator = Iterator;
+  using reverse_iterator = std::reverse_iterator<const_iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  class Builder;
+
+  PersistentDeque() = default;
+
+  PersistentDeque(const Allocator& alloc);
+
+  PersistentDeque(std::initializer_list<T> init,
+                  const Allocator& alloc = Allocator());
+
+  // Bulk-loads a Deque through a Builder.
+  template <typename DequeAllocator>
+  static PersistentDeque from(const Deque<T, DequeAllocator>& deque,
+                              const Allocator& alloc = Allocator());
+
+  const_iterator begin() const { return Iterator(this, 0); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator end() const { return Iterator(this, size_); }
+  const_iterator cend() const { return end(); }
+
+  const_reverse_iterator rbegin() const {
+    return std::make_reverse_iterator(end());
+  }
+  const_reverse_iterator crbegin() const { return rbegin(); }
+  const_reverse_iterator rend() const {
+    return std::make_reverse_iterator(begin());
+  }
+  const_reverse_iterator crend() const { return rend(); }
+
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+  [[nodiscard]] Allocator get_allocator() const { return alloc_; }
+
+  const T& operator[](size_t idx) const;
+  const T& at(size_t idx) const;
+
+  template <typename... Args>
+  [[nodiscard]] PersistentDeque emplace_back(Args&&... args) const;
+
+  template <typename... Args>
+  [[nodiscard]] PersistentDeque emplace_front(Args&&... args) const;
+
+  [[nodiscard]] PersistentDeque push_back(const T& value) const {
+    return emplace_back(value);
+  }
+  [[nodiscard]] PersistentDeque push_back(T&& value) const {
+    return emplace_back(std::move(value));
+  }
+  [[nodiscard]] PersistentDeque push_front(const T& value) const {
+    return emplace_front(value);
+  }
+  [[nodiscard]] PersistentDeque push_front(T&& value) const {
+    return emplace_front(std::move(value));
+  }
+
+  [[nodiscard]] PersistentDeque pop_back() const;
+  [[nodiscard]] PersistentDeque pop_front() const;
+
+ private:
+  using alloc_traits = std::allocator_traits<Allocator>;
+  using NodePtr = std::shared_ptr<const Node>;
+
+  static constexpr size_t kChunkSize =
+      std::bit_floor(std::max<size_t>(8, 512 / sizeof(T)));
+
+  // A chunk's elements in [lo, hi) are constructed. Versions that see the
+  // chunk up to its current edge extend it in place; all other versions copy
+  // their view first. Slots that only popped-from versions could see are
+  // reclaimed once those versions are gone, so alternating pops and pushes
+  // stay in place.
+  struct Chunk {
+    explicit Chunk(const Allocator& alloc, size_t pos)
+        : alloc(alloc),
+          data(alloc_traits::allocate(this->alloc, kChunkSize)),
+          lo(pos),
+          hi(pos) {}
+    Chunk(const Chunk&) = delete;
+    Chunk& operator=(const Chunk&) = delete;
+    ~Chunk();
+
+    Allocator alloc;
+    T* data;
+    size_t lo;
+    size_t hi;
+  };
+
+  struct ChunkRef {
+    [[nodiscard]] size_t size() const { return hi - lo; }
+    explicit operator bool() const { return chunk != nullptr; }
+
+    std::shared_ptr<Chunk> chunk;
+    size_t lo{0};
+    size_t hi{0};
+  };
+
+  struct Node {
+    NodePtr left;
+    NodePtr right;
+    ChunkRef chunk;
+    size_t total{0};
+    uint64_t priority{0};
+  };
+
+  // Where an index lands: the chunk data and the index range it holds.
+  struct Location {
+    const T* data;
+    size_t first;
+    size_t last;
+  };
+
+  ChunkRef make_chunk(size_t pos) const;
+  ChunkRef copy_view(const ChunkRef& ref) const;
+  template <typename... Args>
+  void append(ChunkRef& ref, Args&&... args) const;
+  template <typename... Args>
+  void prepend(ChunkRef& ref, Args&&... args) const;
+  static void trim_back(ChunkRef& ref);
+  static void trim_front(ChunkRef& ref);
+
+  static size_t total(const NodePtr& node) { return node ? node->total : 0; }
+  static uint64_t priority_of(const ChunkRef& ref);
+  NodePtr make_node(ChunkRef chunk, NodePtr left, NodePtr right,
+                    uint64_t priority) const;
+  NodePtr merge(const NodePtr& lhs, const NodePtr& rhs) const;
+  std::pair<NodePtr, ChunkRef> pop_first(const NodePtr& node) const;
+  std::pair<NodePtr, ChunkRef> pop_last(const NodePtr& node) const;
+  NodePtr build_tree(std::vector<ChunkRef>& chunks) const;
+
+  Location locate(size_t idx) const;
+
+  // Sequence order: front_outer_, front_inner_, root_, back_inner_,
+  // back_outer_. An inner chunk is only set while its outer one is.
+  ChunkRef front_outer_;
+  ChunkRef front_inner_;
+  NodePtr root_;
+  ChunkRef back_inner_;
+  ChunkRef back_outer_;
+  size_t size_{0};
+
+  [[no_unique_address]] Allocator alloc_;
+};
+
+// Appends into exclusively owned chunks and builds the tree in one linear
+// pass when done.
+template <typename T, typename Allocator>
+class PersistentDeque<T, Allocator>::Builder {
+ public:
+  Builder() = default;
+  explicit Builder(const Allocator& alloc) : owner_(alloc) {}
+
+  template <typename... Args>
+  void emplace_back(Args&&... args);
+
+  void push_back(const T& value) { emplace_back(value); }
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+
+  [[nodiscard]] size_t size() const { return size_; }
+
+  PersistentDeque build() &&;
+
+ private:
+  PersistentDeque owner_;
+  std::vector<ChunkRef> chunks_;
+  size_t size_{0};
+};
+
+template <typename T, typename Allocator>
+class PersistentDeque<T, Allocator>::Iterator {
+ public:
+  using value_type = T;
+  using pointer = const T*;
+  using reference = const T&;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::random_access_iterator_tag;
+  using iterator_concept = std::random_access_iterator_tag;
+
+  Iterator() = default;
+  Iterator(const PersistentDeque* owner, size_t idx)
+      : owner_(owner), idx_(idx) {}
+
+  reference operator*() const;
+  pointer operator->() const { return &**this; }
+  reference operator[](difference_type value) const {
+    return (*owner_)[idx_ + value];
+  }
+
+  Iterator& operator++() {
+    ++idx_;
+    return *this;
+  }
+  Iterator operator++(int) {
+    auto copy = *this;
+    ++idx_;
+    return copy;
+  }
+  Iterator& operator--() {
+    --idx_;
+    return *this;
+  }
+  Iterator operator--(int) {
+    auto copy = *this;
+    --idx_;
+    return copy;
+  }
+
+  Iterator& operator+=(difference_type value) {
+    idx_ += value;
+    return *this;
+  }
+  Iterator& operator-=(difference_type value) {
+    idx_ -= value;
+    return *this;
+  }
+  Iterator operator+(difference_type value) const {
+    auto copy = *this;
+    copy.idx_ += value;
+    return copy;
+  }
+  friend Iterator operator+(difference_type value, const Iterator& iter) {
+    return iter + value;
+  }
+  Iterator operator-(difference_type value) const {
+    auto copy = *this;
+    copy.idx_ -= value;
+    return copy;
+  }
+  difference_type operator-(const Iterator& other) const {
+    return static_cast<difference_type>(idx_) -
+           static_cast<difference_type>(other.idx_);
+  }
+
+  bool operator==(const Iterator& other) const { return idx_ == other.idx_; }
+  auto operator<=>(const Iterator& other) const { return idx_ <=> other.idx_; }
+
+ private:
+  const PersistentDeque* owner_{nullptr};
+  size_t idx_{0};
+  // The chunk last looked up, so that walking within it skips the tree.
+  mutable Location cache_{nullptr, 0, 0};
+};
+
+// PersistentDeque
+
+template <typename T, typename Allocator>
+PersistentDeque<T, Allocator>::PersistentDeque(const Allocator& alloc)
+    : alloc_(alloc) {}
+
+template <typename T, typename Allocator>
+PersistentDeque<T, Allocator>::PersistentDeque(std::initializer_list<T> init,
+                                               const Allocator& alloc) {
+  Builder builder(alloc);
+  for (const auto& value : init) {
+    builder.push_back(value);
+  }
+  *this = std::move(builder).build();
+}
+
+template <typename T, typename Allocator>
+template <typename DequeAllocator>
+PersistentDeque<T, Allocator> PersistentDeque<T, Allocator>::from(
+    const Deque<T, DequeAllocator>& deque, const Allocator& alloc) {
+  Builder builder(alloc);
+  for (auto segment : deque.segments()) {
+    for (const auto& value : segment) {
+      builder.push_back(value);
+    }
+  }
+  return std::move(builder).build();
+}
+
+template <typename T, typename Allocator>
+const T& PersistentDeque<T, Allocator>::operator[](size_t idx) const {
+  Location loc = locate(idx);
+  return loc.data[idx - loc.first];
+}
+
+template <typename T, typename Allocator>
+const T& PersistentDeque<T, Allocator>::at(size_t idx) const {
+  if (idx >= size_) {
+    throw std::out_of_range("out of range");
+  }
+  return (*this)[idx];
+}
+
+template <typename T, typename Allocator>
+template <typename... Args>
+PersistentDeque<T, Allocator> PersistentDeque<T, Allocator>::emplace_back(
+    Args&&... args) const {
+  PersistentDeque result = *this;
+  if (result.back_outer_ && result.back_outer_.hi == kChunkSize) {
+    if (result.back_inner_) {
+      result.root_ = merge(result.root_,
+                           make_node(result.back_inner_, nullptr, nullptr,
+                                     priority_of(result.back_inner_)));
+    }
+    result.back_inner_ = std::move(result.back_outer_);
+    result.back_outer_ = ChunkRef{};
+  }
+  if (!result.back_outer_) {
+    result.back_outer_ = make_chunk(0);
+  }
+  trim_back(result.back_outer_);
+  append(result.back_outer_, std::forward<Args>(args)...);
+  ++result.size_;
+  return result;
+}
+
+template <typename T, typename Allocator>
+template <typename... Args>
+PersistentDeque<T, Allocator> PersistentDeque<T, Allocator>::emplace_front(
+    Args&&... args) const {
+  PersistentDeque result = *this;
+  if (result.front_outer_ && result.front_outer_.lo == 0) {
+    if (result.front_inner_) {
+      result.root_ = merge(make_node(result.front_inner_, nullptr, nullptr,
+                                     priority_of(result.front_inner_)),
+                           result.root_);
+    }
+    result.front_inner_ = std::move(result.front_outer_);
+    result.front_outer_ = ChunkRef{};
+  }
+  if (!result.front_outer_) {
+    result.front_outer_ = make_chunk(kChunkSize);
+  }
+  trim_front(result.front_outer_);
+  prepend(result.front_outer_, std::forward<Args>(args)...);
+  ++result.size_;
+  return result;
+}
+
+template <typename T, typename Allocator>
+PersistentDeque<T, Allocator> PersistentDeque<T, Allocator>::pop_back() const {
+  PersistentDeque result = *this;
+  if (size_ == 0) {
+    return result;
+  }
+  if (!result.back_outer_) {
+    if (result.root_) {
+      std::tie(result.root_, result.back_outer_) = pop_last(result.root_);
+    } else if (result.front_inner_) {
+      result.back_outer_ = std::move(result.front_inner_);
+      result.front_inner_ = ChunkRef{};
+    } else {
+      result.back_outer_ = std::move(result.front_outer_);
+      result.front_outer_ = ChunkRef{};
+    }
+  }
+  --result.back_outer_.hi;
+  if (result.back_outer_.size() == 0) {
+    result.back_outer_ = std::move(result.back_inner_);
+    result.back_inner_ = ChunkRef{};
+  }
+  --result.size_;
+  return result;
+}
+
+template <typename T, typename Allocator>
+PersistentDeque<T, Allocator> PersistentDeque<T, Allocator>::pop_front()
+    const {
+  PersistentDeque result = *this;
+  if (size_ == 0) {
+    return result;
+  }
+  if (!result.front_outer_) {
+    if (result.root_) {
+      std::tie(result.root_, result.front_outer_) = pop_first(result.root_);
+    } else if (result.back_inner_) {
+      result.front_outer_ = std::move(result.back_inner_);
+      result.back_inner_ = ChunkRef{};
+    } else {
+      result.front_outer_ = std::move(result.back_outer_);
+      result.back_outer_ = ChunkRef{};
+    }
+  }
+  ++result.front_outer_.lo;
+  if (result.front_outer_.size() == 0) {
+    result.front_outer_ = std::move(result.front_inner_);
+    result.front_inner_ = ChunkRef{};
+  }
+  --result.size_;
+  return result;
+}
+
+template <typename T, typename Allocator>
+typename PersistentDeque<T, Allocator>::ChunkRef
+PersistentDeque<T, Allocator>::make_chunk(size_t pos) const {
+  return ChunkRef{std::allocate_shared<Chunk>(alloc_, alloc_, pos), pos, pos};
+}
+
+template <typename T, typename Allocator>
+typename PersistentDeque<T, Allocator>::ChunkRef
+PersistentDeque<T, Allocator>::copy_view(const ChunkRef& ref) const {
+  ChunkRef copy = make_chunk(ref.lo);
+  T* data = copy.chunk->data;
+  for (size_t idx = ref.lo; idx < ref.hi; ++idx) {
+    alloc_traits::construct(copy.chunk->alloc, data + idx,
+                            ref.chunk->data[idx]);
+    copy.chunk->hi = idx + 1;
+  }
+  copy.hi = ref.hi;
+  return copy;
+}
+
+template <typename T, typename Allocator>
+template <typename... Args>
+void PersistentDeque<T, Allocator>::append(ChunkRef& ref,
+                                           Args&&... args) const {
+  if (ref.chunk->hi != ref.hi) {
+    ref = copy_view(ref);
+  }
+  alloc_traits::construct(ref.chunk->alloc, ref.chunk->data + ref.hi,
+                          std::forward<Args>(args)...);
+  ++ref.hi;
+  ref.chunk->hi = ref.hi;
+}
+
+template <typename T, typename Allocator>
+template <typename... Args>
+void PersistentDeque<T, Allocator>::prepend(ChunkRef& ref,
+                                            Args&&... args) const {
+  if (ref.chunk->lo != ref.lo) {
+    ref = copy_view(ref);
+  }
+  alloc_traits::construct(ref.chunk->alloc, ref.chunk->data + ref.lo - 1,
+                          std::forward<Args>(args)...);
+  --ref.lo;
+  ref.chunk->lo = ref.lo;
+}
+
+// Called on the copy of *this's chunk in a version being built. A use count
+// of two means no other version holds the chunk, so the slots past ref's view
+// belong to versions that are gone and can be destroyed. The count is exact
+// only because versions sharing a chunk stay on one thread.
+template <typename T, typename Allocator>
+void PersistentDeque<T, Allocator>::trim_back(ChunkRef& ref) {
+  if (ref.chunk.use_count() != 2) {
+    return;
+  }
+  for (size_t idx = ref.hi; idx < ref.chunk->hi; ++idx) {
+    alloc_traits::destroy(ref.chunk->alloc, ref.chunk->data + idx);
+  }
+  ref.chunk->hi = ref.hi;
+}
+
+template <typename T, typename Allocator>
+void PersistentDeque<T, Allocator>::trim_front(ChunkRef& ref) {
+  if (ref.chunk.use_count() != 2) {
+    return;
+  }
+  for (size_t idx = ref.chunk->lo; idx < ref.lo; ++idx) {
+    alloc_traits::destroy(ref.chunk->alloc, ref.chunk->data + idx);
+  }
+  ref.chunk->lo = ref.lo;
+}
+
+// Derived from the chunk's address, so nodes need no random state and a
+// chunk keeps its priority in every version that holds it.
+template <typename T, typename Allocator>
+uint64_t PersistentDeque<T, Allocator>::priority_of(const ChunkRef& ref) {
+  auto value = reinterpret_cast<uint64_t>(ref.chunk.get());
+  value += 0x9E3779B97F4A7C15ULL;
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+  return value ^ (value >> 31);
+}
+
+template <typename T, typename Allocator>
+typename PersistentDeque<T, Allocator>::NodePtr
+PersistentDeque<T, Allocator>::make_node(ChunkRef chunk, NodePtr left,
+                                         NodePtr right,
+                                         uint64_t priority) const {
+  auto node = std::allocate_shared<Node>(alloc_);
+  node->total = chunk.size() + total(left) + total(right);
+  node->chunk = std::move(chunk);
+  node->left = std::move(left);
+  node->right = std::move(right);
+  node->priority = priority;
+  return node;
+}
+
+template <typename T, typename Allocator>
+typename PersistentDeque<T, Allocator>::NodePtr
+PersistentDeque<T, Allocator>::merge(const NodePtr& lhs,
+                                     const NodePtr& rhs) const {
+  if (!lhs) {
+    return rhs;
+  }
+  if (!rhs) {
+    return lhs;
+  }
+  if (lhs->priority > rhs->priority) {
+    return make_node(lhs->chunk, lhs->left, merge(lhs->right, rhs),
+                     lhs->priority);
+  }
+  return make_node(rhs->chunk, merge(lhs, rhs->left), rhs->right,
+                   rhs->priority);
+}
+
+template <typename T, typename Allocator>
+std::pair<typename PersistentDeque<T, Allocator>::NodePtr,
+          typename PersistentDeque<T, Allocator>::ChunkRef>
+PersistentDeque<T, Allocator>::pop_first(const NodePtr& node) const {
+  if (!node->left) {
+    return {node->right, node->chunk};
+  }
+  auto [left, chunk] = pop_first(node->left);
+  return {make_node(node->chunk, std::move(left), node->right, node->priority),
+          std::move(chunk)};
+}
+
+template <typename T, typename Allocator>
+std::pair<typename PersistentDeque<T, Allocator>::NodePtr,
+          typename PersistentDeque<T, Allocator>::ChunkRef>
+PersistentDeque<T, Allocator>::pop_last(const NodePtr& node) const {
+  if (!node->right) {
+    return {node->left, node->chunk};
+  }
+  auto [right, chunk] = pop_last(node->right);
+  return {make_node(node->chunk, node->left, std::move(right), node->priority),
+          std::move(chunk)};
+}
+
+// Cartesian-tree construction over the chunk priorities: each chunk pops the
+// lower-priority nodes off the right spine and adopts them as its left
+// subtree. Totals are filled in bottom-up afterwards.
+template <typename T, typename Allocator>
+typename PersistentDeque<T, Allocator>::NodePtr
+PersistentDeque<T, Allocator>::build_tree(std::vector<ChunkRef>& chunks) const {
+  std::vector<std::shared_ptr<Node>> spine;
+  for (auto& chunk : chunks) {
+    auto node = std::allocate_shared<Node>(alloc_);
+    node->priority = priority_of(chunk);
+    node->chunk = std::move(chunk);
+    std::shared_ptr<Node> last;
+    while (!spine.empty() && spine.back()->priority < node->priority) {
+      last = std::move(spine.back());
+      spine.pop_back();
+    }
+    node->left = std::move(last);
+    if (!spine.empty()) {
+      spine.back()->right = node;
+    }
+    spine.push_back(std::move(node));
+  }
+  if (spine.empty()) {
+    return nullptr;
+  }
+  auto fill = [](auto& self, const Node* node) -> size_t {
+    if (node == nullptr) {
+      return 0;
+    }
+    // Nodes are only const through NodePtr; nothing else sees them yet.
+    auto* mutable_node = const_cast<Node*>(node);
+    mutable_node->total = node->chunk.size() + self(self, node->left.get()) +
+                          self(self, node->right.get());
+    return node->total;
+  };
+  fill(fill, spine.front().get());
+  return spine.front();
+}
+
+template <typename T, typename Allocator>
+typename PersistentDeque<T, Allocator>::Location
+PersistentDeque<T, Allocator>::locate(size_t idx) const {
+  size_t first = 0;
+  for (const ChunkRef* ref : {&front_outer_, &front_inner_}) {
+    if (idx < first + ref->size()) {
+      return {ref->chunk->data + ref->lo, first, first + ref->size()};
+    }
+    first += ref->size();
+  }
+  if (idx < first + total(root_)) {
+    const Node* node = root_.get();
+    while (true) {
+      size_t left = total(node->left);
+      if (idx < first + left) {
+        node = node->left.get();
+      } else if (idx < first + left + node->chunk.size()) {
+        first += left;
+        const ChunkRef& ref = node->chunk;
+        return {ref.chunk->data + ref.lo, first, first + ref.size()};
+      } else {
+        first += left + node->chunk.size();
+        node = node->right.get();
+      }
+    }
+  }
+  first += total(root_);
+  if (idx < first + back_inner_.size()) {
+    return {back_inner_.chunk->data + back_inner_.lo, first,
+            first + back_inner_.size()};
+  }
+  first += back_inner_.size();
+  return {back_outer_.chunk->data + back_outer_.lo, first,
+          first + back_outer_.size()};
+}
+
+// Chunk
+
+template <typename T, typename Allocator>
+PersistentDeque<T, Allocator>::Chunk::~Chunk() {
+  for (size_t idx = lo; idx < hi; ++idx) {
+    alloc_traits::destroy(alloc, data + idx);
+  }
+  alloc_traits::deallocate(alloc, data, kChunkSize);
+}
+
+// Builder
+
+template <typename T, typename Allocator>
+template <typename... Args>
+void PersistentDeque<T, Allocator>::Builder::emplace_back(Args&&... args) {
+  if (chunks_.empty() || chunks_.back().hi == kChunkSize) {
+    chunks_.push_back(owner_.make_chunk(0));
+  }
+  owner_.append(chunks_.back(), std::forward<Args>(args)...);
+  ++size_;
+}
+
+template <typename T, typename Allocator>
+PersistentDeque<T, Allocator> PersistentDeque<T, Allocator>::Builder::build()
+    && {
+  PersistentDeque result(owner_.alloc_);
+  if (chunks_.empty()) {
+    return result;
+  }
+  result.back_outer_ = std::move(chunks_.back());
+  chunks_.pop_back();
+  result.root_ = result.build_tree(chunks_);
+  result.size_ = size_;
+  chunks_.clear();
+  size_ = 0;
+  return result;
+}
+
+// Iterator
+
+template <typename T, typename Allocator>
+typename PersistentDeque<T, Allocator>::Iterator::reference
+PersistentDeque<T, Allocator>::Iterator::operator*() const {
+  if (cache_.data == nullptr || idx_ < cache_.first || idx_ >= cache_.last) {
+    cache_ = owner_->locate(idx_);
+  }
+  return cache_.data[idx_ - cache_.first];
+}
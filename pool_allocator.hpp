@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Caches freed allocations by size and alignment so that deques sharing the
+// pool reuse each other's blocks instead of going back to operator new. Not
+// thread-safe.
+class BlockPool {
+ public:
+  BlockPool() = default;
+
+  BlockPool(const BlockPool&) = delete;
+  BlockPool& operator=(const BlockPool&) = delete;
+
+  ~BlockPool() { trim(); }
+
+  void* allocate(size_t bytes, size_t align);
+  void deallocate(void* ptr, size_t bytes, size_t align);
+
+  // Hands every cached allocation back to operator delete.
+  void trim();
+
+  [[nodiscard]] size_t cached_bytes() const;
+
+ private:
+  struct FreeList {
+    size_t bytes;
+    size_t align;
+    std::vector<void*> blocks;
+  };
+
+  FreeList& list_for(size_t bytes, size_t align);
+
+  std::vector<FreeList> lists_;
+};
+
+// Allocator front end for a shared BlockPool. A default-constructed
+// allocator has no pool and uses operator new directly.
+template <typename T>
+struct PoolAllocator {
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  PoolAllocator() = default;
+
+  explicit PoolAllocator(std::shared_ptr<BlockPool> pool)
+      : pool(std::move(pool)) {}
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool) {}
+
+  T* allocate(size_t count) {
+    if (pool == nullptr) {
+      return static_cast<T*>(
+          ::operator new(count * sizeof(T), std::align_val_t{alignof(T)}));
+    }
+    return static_cast<T*>(pool->allocate(count * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* ptr, size_t count) {
+    if (pool == nullptr) {
+      ::operator delete(ptr, std::align_val_t{alignof(T)});
+      return;
+    }
+    pool->deallocate(ptr, count * sizeof(T), alignof(T));
+  }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U>& other) const {
+    return pool == other.pool;
+  }
+
+  std::shared_ptr<BlockPool> pool;
+};
+
+inline void* BlockPool::allocate(size_t bytes, size_t align) {
+  auto& blocks = list_for(bytes, align).blocks;
+  if (blocks.empty()) {
+    return ::operator new(bytes, std::align_val_t{align});
+  }
+  void* ptr = blocks.back();
+  blocks.pop_back();
+  return ptr;
+}
+
+inline void BlockPool::deallocate(void* ptr, size_t bytes, size_t align) {
+  try {
+    list_for(bytes, align).blocks.push_back(ptr);
+  } catch (...) {
+    ::operator delete(ptr, std::align_val_t{align});
+  }
+}
+
+inline void BlockPool::trim() {
+  for (auto& list : lists_) {
+    for (void* ptr : list.blocks) {
+      ::operator delete(ptr, std::align_val_t{list.align});
+    }
+    list.blocks.clear();
+  }
+}
+
+inline size_t BlockPool::cached_bytes() const {
+  size_t total = 0;
+  for (const auto& list : lists_) {
+    total += list.bytes * list.blocks.size();
+  }
+  return total;
+}
+
+inline BlockPool::FreeList& BlockPool::list_for(size_t bytes, size_t align) {
+  for (auto& list : lists_) {
+    if (list.bytes == bytes && list.align == align) {
+      return list;
+    }
+  }
+  lists_.push_back(FreeList{bytes, align, {}});
+  return lists_.back();
+}
@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "deque.hpp"
+
+// Runs a fixed matrix of Deque workloads at -O2 and compares their time and
+// allocator calls per op against a checked-in baseline. Exits with 1 and
+// prints the table when any workload regresses.
+//
+//   deque_regression [--update] [--time-tolerance X] [baseline]
+//
+// Times are kept as ratios to a reference workload on std::vector measured
+// in the same run, so the baseline carries over between hosts of similar
+// shape; the host it was written on is recorded in its header. --update
+// rewrites the baseline from this run. A workload regresses when its ratio
+// exceeds baseline * (1 + X), X defaulting to 0.5, or when it makes more
+// allocate or deallocate calls per op than the baseline plus 1%.
+
+#ifndef REGRESSION_BASELINE
+#define REGRESSION_BASELINE "regression_baseline.txt"
+#endif
+
+static constexpr size_t kRepetitions = 7;
+static constexpr size_t kElements = size_t{1} << 20;
+static constexpr size_t kQueueLength = 1024;
+static constexpr size_t kInsertBase = size_t{1} << 14;
+static constexpr size_t kInserts = 1024;
+static constexpr size_t kSplits = 1024;
+static constexpr double kAllocTolerance = 0.01;
+
+volatile int64_t sink = 0;
+
+struct AllocCounter {
+  static size_t allocations;
+  static size_t deallocations;
+};
+
+size_t AllocCounter::allocations = 0;
+size_t AllocCounter::deallocations = 0;
+
+// Counts allocate/deallocate calls, like main.cpp's AllocatorWithCount but
+// without hooking construct/destroy, so it does not slow the timed loops.
+template <typename T>
+struct CountingAllocator {
+  using value_type = T;
+
+  CountingAllocator() = default;
+
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U>& /*other*/) {}
+
+  T* allocate(size_t count) {
+    ++AllocCounter::allocations;
+    return std::allocator<T>().allocate(count);
+  }
+
+  void deallocate(T* ptr, size_t count) {
+    ++AllocCounter::deallocations;
+    std::allocator<T>().deallocate(ptr, count);
+  }
+
+  template <typename U>
+  bool operator==(const CountingAllocator<U>& /*other*/) const {
+    return true;
+  }
+};
+
+using Counted = Deque<int64_t, CountingAllocator<int64_t>>;
+
+struct Measurement {
+  double ns_per_op;
+  double allocs_per_op;
+  double deallocs_per_op;
+};
+
+// What the baseline stores: time relative to the reference workload.
+struct Budget {
+  double time_ratio;
+  double allocs_per_op;
+  double deallocs_per_op;
+};
+
+struct Workload {
+  std::string name;
+  size_t ops;
+  std::function<void()> run;
+};
+
+template <typename Func>
+Measurement Measure(size_t ops, Func func) {
+  std::vector<double> samples;
+  AllocCounter::allocations = 0;
+  AllocCounter::deallocations = 0;
+  for (size_t rep = 0; rep < kRepetitions; ++rep) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto stop = std::chrono::steady_clock::now();
+    samples.push_back(
+        std::chrono::duration<double, std::nano>(stop - start).count() /
+        static_cast<double>(ops));
+  }
+  std::sort(samples.begin(), samples.end());
+  auto total_ops = static_cast<double>(ops * kRepetitions);
+  return {samples[samples.size() / 2],
+          static_cast<double>(AllocCounter::allocations) / total_ops,
+          static_cast<double>(AllocCounter::deallocations) / total_ops};
+}
+
+// Fills, sums and gathers from a std::vector: the same mix of streaming and
+// random access as the Deque workloads, but with no Deque code in it, so it
+// only tracks the speed of the host.
+Workload MakeReference() {
+  static std::vector<size_t> indices = [] {
+    std::vector<size_t> result(kElements);
+    std::mt19937 rng(7);
+    for (auto& idx : result) {
+      idx = rng() % kElements;
+    }
+    return result;
+  }();
+  return {"reference", kElements, [] {
+            std::vector<int64_t> values;
+            values.reserve(kElements);
+            for (size_t idx = 0; idx < kElements; ++idx) {
+              values.push_back(static_cast<int64_t>(idx));
+            }
+            int64_t total = 0;
+            for (int64_t value : values) {
+              total += value;
+            }
+            for (size_t idx : indices) {
+              total += values[idx];
+            }
+            sink = sink + total;
+          }};
+}
+
+std::string HostName() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.starts_with("model name")) {
+      return line.substr(line.find(':') + 2);
+    }
+  }
+  return "unknown";
+}
+
+Counted MakeFilled(size_t count) {
+  Counted deque;
+  for (size_t idx = 0; idx < count; ++idx) {
+    deque.push_back(static_cast<int64_t>(idx));
+  }
+  return deque;
+}
+
+std::vector<Workload> MakeWorkloads() {
+  static Counted filled = MakeFilled(kElements);
+  static Counted queue = MakeFilled(kQueueLength);
+  static Counted reload = MakeFilled(kElements);
+  static Counted middle = MakeFilled(kInsertBase);
+  static Counted spliced = MakeFilled(kElements);
+  static std::vector<size_t> indices = [] {
+    std::vector<size_t> result(kElements);
+    std::mt19937 rng(42);
+    for (auto& idx : result) {
+      idx = rng() % kElements;
+    }
+    return result;
+  }();
+
+  return {
+      {"push_back", kElements,
+       [] {
+         Counted deque;
+         for (size_t idx = 0; idx < kElements; ++idx) {
+           deque.push_back(static_cast<int64_t>(idx));
+         }
+         sink = sink + static_cast<int64_t>(deque.size());
+       }},
+      {"push_front", kElements,
+       [] {
+         Counted deque;
+         for (size_t idx = 0; idx < kElements; ++idx) {
+           deque.push_front(static_cast<int64_t>(idx));
+         }
+         sink = sink + static_cast<int64_t>(deque.size());
+       }},
+      {"fifo_push_pop", kElements,
+       [] {
+         for (size_t idx = 0; idx < kElements; ++idx) {
+           queue.push_back(static_cast<int64_t>(idx));
+           queue.pop_front();
+         }
+       }},
+      {"random_access", kElements,
+       [] {
+         int64_t total = 0;
+         for (size_t idx : indices) {
+           total += filled[idx];
+         }
+         sink = sink + total;
+       }},
+      {"iterate", kElements,
+       [] {
+         int64_t total = 0;
+         for (int64_t value : filled) {
+           total += value;
+         }
+         sink = sink + total;
+       }},
+      {"copy", kElements,
+       [] {
+         Counted copy(filled);
+         sink = sink + static_cast<int64_t>(copy.size());
+       }},
+      {"assign_reload", kElements,
+       [] {
+         reload.assign(filled.begin(), filled.end());
+       }},
+      {"middle_insert_erase", kInserts,
+       [] {
+         for (size_t idx = 0; idx < kInserts; ++idx) {
+           middle.insert(middle.begin() + (middle.size() / 2),
+                         static_cast<int64_t>(idx));
+         }
+         for (size_t idx = 0; idx < kInserts; ++idx) {
+           middle.erase(middle.begin() + (middle.size() / 2));
+         }
+       }},
+      {"split_append", kSplits,
+       [] {
+         for (size_t idx = 0; idx < kSplits; ++idx) {
+           Counted tail = spliced.split_at(spliced.begin() +
+                                           (spliced.size() / 2));
+           spliced.append_deque(std::move(tail));
+         }
+       }},
+  };
+}
+
+std::map<std::string, Budget> ReadBaseline(const std::string& path) {
+  std::map<std::string, Budget> baseline;
+  std::ifstream input(path);
+  std::string line;
+  while (std::getline(input, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    std::string name;
+    Budget budget{};
+    if (fields >> name >> budget.time_ratio >> budget.allocs_per_op >>
+        budget.deallocs_per_op) {
+      baseline[name] = budget;
+    }
+  }
+  return baseline;
+}
+
+void WriteBaseline(const std::string& path,
+                   const std::vector<std::string>& names,
+                   const std::map<std::string, Budget>& budgets,
+                   double reference_ns) {
+  std::ofstream output(path);
+  output << "# host: " << HostName() << '\n';
+  output << "# compiler: " << __VERSION__ << '\n';
+  output << "# reference: " << reference_ns << " ns/op\n";
+  output << "# workload time_ratio allocs_per_op deallocs_per_op\n";
+  output << std::setprecision(6);
+  for (const auto& name : names) {
+    const auto& budget = budgets.at(name);
+    output << name << ' ' << budget.time_ratio << ' ' << budget.allocs_per_op
+           << ' ' << budget.deallocs_per_op << '\n';
+  }
+}
+
+int main(int argc, char** argv) {
+  std::string path = REGRESSION_BASELINE;
+  bool update = false;
+  double time_tolerance = 0.5;
+  for (int arg = 1; arg < argc; ++arg) {
+    std::string value = argv[arg];
+    if (value == "--update") {
+      update = true;
+    } else if (value == "--time-tolerance" && arg + 1 < argc) {
+      time_tolerance = std::atof(argv[++arg]);
+    } else {
+      path = value;
+    }
+  }
+
+  auto reference = MakeReference();
+  double reference_ns = Measure(reference.ops, reference.run).ns_per_op;
+  std::vector<std::string> names;
+  std::map<std::string, Budget> results;
+  for (auto& workload : MakeWorkloads()) {
+    names.push_back(workload.name);
+    auto measurement = Measure(workload.ops, workload.run);
+    results[workload.name] = {measurement.ns_per_op / reference_ns,
+                              measurement.allocs_per_op,
+                              measurement.deallocs_per_op};
+  }
+
+  if (update) {
+    WriteBaseline(path, names, results, reference_ns);
+    std::cout << "Wrote " << path << '\n';
+    return 0;
+  }
+
+  auto baseline = ReadBaseline(path);
+  if (baseline.empty()) {
+    std::cerr << "No baseline at " << path << "; run with --update\n";
+    return 1;
+  }
+
+  auto over_budget = [](double value, double budget) {
+    return value > (budget * (1 + kAllocTolerance)) + 1e-9;
+  };
+  bool regressed = false;
+  std::cout << "reference " << std::fixed << std::setprecision(3)
+            << reference_ns << " ns/op on " << HostName() << '\n';
+  std::cout << std::left << std::setw(22) << "workload" << std::right
+            << std::setw(10) << "ratio" << std::setw(10) << "base"
+            << std::setw(9) << "delta" << std::setw(11) << "allocs/op"
+            << std::setw(10) << "base" << std::setw(11) << "frees/op"
+            << std::setw(10) << "base" << "  status\n";
+  for (const auto& name : names) {
+    const auto& result = results[name];
+    auto found = baseline.find(name);
+    std::string status = "ok";
+    Budget base{NAN, NAN, NAN};
+    if (found == baseline.end()) {
+      status = "new";
+    } else {
+      base = found->second;
+      std::string what;
+      if (result.time_ratio > base.time_ratio * (1 + time_tolerance)) {
+        what += "+time";
+      }
+      if (over_budget(result.allocs_per_op, base.allocs_per_op)) {
+        what += "+allocs";
+      }
+      if (over_budget(result.deallocs_per_op, base.deallocs_per_op)) {
+        what += "+frees";
+      }
+      if (!what.empty()) {
+        regressed = true;
+        status = "REGRESSED " + what.substr(1);
+      }
+    }
+    double delta = (result.time_ratio / base.time_ratio - 1) * 100;
+    std::cout << std::left << std::setw(22) << name << std::right
+              << std::fixed << std::setprecision(3) << std::setw(10)
+              << result.time_ratio << std::setw(10) << base.time_ratio
+              << std::setprecision(1) << std::showpos << std::setw(8)
+              << delta << '%' << std::noshowpos << std::setprecision(4)
+              << std::setw(11) << result.allocs_per_op << std::setw(10)
+              << base.allocs_per_op << std::setw(11) << result.deallocs_per_op
+              << std::setw(10) << base.deallocs_per_op << "  " << status
+              << '\n';
+  }
+  return regressed ? 1 : 0;
+}
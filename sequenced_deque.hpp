@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "deque.hpp"
+
+// Deque whose elements are addressed by an absolute sequence number that
+// keeps counting across pops, as a retransmit buffer needs. Elements are
+// only added at the back and released from the front, so a sequence number
+// names the same element for as long as it is held and is never reused;
+// it serves as a stable handle. A lookup is one subtraction plus the Deque's
+// own block-index computation.
+template <typename T, typename Allocator = std::allocator<T>>
+class SequencedDeque {
+ public:
+  using value_type = T;
+  using iterator = typename Deque<T, Allocator>::iterator;
+  using const_iterator = typename Deque<T, Allocator>::const_iterator;
+
+  SequencedDeque() = default;
+
+  explicit SequencedDeque(uint64_t first_seq,
+                          const Allocator& alloc = Allocator())
+      : deque_(alloc), front_seq_(first_seq) {}
+
+  iterator begin() { return deque_.begin(); }
+  iterator end() { return deque_.end(); }
+  const_iterator begin() const { return deque_.begin(); }
+  const_iterator end() const { return deque_.end(); }
+
+  [[nodiscard]] size_t size() const { return deque_.size(); }
+  [[nodiscard]] bool empty() const { return deque_.empty(); }
+
+  // Sequence number of the oldest element held, and the one the next push
+  // will get.
+  [[nodiscard]] uint64_t front_seq() const { return front_seq_; }
+  [[nodiscard]] uint64_t next_seq() const { return front_seq_ + size(); }
+
+  // A seq below front_seq_ wraps around and fails the comparison.
+  [[nodiscard]] bool contains_seq(uint64_t seq) const {
+    return seq - front_seq_ < size();
+  }
+
+  // Each returns the sequence number of the new element.
+  template <typename... Args>
+  uint64_t emplace_back(Args&&... args) {
+    deque_.emplace_back(std::forward<Args>(args)...);
+    return next_seq() - 1;
+  }
+  uint64_t push_back(const T& value) { return emplace_back(value); }
+  uint64_t push_back(T&& value) { return emplace_back(std::move(value)); }
+
+  void pop_front();
+
+  // Releases every element with a sequence number below seq.
+  void erase_until_seq(uint64_t seq);
+
+  // Releases everything; sequence numbers continue from next_seq().
+  void clear();
+
+  T& at_seq(uint64_t seq);
+  const T& at_seq(uint64_t seq) const;
+
+  // end() if seq is not held.
+  iterator find_seq(uint64_t seq);
+  const_iterator find_seq(uint64_t seq) const;
+
+ private:
+  Deque<T, Allocator> deque_;
+  uint64_t front_seq_{0};
+};
+
+template <typename T, typename Allocator>
+void SequencedDeque<T, Allocator>::pop_front() {
+  if (empty()) {
+    return;
+  }
+  deque_.pop_front();
+  ++front_seq_;
+}
+
+template <typename T, typename Allocator>
+void SequencedDeque<T, Allocator>::erase_until_seq(uint64_t seq) {
+  if (seq <= front_seq_) {
+    return;
+  }
+  size_t count = std::min<uint64_t>(seq - front_seq_, size());
+  deque_.pop_front(count);
+  front_seq_ += count;
+}
+
+template <typename T, typename Allocator>
+void SequencedDeque<T, Allocator>::clear() {
+  front_seq_ = next_seq();
+  deque_.clear();
+}
+
+template <typename T, typename Allocator>
+T& SequencedDeque<T, Allocator>::at_seq(uint64_t seq) {
+  if (!contains_seq(seq)) {
+    throw std::out_of_range("out of range");
+  }
+  return deque_[seq - front_seq_];
+}
+
+template <typename T, typename Allocator>
+const T& SequencedDeque<T, Allocator>::at_seq(uint64_t seq) const {
+  if (!contains_seq(seq)) {
+    throw std::out_of_range("out of range");
+  }
+  return deque_[seq - front_seq_];
+}
+
+template <typename T, typename Allocator>
+typename SequencedDeque<T, Allocator>::iterator
+SequencedDeque<T, Allocator>::find_seq(uint64_t seq) {
+  if (!contains_seq(seq)) {
+    return end();
+  }
+  return begin() + (seq - front_seq_);
+}
+
+template <typename T, typename Allocator>
+typename SequencedDeque<T, Allocator>::const_iterator
+SequencedDeque<T, Allocator>::find_seq(uint64_t seq) const {
+  if (!contains_seq(seq)) {
+    return end();
+  }
+  return begin() + (seq - front_seq_);
+}
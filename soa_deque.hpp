@@ -0,0 +1,551 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <tuple>
+#include <utility>
+
+// Structure-of-arrays deque. Rows live in blocks of kBlockSize; a block is
+// one array per field, and a single map holds, for every block, the pointers
+// to its field arrays. A scan over one field only pulls that field's arrays
+// through the cache, while indexing and iteration find the block and the
+// offset inside it once for all fields.
+template <typename Allocator, typename... Fields>
+class BasicSoaDeque {
+ private:
+  template <bool IsConst>
+  class Iterator;
+
+  // One block: the array of every field.
+  using Entry = std::tuple<Fields*...>;
+
+ public:
+  using value_type = std::tuple<Fields...>;
+  using reference = std::tuple<Fields&...>;
+  using const_reference = std::tuple<const Fields&...>;
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  template <size_t I>
+  using field_type = std::tuple_element_t<I, value_type>;
+
+  // Rows per block: about 512 bytes of the widest field, a power of two.
+  static constexpr size_t kBlockSize = std::bit_floor(
+      std::max<size_t>(8, 512 / std::max({sizeof(Fields)...})));
+
+  BasicSoaDeque() = default;
+
+  BasicSoaDeque(const Allocator& alloc) : alloc_(alloc) {}
+
+  BasicSoaDeque(const BasicSoaDeque& other);
+  BasicSoaDeque(BasicSoaDeque&& other) noexcept;
+
+  ~BasicSoaDeque();
+
+  BasicSoaDeque& operator=(const BasicSoaDeque& other);
+  BasicSoaDeque& operator=(BasicSoaDeque&& other);
+
+  iterator begin() { return iterator(map_ + first_, head_); }
+  const_iterator begin() const { return const_iterator(map_ + first_, head_); }
+  const_iterator cbegin() const { return begin(); }
+
+  iterator end() { return begin() + static_cast<ptrdiff_t>(size_); }
+  const_iterator end() const {
+    return begin() + static_cast<ptrdiff_t>(size_);
+  }
+  const_iterator cend() const { return end(); }
+
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+
+  reference operator[](size_t idx) { return *(begin() + idx); }
+  const_reference operator[](size_t idx) const { return *(begin() + idx); }
+
+  template <size_t I>
+  field_type<I>& get(size_t idx) {
+    size_t pos = head_ + idx;
+    return std::get<I>(map_[first_ + (pos / kBlockSize)])[pos % kBlockSize];
+  }
+  template <size_t I>
+  const field_type<I>& get(size_t idx) const {
+    return const_cast<BasicSoaDeque*>(this)->get<I>(idx);
+  }
+
+  // The contiguous runs of field I, one per block.
+  [[nodiscard]] size_t segment_count() const { return blocks_; }
+  template <size_t I>
+  std::span<field_type<I>> segment(size_t idx);
+  template <size_t I>
+  std::span<const field_type<I>> segment(size_t idx) const {
+    return const_cast<BasicSoaDeque*>(this)->segment<I>(idx);
+  }
+  template <size_t I>
+  auto segments() {
+    return std::views::iota(size_t{0}, segment_count()) |
+           std::views::transform(
+               [this](size_t idx) { return segment<I>(idx); });
+  }
+  template <size_t I>
+  auto segments() const {
+    return std::views::iota(size_t{0}, segment_count()) |
+           std::views::transform(
+               [this](size_t idx) { return segment<I>(idx); });
+  }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args);
+
+  template <typename... Args>
+  void emplace_front(Args&&... args);
+
+  void push_back(const value_type& value);
+  void push_back(value_type&& value);
+  void push_front(const value_type& value);
+  void push_front(value_type&& value);
+
+  void pop_back();
+  void pop_front();
+
+  void clear();
+
+ private:
+  using alloc_traits = std::allocator_traits<Allocator>;
+  using map_alloc = typename alloc_traits::template rebind_alloc<Entry>;
+  using map_alloc_traits = std::allocator_traits<map_alloc>;
+  template <typename Field>
+  using field_alloc = typename alloc_traits::template rebind_alloc<Field>;
+
+  using indices = std::index_sequence_for<Fields...>;
+
+  template <typename... Args>
+  void construct_row(const Entry& entry, size_t offset, Args&&... args);
+  void destroy_row(const Entry& entry, size_t offset);
+
+  Entry allocate_block();
+  void deallocate_block(const Entry& entry);
+  void reserve_map(bool at_front);
+  void release();
+  void steal(BasicSoaDeque& other);
+
+  Entry* map_{nullptr};
+  size_t capacity_{0};
+  // Used entries are map_[first_, first_ + blocks_); the first row sits at
+  // offset head_ of the first of them.
+  size_t first_{0};
+  size_t blocks_{0};
+  size_t head_{0};
+  size_t size_{0};
+
+  [[no_unique_address]] Allocator alloc_;
+};
+
+template <typename... Fields>
+using SoaDeque = BasicSoaDeque<std::allocator<std::byte>, Fields...>;
+
+// Points at a map entry and an offset in its block; stepping moves to the
+// next entry every kBlockSize rows.
+template <typename Allocator, typename... Fields>
+template <bool IsConst>
+class BasicSoaDeque<Allocator, Fields...>::Iterator {
+ public:
+  using entry_pointer = const Entry*;
+  using value_type = std::tuple<Fields...>;
+  using reference = std::conditional_t<IsConst, const_reference,
+                                       BasicSoaDeque::reference>;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::input_iterator_tag;
+  using iterator_concept = std::random_access_iterator_tag;
+
+  Iterator() = default;
+  Iterator(entry_pointer entry, size_t offset)
+      : entry_(entry), offset_(offset) {}
+
+  reference operator*() const {
+    return std::apply(
+        [this](auto*... fields) { return reference(fields[offset_]...); },
+        *entry_);
+  }
+  reference operator[](difference_type value) const {
+    return *(*this + value);
+  }
+
+  Iterator& operator++() {
+    if (++offset_ == kBlockSize) {
+      offset_ = 0;
+      ++entry_;
+    }
+    return *this;
+  }
+  Iterator operator++(int) {
+    auto copy = *this;
+    ++*this;
+    return copy;
+  }
+  Iterator& operator--() {
+    if (offset_ == 0) {
+      offset_ = kBlockSize;
+      --entry_;
+    }
+    --offset_;
+    return *this;
+  }
+  Iterator operator--(int) {
+    auto copy = *this;
+    --*this;
+    return copy;
+  }
+
+  Iterator& operator+=(difference_type value) {
+    difference_type pos = static_cast<difference_type>(offset_) + value;
+    // kBlockSize is a power of two, so these round towards minus infinity.
+    entry_ += pos >> std::countr_zero(kBlockSize);
+    offset_ = static_cast<size_t>(pos) & (kBlockSize - 1);
+    return *this;
+  }
+  Iterator& operator-=(difference_type value) { return *this += -value; }
+  Iterator operator+(difference_type value) const {
+    auto copy = *this;
+    return copy += value;
+  }
+  friend Iterator operator+(difference_type value, const Iterator& iter) {
+    return iter + value;
+  }
+  Iterator operator-(difference_type value) const {
+    auto copy = *this;
+    return copy -= value;
+  }
+  difference_type operator-(const Iterator& other) const {
+    return ((entry_ - other.entry_) *
+            static_cast<difference_type>(kBlockSize)) +
+           static_cast<difference_type>(offset_) -
+           static_cast<difference_type>(other.offset_);
+  }
+
+  bool operator==(const Iterator& other) const {
+    return entry_ == other.entry_ && offset_ == other.offset_;
+  }
+  auto operator<=>(const Iterator& other) const {
+    if (auto order = entry_ <=> other.entry_; order != 0) {
+      return order;
+    }
+    return offset_ <=> other.offset_;
+  }
+
+  operator Iterator<true>() const { return Iterator<true>(entry_, offset_); }
+
+ private:
+  entry_pointer entry_{nullptr};
+  size_t offset_{0};
+};
+
+template <typename Allocator, typename... Fields>
+BasicSoaDeque<Allocator, Fields...>::BasicSoaDeque(const BasicSoaDeque& other)
+    : alloc_(alloc_traits::select_on_container_copy_construction(
+          other.alloc_)) {
+  try {
+    for (auto row : other) {
+      std::apply([this](const auto&... fields) { emplace_back(fields...); },
+                 row);
+    }
+  } catch (...) {
+    release();
+    throw;
+  }
+}
+
+template <typename Allocator, typename... Fields>
+BasicSoaDeque<Allocator, Fields...>::BasicSoaDeque(
+    BasicSoaDeque&& other) noexcept
+    : alloc_(std::move(other.alloc_)) {
+  steal(other);
+}
+
+template <typename Allocator, typename... Fields>
+BasicSoaDeque<Allocator, Fields...>::~BasicSoaDeque() {
+  release();
+}
+
+template <typename Allocator, typename... Fields>
+BasicSoaDeque<Allocator, Fields...>&
+BasicSoaDeque<Allocator, Fields...>::operator=(const BasicSoaDeque& other) {
+  if (&other == this) {
+    return *this;
+  }
+  BasicSoaDeque copy(
+      alloc_traits::propagate_on_container_copy_assignment::value
+          ? other.alloc_
+          : alloc_);
+  for (auto row : other) {
+    std::apply([&copy](const auto&... fields) { copy.emplace_back(fields...); },
+               row);
+  }
+  release();
+  alloc_ = copy.alloc_;
+  steal(copy);
+  return *this;
+}
+
+template <typename Allocator, typename... Fields>
+BasicSoaDeque<Allocator, Fields...>&
+BasicSoaDeque<Allocator, Fields...>::operator=(BasicSoaDeque&& other) {
+  if (&other == this) {
+    return *this;
+  }
+  if (alloc_traits::propagate_on_container_move_assignment::value ||
+      alloc_ == other.alloc_) {
+    release();
+    if (alloc_traits::propagate_on_container_move_assignment::value) {
+      alloc_ = std::move(other.alloc_);
+    }
+    steal(other);
+    return *this;
+  }
+  BasicSoaDeque moved(alloc_);
+  for (auto row : other) {
+    std::apply(
+        [&moved](auto&... fields) { moved.emplace_back(std::move(fields)...); },
+        row);
+  }
+  release();
+  steal(moved);
+  other.clear();
+  return *this;
+}
+
+template <typename Allocator, typename... Fields>
+template <size_t I>
+std::span<typename BasicSoaDeque<Allocator, Fields...>::template field_type<I>>
+BasicSoaDeque<Allocator, Fields...>::segment(size_t idx) {
+  size_t from = (idx == 0) ? head_ : 0;
+  size_t to = std::min(kBlockSize, head_ + size_ - (idx * kBlockSize));
+  return {std::get<I>(map_[first_ + idx]) + from, to - from};
+}
+
+template <typename Allocator, typename... Fields>
+template <typename... Args>
+void BasicSoaDeque<Allocator, Fields...>::emplace_back(Args&&... args) {
+  static_assert(sizeof...(Args) == sizeof...(Fields));
+  size_t pos = head_ + size_;
+  bool new_block = pos == blocks_ * kBlockSize;
+  if (new_block) {
+    reserve_map(false);
+    map_[first_ + blocks_] = allocate_block();
+    ++blocks_;
+  }
+  try {
+    construct_row(map_[first_ + (pos / kBlockSize)], pos % kBlockSize,
+                  std::forward<Args>(args)...);
+  } catch (...) {
+    if (new_block) {
+      --blocks_;
+      deallocate_block(map_[first_ + blocks_]);
+    }
+    throw;
+  }
+  ++size_;
+}
+
+template <typename Allocator, typename... Fields>
+template <typename... Args>
+void BasicSoaDeque<Allocator, Fields...>::emplace_front(Args&&... args) {
+  static_assert(sizeof...(Args) == sizeof...(Fields));
+  bool new_block = head_ == 0;
+  if (new_block) {
+    reserve_map(true);
+    map_[first_ - 1] = allocate_block();
+    --first_;
+    ++blocks_;
+    head_ = kBlockSize;
+  }
+  try {
+    construct_row(map_[first_], head_ - 1, std::forward<Args>(args)...);
+  } catch (...) {
+    if (new_block) {
+      deallocate_block(map_[first_]);
+      ++first_;
+      --blocks_;
+      head_ = 0;
+    }
+    throw;
+  }
+  --head_;
+  ++size_;
+}
+
+template <typename Allocator, typename... Fields>
+void BasicSoaDeque<Allocator, Fields...>::push_back(const value_type& value) {
+  std::apply([this](const auto&... fields) { emplace_back(fields...); },
+             value);
+}
+
+template <typename Allocator, typename... Fields>
+void BasicSoaDeque<Allocator, Fields...>::push_back(value_type&& value) {
+  std::apply(
+      [this](auto&&... fields) {
+        emplace_back(std::forward<decltype(fields)>(fields)...);
+      },
+      std::move(value));
+}
+
+template <typename Allocator, typename... Fields>
+void BasicSoaDeque<Allocator, Fields...>::push_front(const value_type& value) {
+  std::apply([this](const auto&... fields) { emplace_front(fields...); },
+             value);
+}
+
+template <typename Allocator, typename... Fields>
+void BasicSoaDeque<Allocator, Fields...>::push_front(value_type&& value) {
+  std::apply(
+      [this](auto&&... fields) {
+        emplace_front(std::forward<decltype(fields)>(fields)...);
+      },
+      std::move(value));
+}
+
+template <typename Allocator, typename... Fields>
+void BasicSoaDeque<Allocator, Fields...>::pop_back() {
+  if (size_ == 0) {
+    return;
+  }
+  --size_;
+  size_t pos = head_ + size_;
+  destroy_row(map_[first_ + (pos / kBlockSize)], pos % kBlockSize);
+  if (pos % kBlockSize == 0 || size_ == 0) {
+    --blocks_;
+    deallocate_block(map_[first_ + blocks_]);
+  }
+  if (size_ == 0) {
+    head_ = 0;
+  }
+}
+
+template <typename Allocator, typename... Fields>
+void BasicSoaDeque<Allocator, Fields...>::pop_front() {
+  if (size_ == 0) {
+    return;
+  }
+  destroy_row(map_[first_], head_);
+  ++head_;
+  --size_;
+  if (head_ == kBlockSize || size_ == 0) {
+    deallocate_block(map_[first_]);
+    ++first_;
+    --blocks_;
+    head_ = 0;
+  }
+}
+
+template <typename Allocator, typename... Fields>
+void BasicSoaDeque<Allocator, Fields...>::clear() {
+  while (size_ != 0) {
+    pop_back();
+  }
+}
+
+// Constructs every field of one row, destroying the fields already built if
+// a later one throws.
+template <typename Allocator, typename... Fields>
+template <typename... Args>
+void BasicSoaDeque<Allocator, Fields...>::construct_row(const Entry& entry,
+                                                        size_t offset,
+                                                        Args&&... args) {
+  size_t built = 0;
+  [&]<size_t... Is>(std::index_sequence<Is...> /*unused*/) {
+    try {
+      ((std::construct_at(std::get<Is>(entry) + offset,
+                          std::forward<Args>(args)),
+        ++built),
+       ...);
+    } catch (...) {
+      ((Is < built ? std::destroy_at(std::get<Is>(entry) + offset) : void()),
+       ...);
+      throw;
+    }
+  }(indices{});
+}
+
+template <typename Allocator, typename... Fields>
+void BasicSoaDeque<Allocator, Fields...>::destroy_row(const Entry& entry,
+                                                      size_t offset) {
+  std::apply(
+      [offset](auto*... fields) { (std::destroy_at(fields + offset), ...); },
+      entry);
+}
+
+template <typename Allocator, typename... Fields>
+typename BasicSoaDeque<Allocator, Fields...>::Entry
+BasicSoaDeque<Allocator, Fields...>::allocate_block() {
+  Entry entry{};
+  size_t allocated = 0;
+  [&]<size_t... Is>(std::index_sequence<Is...> /*unused*/) {
+    try {
+      ((std::get<Is>(entry) =
+            field_alloc<Fields>(alloc_).allocate(kBlockSize),
+        ++allocated),
+       ...);
+    } catch (...) {
+      ((Is < allocated ? field_alloc<Fields>(alloc_).deallocate(
+                             std::get<Is>(entry), kBlockSize)
+                       : void()),
+       ...);
+      throw;
+    }
+  }(indices{});
+  return entry;
+}
+
+template <typename Allocator, typename... Fields>
+void BasicSoaDeque<Allocator, Fields...>::deallocate_block(
+    const Entry& entry) {
+  [&]<size_t... Is>(std::index_sequence<Is...> /*unused*/) {
+    (field_alloc<Fields>(alloc_).deallocate(std::get<Is>(entry), kBlockSize),
+     ...);
+  }(indices{});
+}
+
+// Makes room for one more entry at the requested end. A new map has at least
+// as many free entries as used ones, split between the two ends, so pushes
+// at either end reallocate it only O(1) times per block on average.
+template <typename Allocator, typename... Fields>
+void BasicSoaDeque<Allocator, Fields...>::reserve_map(bool at_front) {
+  if (at_front ? first_ > 0 : first_ + blocks_ < capacity_) {
+    return;
+  }
+  size_t capacity = std::max<size_t>(8, 2 * (blocks_ + 1));
+  map_alloc alloc(alloc_);
+  Entry* map = map_alloc_traits::allocate(alloc, capacity);
+  size_t first = (capacity - blocks_) / 2;
+  std::uninitialized_copy(map_ + first_, map_ + first_ + blocks_, map + first);
+  if (map_ != nullptr) {
+    map_alloc_traits::deallocate(alloc, map_, capacity_);
+  }
+  map_ = map;
+  capacity_ = capacity;
+  first_ = first;
+}
+
+template <typename Allocator, typename... Fields>
+void BasicSoaDeque<Allocator, Fields...>::release() {
+  clear();
+  if (map_ != nullptr) {
+    map_alloc alloc(alloc_);
+    map_alloc_traits::deallocate(alloc, map_, capacity_);
+  }
+  map_ = nullptr;
+  capacity_ = 0;
+  first_ = 0;
+}
+
+template <typename Allocator, typename... Fields>
+void BasicSoaDeque<Allocator, Fields...>::steal(BasicSoaDeque& other) {
+  map_ = std::exchange(other.map_, nullptr);
+  capacity_ = std::exchange(other.capacity_, 0);
+  first_ = std::exchange(other.first_, 0);
+  blocks_ = std::exchange(other.blocks_, 0);
+  head_ = std::exchange(other.head_, 0);
+  size_ = std::exchange(other.size_, 0);
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <ranges>
+
+#include "deque.hpp"
+
+// Deque for mostly ordered streams. It tracks the longest sorted suffix, so
+// appending in order keeps the whole deque searchable with a binary search
+// over Deque's random-access iterators. Elements are read-only from outside;
+// writing through them would invalidate the tracked order.
+template <typename T, typename Compare = std::less<>,
+          typename Allocator = std::allocator<T>>
+class SortedDeque {
+ public:
+  using value_type = T;
+  using const_iterator = typename Deque<T, Allocator>::const_iterator;
+
+  SortedDeque() = default;
+
+  explicit SortedDeque(Compare comp, const Allocator& alloc = Allocator())
+      : deque_(alloc), comp_(std::move(comp)) {}
+
+  const_iterator begin() const { return deque_.begin(); }
+  const_iterator end() const { return deque_.end(); }
+
+  [[nodiscard]] size_t size() const { return deque_.size(); }
+  [[nodiscard]] bool empty() const { return deque_.empty(); }
+
+  const T& operator[](size_t idx) const { return deque_[idx]; }
+
+  [[nodiscard]] const Deque<T, Allocator>& deque() const { return deque_; }
+
+  [[nodiscard]] size_t sorted_suffix() const { return sorted_; }
+  [[nodiscard]] bool is_sorted() const { return sorted_ == deque_.size(); }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args);
+
+  void push_back(const T& value) { emplace_back(value); }
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+  void push_front(const T& value);
+  void push_front(T&& value);
+
+  void pop_back();
+  void pop_front();
+
+  void clear();
+
+  // Stable-sorts the unsorted prefix and merges it into the sorted suffix.
+  void sort();
+
+  // Searches the sorted suffix, which is the whole deque once is_sorted().
+  template <typename Key>
+  const_iterator lower_bound(const Key& key) const;
+  template <typename Key>
+  const_iterator upper_bound(const Key& key) const;
+
+  // Elements in [from, to).
+  template <typename Key>
+  std::ranges::subrange<const_iterator> range(const Key& from,
+                                              const Key& to) const {
+    return {lower_bound(from), lower_bound(to)};
+  }
+
+  // Merges a second sorted run in, sorting either side first if needed.
+  // Blocks outside the overlapping key range change owner without being
+  // touched; only the overlap is merged element by element. Equal elements
+  // of this deque come first.
+  void merge_sorted(SortedDeque&& other);
+
+ private:
+  template <typename Pred>
+  const_iterator partition_point(Pred pred) const;
+  void rescan_suffix();
+
+  Deque<T, Allocator> deque_;
+  size_t sorted_{0};
+
+  [[no_unique_address]] Compare comp_;
+};
+
+template <typename T, typename Compare, typename Allocator>
+template <typename... Args>
+void SortedDeque<T, Compare, Allocator>::emplace_back(Args&&... args) {
+  deque_.emplace_back(std::forward<Args>(args)...);
+  if (sorted_ == 0 || !comp_(*(deque_.end() - 1), *(deque_.end() - 2))) {
+    ++sorted_;
+  } else {
+    sorted_ = 1;
+  }
+}
+
+template <typename T, typename Compare, typename Allocator>
+void SortedDeque<T, Compare, Allocator>::push_front(const T& value) {
+  bool extends = is_sorted() && (empty() || !comp_(*deque_.begin(), value));
+  deque_.push_front(value);
+  if (extends) {
+    ++sorted_;
+  }
+}
+
+template <typename T, typename Compare, typename Allocator>
+void SortedDeque<T, Compare, Allocator>::push_front(T&& value) {
+  bool extends = is_sorted() && (empty() || !comp_(*deque_.begin(), value));
+  deque_.push_front(std::move(value));
+  if (extends) {
+    ++sorted_;
+  }
+}
+
+template <typename T, typename Compare, typename Allocator>
+void SortedDeque<T, Compare, Allocator>::pop_back() {
+  if (empty()) {
+    return;
+  }
+  deque_.pop_back();
+  --sorted_;
+  if (sorted_ == 0) {
+    rescan_suffix();
+  }
+}
+
+template <typename T, typename Compare, typename Allocator>
+void SortedDeque<T, Compare, Allocator>::pop_front() {
+  if (empty()) {
+    return;
+  }
+  deque_.pop_front();
+  sorted_ = std::min(sorted_, deque_.size());
+}
+
+template <typename T, typename Compare, typename Allocator>
+void SortedDeque<T, Compare, Allocator>::clear() {
+  deque_.clear();
+  sorted_ = 0;
+}
+
+template <typename T, typename Compare, typename Allocator>
+void SortedDeque<T, Compare, Allocator>::sort() {
+  if (is_sorted()) {
+    return;
+  }
+  auto middle = deque_.begin() + (deque_.size() - sorted_);
+  std::stable_sort(deque_.begin(), middle, comp_);
+  std::inplace_merge(deque_.begin(), middle, deque_.end(), comp_);
+  sorted_ = deque_.size();
+}
+
+template <typename T, typename Compare, typename Allocator>
+template <typename Key>
+typename SortedDeque<T, Compare, Allocator>::const_iterator
+SortedDeque<T, Compare, Allocator>::lower_bound(const Key& key) const {
+  return partition_point([&](const T& value) { return comp_(value, key); });
+}
+
+template <typename T, typename Compare, typename Allocator>
+template <typename Key>
+typename SortedDeque<T, Compare, Allocator>::const_iterator
+SortedDeque<T, Compare, Allocator>::upper_bound(const Key& key) const {
+  return partition_point([&](const T& value) { return !comp_(key, value); });
+}
+
+template <typename T, typename Compare, typename Allocator>
+void SortedDeque<T, Compare, Allocator>::merge_sorted(SortedDeque&& other) {
+  if (&other == this) {
+    return;
+  }
+  sort();
+  if (other.empty()) {
+    return;
+  }
+  other.sort();
+  size_t total = size() + other.size();
+  if (empty() || !comp_(*other.deque_.begin(), *(deque_.end() - 1))) {
+    deque_.append_deque(std::move(other.deque_));
+  } else if (comp_(*(other.deque_.end() - 1), *deque_.begin())) {
+    deque_.prepend_deque(std::move(other.deque_));
+  } else {
+    // [begin, lower) of this and [upper, end) of other are already in
+    // place; only the rest is interleaved.
+    size_t lower = upper_bound(*other.deque_.begin()) - begin();
+    size_t upper = other.lower_bound(*(deque_.end() - 1)) - other.begin();
+    Deque<T, Allocator> mine = deque_.split_at(deque_.begin() + lower);
+    Deque<T, Allocator> tail =
+        other.deque_.split_at(other.deque_.begin() + upper);
+    Deque<T, Allocator> merged(deque_.get_allocator());
+    auto lhs = mine.begin();
+    auto rhs = other.deque_.begin();
+    while (lhs != mine.end() && rhs != other.deque_.end()) {
+      if (comp_(*rhs, *lhs)) {
+        merged.emplace_back(std::move(*rhs));
+        ++rhs;
+      } else {
+        merged.emplace_back(std::move(*lhs));
+        ++lhs;
+      }
+    }
+    for (; lhs != mine.end(); ++lhs) {
+      merged.emplace_back(std::move(*lhs));
+    }
+    for (; rhs != other.deque_.end(); ++rhs) {
+      merged.emplace_back(std::move(*rhs));
+    }
+    deque_.append_deque(std::move(merged));
+    deque_.append_deque(std::move(tail));
+    other.deque_.clear();
+  }
+  sorted_ = total;
+  other.sorted_ = 0;
+}
+
+template <typename T, typename Compare, typename Allocator>
+template <typename Pred>
+typename SortedDeque<T, Compare, Allocator>::const_iterator
+SortedDeque<T, Compare, Allocator>::partition_point(Pred pred) const {
+  return std::partition_point(begin() + (deque_.size() - sorted_), end(),
+                              pred);
+}
+
+template <typename T, typename Compare, typename Allocator>
+void SortedDeque<T, Compare, Allocator>::rescan_suffix() {
+  if (empty()) {
+    return;
+  }
+  sorted_ = 1;
+  auto iter = deque_.end() - 1;
+  while (iter != deque_.begin() && !comp_(*iter, *(iter - 1))) {
+    --iter;
+    ++sorted_;
+  }
+}
@@ -0,0 +1,464 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "deque.hpp"
+
+// Deque for backlogs that can outgrow RAM. The front and back stay resident
+// in two Deques. Everything between them is cut into fixed-size chunks, and
+// once more chunks are resident than the memory budget allows, the newest
+// ones are written to an unlinked temp file. A helper thread does all file
+// I/O, and the chunks next in line for pop_front() are read back ahead of
+// time. Chunks never change once cut, so one that was read back and has to
+// go again is simply dropped. Built for FIFO use: pop_back() works, but
+// waits for a spilled back chunk to be read.
+//
+// The budget covers the chunks; the two edge Deques add up to four chunks'
+// worth on top. An I/O error on a write keeps the chunk resident and is
+// rethrown by the next push that cuts a chunk. A failed read marks the chunk
+// failed, and every call that needs it rethrows the read error.
+template <typename T>
+class SpillingDeque {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "elements are spilled as raw bytes");
+
+ public:
+  static constexpr size_t kChunkSize =
+      std::max<size_t>(1, (size_t{1} << 20) / sizeof(T));
+  static constexpr size_t kChunkBytes = kChunkSize * sizeof(T);
+  // Chunks at the front that are never spilled and are read back early.
+  static constexpr size_t kReadAhead = 4;
+
+  explicit SpillingDeque(size_t memory_budget,
+                         const std::filesystem::path& dir =
+                             std::filesystem::temp_directory_path());
+
+  SpillingDeque(const SpillingDeque&) = delete;
+  SpillingDeque& operator=(const SpillingDeque&) = delete;
+
+  ~SpillingDeque();
+
+  [[nodiscard]] size_t size() const {
+    return head_.size() + (chunks_.size() * kChunkSize) + tail_.size();
+  }
+  [[nodiscard]] bool empty() const { return size() == 0; }
+
+  [[nodiscard]] size_t resident_bytes();
+  [[nodiscard]] size_t spilled_bytes();
+
+  void push_back(const T& value);
+  void push_front(const T& value);
+
+  // Both require !empty().
+  const T& front();
+  const T& back();
+
+  void pop_front();
+  void pop_back();
+
+ private:
+  enum class State { kResident, kWriting, kOnDisk, kReading, kFailed };
+
+  struct Chunk {
+    std::unique_ptr<T[]> data;
+    size_t slot{kNoSlot};
+    State state{State::kResident};
+    // Set while a write is in flight if the chunk is needed again, so the
+    // write leaves the data resident.
+    bool keep{false};
+    // The read error once the chunk is kFailed.
+    std::exception_ptr error;
+  };
+
+  struct Job {
+    Chunk* chunk;
+    bool write;
+  };
+
+  static constexpr size_t kNoSlot = SIZE_MAX;
+
+  static void CopyOut(const Deque<T>& edge, size_t first, size_t count,
+                      T* dest);
+  static bool WriteAll(int fd, const char* data, size_t bytes, off_t offset);
+  static bool ReadAll(int fd, char* data, size_t bytes, off_t offset);
+
+  void cut_tail();
+  void cut_head();
+  void load_front();
+  void load_back();
+  void acquire(Chunk& chunk, std::unique_lock<std::mutex>& lock);
+  void release(std::unique_ptr<Chunk> chunk);
+  void spill();
+  void read_ahead();
+  void run_io();
+
+  Deque<T> head_;
+  Deque<std::unique_ptr<Chunk>> chunks_;
+  Deque<T> tail_;
+  size_t max_resident_;
+
+  int fd_{-1};
+
+  // Everything below is shared with the I/O thread.
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  Deque<Job> jobs_;
+  // Chunks whose data is, or will be, in memory.
+  size_t resident_{0};
+  std::vector<size_t> free_slots_;
+  size_t slots_{0};
+  // The last failed write, for the next cut to rethrow.
+  std::exception_ptr write_error_;
+  bool stop_{false};
+  std::thread io_;
+};
+
+template <typename T>
+SpillingDeque<T>::SpillingDeque(size_t memory_budget,
+                                const std::filesystem::path& dir)
+    : max_resident_(memory_budget / kChunkBytes) {
+  std::string path = (dir / "spilling_deque.XXXXXX").string();
+  fd_ = ::mkstemp(path.data());
+  if (fd_ < 0) {
+    throw std::system_error(errno, std::generic_category(), "mkstemp");
+  }
+  ::unlink(path.c_str());
+  try {
+    io_ = std::thread(&SpillingDeque::run_io, this);
+  } catch (...) {
+    ::close(fd_);
+    throw;
+  }
+}
+
+template <typename T>
+SpillingDeque<T>::~SpillingDeque() {
+  {
+    std::lock_guard lock(mutex_);
+    jobs_.clear();
+    stop_ = true;
+  }
+  work_cv_.notify_one();
+  io_.join();
+  ::close(fd_);
+}
+
+template <typename T>
+size_t SpillingDeque<T>::resident_bytes() {
+  std::lock_guard lock(mutex_);
+  return ((head_.size() + tail_.size()) * sizeof(T)) +
+         (resident_ * kChunkBytes);
+}
+
+template <typename T>
+size_t SpillingDeque<T>::spilled_bytes() {
+  std::lock_guard lock(mutex_);
+  return (chunks_.size() - resident_) * kChunkBytes;
+}
+
+template <typename T>
+void SpillingDeque<T>::push_back(const T& value) {
+  tail_.push_back(value);
+  if (tail_.size() >= 2 * kChunkSize) {
+    cut_tail();
+  }
+}
+
+template <typename T>
+void SpillingDeque<T>::push_front(const T& value) {
+  head_.push_front(value);
+  if (head_.size() >= 2 * kChunkSize) {
+    cut_head();
+  }
+}
+
+template <typename T>
+const T& SpillingDeque<T>::front() {
+  if (head_.empty() && !chunks_.empty()) {
+    load_front();
+  }
+  return head_.empty() ? *tail_.begin() : *head_.begin();
+}
+
+template <typename T>
+const T& SpillingDeque<T>::back() {
+  if (tail_.empty() && !chunks_.empty()) {
+    load_back();
+  }
+  return tail_.empty() ? *(head_.end() - 1) : *(tail_.end() - 1);
+}
+
+template <typename T>
+void SpillingDeque<T>::pop_front() {
+  if (head_.empty() && !chunks_.empty()) {
+    load_front();
+  }
+  if (head_.empty()) {
+    tail_.pop_front();
+  } else {
+    head_.pop_front();
+  }
+}
+
+template <typename T>
+void SpillingDeque<T>::pop_back() {
+  if (tail_.empty() && !chunks_.empty()) {
+    load_back();
+  }
+  if (tail_.empty()) {
+    head_.pop_back();
+  } else {
+    tail_.pop_back();
+  }
+}
+
+// Copies count elements starting at index first, a segment at a time.
+template <typename T>
+void SpillingDeque<T>::CopyOut(const Deque<T>& edge, size_t first,
+                               size_t count, T* dest) {
+  for (size_t seg = edge.segment_index(first); count > 0; ++seg) {
+    auto span = edge.segment(seg);
+    size_t offset = edge.segment_offset(seg);
+    size_t from = (first > offset) ? first - offset : 0;
+    size_t step = std::min(count, span.size() - from);
+    std::copy_n(span.data() + from, step, dest);
+    dest += step;
+    count -= step;
+  }
+}
+
+template <typename T>
+bool SpillingDeque<T>::WriteAll(int fd, const char* data, size_t bytes,
+                                off_t offset) {
+  while (bytes > 0) {
+    ssize_t done = ::pwrite(fd, data, bytes, offset);
+    if (done < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += done;
+    bytes -= done;
+    offset += done;
+  }
+  return true;
+}
+
+template <typename T>
+bool SpillingDeque<T>::ReadAll(int fd, char* data, size_t bytes,
+                               off_t offset) {
+  while (bytes > 0) {
+    ssize_t done = ::pread(fd, data, bytes, offset);
+    if (done < 0 && errno == EINTR) {
+      continue;
+    }
+    if (done <= 0) {
+      // A short file is an I/O error too, not a silent success.
+      if (done == 0) {
+        errno = EIO;
+      }
+      return false;
+    }
+    data += done;
+    bytes -= done;
+    offset += done;
+  }
+  return true;
+}
+
+template <typename T>
+void SpillingDeque<T>::cut_tail() {
+  auto chunk = std::make_unique<Chunk>();
+  chunk->data = std::make_unique_for_overwrite<T[]>(kChunkSize);
+  CopyOut(tail_, 0, kChunkSize, chunk->data.get());
+  tail_.pop_front(kChunkSize);
+  std::unique_lock lock(mutex_);
+  chunks_.push_back(std::move(chunk));
+  ++resident_;
+  spill();
+  if (write_error_) {
+    std::rethrow_exception(std::exchange(write_error_, nullptr));
+  }
+}
+
+template <typename T>
+void SpillingDeque<T>::cut_head() {
+  auto chunk = std::make_unique<Chunk>();
+  chunk->data = std::make_unique_for_overwrite<T[]>(kChunkSize);
+  CopyOut(head_, head_.size() - kChunkSize, kChunkSize, chunk->data.get());
+  head_.resize(head_.size() - kChunkSize);
+  std::unique_lock lock(mutex_);
+  chunks_.push_front(std::move(chunk));
+  ++resident_;
+  spill();
+  if (write_error_) {
+    std::rethrow_exception(std::exchange(write_error_, nullptr));
+  }
+}
+
+template <typename T>
+void SpillingDeque<T>::load_front() {
+  std::unique_lock lock(mutex_);
+  Chunk& chunk = **chunks_.begin();
+  acquire(chunk, lock);
+  head_.assign(chunk.data.get(), chunk.data.get() + kChunkSize);
+  auto owned = std::move(*chunks_.begin());
+  chunks_.pop_front();
+  release(std::move(owned));
+  read_ahead();
+  spill();
+}
+
+template <typename T>
+void SpillingDeque<T>::load_back() {
+  std::unique_lock lock(mutex_);
+  Chunk& chunk = **(chunks_.end() - 1);
+  acquire(chunk, lock);
+  tail_.assign(chunk.data.get(), chunk.data.get() + kChunkSize);
+  auto owned = std::move(*(chunks_.end() - 1));
+  chunks_.pop_back();
+  release(std::move(owned));
+}
+
+// Waits until the chunk's data is in memory, reading it first if needed.
+template <typename T>
+void SpillingDeque<T>::acquire(Chunk& chunk,
+                               std::unique_lock<std::mutex>& lock) {
+  if (chunk.state == State::kWriting && !chunk.keep) {
+    chunk.keep = true;
+    ++resident_;
+  } else if (chunk.state == State::kOnDisk) {
+    chunk.state = State::kReading;
+    ++resident_;
+    jobs_.push_front(Job{&chunk, false});
+    work_cv_.notify_one();
+  }
+  done_cv_.wait(lock, [&chunk] {
+    return chunk.state == State::kResident || chunk.state == State::kFailed;
+  });
+  if (chunk.state == State::kFailed) {
+    std::rethrow_exception(chunk.error);
+  }
+}
+
+template <typename T>
+void SpillingDeque<T>::release(std::unique_ptr<Chunk> chunk) {
+  --resident_;
+  if (chunk->slot != kNoSlot) {
+    free_slots_.push_back(chunk->slot);
+  }
+}
+
+// Spills the newest resident chunks outside the read-ahead window until the
+// budget holds or nothing is left to spill.
+template <typename T>
+void SpillingDeque<T>::spill() {
+  size_t idx = chunks_.size();
+  while (resident_ > max_resident_ && idx > kReadAhead) {
+    Chunk& chunk = *chunks_[--idx];
+    if (chunk.state != State::kResident) {
+      continue;
+    }
+    --resident_;
+    if (chunk.slot != kNoSlot) {
+      chunk.data.reset();
+      chunk.state = State::kOnDisk;
+      continue;
+    }
+    if (free_slots_.empty()) {
+      chunk.slot = slots_++;
+    } else {
+      chunk.slot = free_slots_.back();
+      free_slots_.pop_back();
+    }
+    chunk.state = State::kWriting;
+    jobs_.push_back(Job{&chunk, true});
+    work_cv_.notify_one();
+  }
+}
+
+template <typename T>
+void SpillingDeque<T>::read_ahead() {
+  for (size_t idx = std::min(kReadAhead, chunks_.size()); idx > 0; --idx) {
+    Chunk& chunk = *chunks_[idx - 1];
+    if (chunk.state == State::kOnDisk) {
+      chunk.state = State::kReading;
+      ++resident_;
+      jobs_.push_front(Job{&chunk, false});
+      work_cv_.notify_one();
+    }
+  }
+}
+
+template <typename T>
+void SpillingDeque<T>::run_io() {
+  std::unique_lock lock(mutex_);
+  while (true) {
+    work_cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+    if (stop_) {
+      return;
+    }
+    Job job = *jobs_.begin();
+    jobs_.pop_front();
+    Chunk& chunk = *job.chunk;
+    auto offset = static_cast<off_t>(chunk.slot * kChunkBytes);
+    if (job.write) {
+      const auto* bytes = reinterpret_cast<const char*>(chunk.data.get());
+      lock.unlock();
+      bool written = WriteAll(fd_, bytes, kChunkBytes, offset);
+      int code = errno;
+      lock.lock();
+      if (!written) {
+        write_error_ = std::make_exception_ptr(
+            std::system_error(code, std::generic_category(), "pwrite"));
+        free_slots_.push_back(chunk.slot);
+        chunk.slot = kNoSlot;
+        chunk.state = State::kResident;
+        if (!chunk.keep) {
+          ++resident_;
+        }
+      } else if (chunk.keep) {
+        chunk.state = State::kResident;
+      } else {
+        chunk.data.reset();
+        chunk.state = State::kOnDisk;
+      }
+      chunk.keep = false;
+    } else {
+      lock.unlock();
+      auto data = std::make_unique_for_overwrite<T[]>(kChunkSize);
+      bool read = ReadAll(fd_, reinterpret_cast<char*>(data.get()),
+                          kChunkBytes, offset);
+      int code = errno;
+      lock.lock();
+      if (read) {
+        chunk.data = std::move(data);
+        chunk.state = State::kResident;
+      } else {
+        chunk.error = std::make_exception_ptr(
+            std::system_error(code, std::generic_category(), "pread"));
+        chunk.state = State::kFailed;
+        --resident_;
+      }
+    }
+    done_cv_.notify_all();
+  }
+}
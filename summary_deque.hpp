@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <utility>
+
+#include "deque.hpp"
+#include "monoids.hpp"
+
+// Deque that keeps one monoid summary per block (see monoids.hpp), so range
+// queries can skip every block whose summary rules out a match, as zone maps
+// do for table scans. Pushes fold the new element into the edge summary.
+// Pops only mark the edge block stale, because min and max cannot be undone;
+// it is recomputed the next time a summary is read. insert() and erase()
+// recompute the blocks they shift, from the touched one to the back.
+template <typename T, typename Monoid, typename Allocator = std::allocator<T>>
+class SummaryDeque {
+ public:
+  using value_type = T;
+  using summary_type = typename Monoid::value_type;
+  using const_iterator = typename Deque<T, Allocator>::const_iterator;
+
+  SummaryDeque() = default;
+
+  explicit SummaryDeque(Monoid monoid, const Allocator& alloc = Allocator())
+      : deque_(alloc), summaries_(summary_alloc(alloc)),
+        monoid_(std::move(monoid)) {}
+
+  const_iterator begin() const { return deque_.begin(); }
+  const_iterator end() const { return deque_.end(); }
+
+  [[nodiscard]] size_t size() const { return deque_.size(); }
+  [[nodiscard]] bool empty() const { return deque_.empty(); }
+
+  const T& operator[](size_t idx) const { return deque_[idx]; }
+
+  [[nodiscard]] const Deque<T, Allocator>& deque() const { return deque_; }
+  [[nodiscard]] const Monoid& monoid() const { return monoid_; }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args);
+
+  template <typename... Args>
+  void emplace_front(Args&&... args);
+
+  void push_back(const T& value) { emplace_back(value); }
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+  void push_front(const T& value) { emplace_front(value); }
+  void push_front(T&& value) { emplace_front(std::move(value)); }
+
+  void pop_back();
+  void pop_front();
+
+  void clear();
+
+  void insert(const_iterator pos, const T& value);
+  void erase(const_iterator pos);
+
+  // Replaces one element and recomputes its block.
+  void assign(size_t idx, T value);
+
+  // Number of blocks, and the summary of block idx.
+  [[nodiscard]] size_t block_count() const { return deque_.segment_count(); }
+  const summary_type& block_summary(size_t idx) const;
+
+  // Fold of [first, last), using block summaries for whole blocks.
+  summary_type reduce(size_t first, size_t last) const;
+
+  // Calls func on every element of [first, last) satisfying pred, skipping
+  // blocks for which may_match(block summary) is false. Returns the number
+  // of matches.
+  template <typename BlockPred, typename Pred, typename Func>
+  size_t query(size_t first, size_t last, BlockPred may_match, Pred pred,
+               Func func) const;
+
+ private:
+  using summary_alloc = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<summary_type>;
+
+  summary_type fold(std::span<const T> span) const;
+  void sync() const;
+  void refresh_from(size_t block);
+
+  Deque<T, Allocator> deque_;
+  mutable Deque<summary_type, summary_alloc> summaries_;
+  mutable bool front_stale_{false};
+  mutable bool back_stale_{false};
+
+  [[no_unique_address]] Monoid monoid_;
+};
+
+template <typename T, typename Monoid, typename Allocator>
+template <typename... Args>
+void SummaryDeque<T, Monoid, Allocator>::emplace_back(Args&&... args) {
+  size_t blocks = deque_.segment_count();
+  deque_.emplace_back(std::forward<Args>(args)...);
+  auto lifted = monoid_.lift(*(deque_.end() - 1));
+  if (deque_.segment_count() == blocks) {
+    summaries_[blocks - 1] = monoid_.combine(summaries_[blocks - 1], lifted);
+    return;
+  }
+  if (back_stale_) {
+    summaries_[blocks - 1] = fold(deque_.segment(blocks - 1));
+    back_stale_ = false;
+  }
+  summaries_.push_back(std::move(lifted));
+}
+
+template <typename T, typename Monoid, typename Allocator>
+template <typename... Args>
+void SummaryDeque<T, Monoid, Allocator>::emplace_front(Args&&... args) {
+  size_t blocks = deque_.segment_count();
+  deque_.emplace_front(std::forward<Args>(args)...);
+  auto lifted = monoid_.lift(*deque_.begin());
+  if (deque_.segment_count() == blocks) {
+    summaries_[0] = monoid_.combine(lifted, summaries_[0]);
+    return;
+  }
+  if (front_stale_) {
+    summaries_[0] = fold(deque_.segment(1));
+    front_stale_ = false;
+  }
+  summaries_.push_front(std::move(lifted));
+}
+
+template <typename T, typename Monoid, typename Allocator>
+void SummaryDeque<T, Monoid, Allocator>::pop_back() {
+  if (empty()) {
+    return;
+  }
+  size_t blocks = deque_.segment_count();
+  deque_.pop_back();
+  if (deque_.segment_count() == blocks) {
+    back_stale_ = true;
+    return;
+  }
+  summaries_.pop_back();
+  back_stale_ = false;
+  front_stale_ = front_stale_ && !empty();
+}
+
+template <typename T, typename Monoid, typename Allocator>
+void SummaryDeque<T, Monoid, Allocator>::pop_front() {
+  if (empty()) {
+    return;
+  }
+  size_t blocks = deque_.segment_count();
+  deque_.pop_front();
+  if (deque_.segment_count() == blocks) {
+    front_stale_ = true;
+    return;
+  }
+  summaries_.pop_front();
+  front_stale_ = false;
+  back_stale_ = back_stale_ && !empty();
+}
+
+template <typename T, typename Monoid, typename Allocator>
+void SummaryDeque<T, Monoid, Allocator>::clear() {
+  deque_.clear();
+  summaries_.clear();
+  front_stale_ = false;
+  back_stale_ = false;
+}
+
+template <typename T, typename Monoid, typename Allocator>
+void SummaryDeque<T, Monoid, Allocator>::insert(const_iterator pos,
+                                                const T& value) {
+  size_t idx = pos - begin();
+  if (idx == 0) {
+    emplace_front(value);
+    return;
+  }
+  if (idx == size()) {
+    emplace_back(value);
+    return;
+  }
+  size_t blocks = deque_.segment_count();
+  deque_.insert(deque_.begin() + idx, value);
+  if (deque_.segment_count() != blocks) {
+    summaries_.push_back(monoid_.identity());
+  }
+  refresh_from(deque_.segment_index(idx));
+}
+
+template <typename T, typename Monoid, typename Allocator>
+void SummaryDeque<T, Monoid, Allocator>::erase(const_iterator pos) {
+  size_t idx = pos - begin();
+  size_t blocks = deque_.segment_count();
+  deque_.erase(deque_.begin() + idx);
+  if (deque_.segment_count() != blocks) {
+    summaries_.pop_back();
+  }
+  if (empty()) {
+    front_stale_ = false;
+    back_stale_ = false;
+  } else if (idx < size()) {
+    refresh_from(deque_.segment_index(idx));
+  } else {
+    back_stale_ = true;
+  }
+}
+
+template <typename T, typename Monoid, typename Allocator>
+void SummaryDeque<T, Monoid, Allocator>::assign(size_t idx, T value) {
+  deque_.at(idx) = std::move(value);
+  size_t block = deque_.segment_index(idx);
+  summaries_[block] = fold(deque_.segment(block));
+  if (block == 0) {
+    front_stale_ = false;
+  }
+  if (block + 1 == deque_.segment_count()) {
+    back_stale_ = false;
+  }
+}
+
+template <typename T, typename Monoid, typename Allocator>
+const typename SummaryDeque<T, Monoid, Allocator>::summary_type&
+SummaryDeque<T, Monoid, Allocator>::block_summary(size_t idx) const {
+  sync();
+  return summaries_.at(idx);
+}
+
+template <typename T, typename Monoid, typename Allocator>
+typename SummaryDeque<T, Monoid, Allocator>::summary_type
+SummaryDeque<T, Monoid, Allocator>::reduce(size_t first, size_t last) const {
+  last = std::min(last, size());
+  if (first >= last) {
+    return monoid_.identity();
+  }
+  sync();
+  size_t head = deque_.segment_index(first);
+  size_t tail = deque_.segment_index(last - 1);
+  auto result = monoid_.identity();
+  for (size_t block = head; block <= tail; ++block) {
+    size_t offset = deque_.segment_offset(block);
+    auto span = deque_.segment(block);
+    size_t from = std::max(first, offset) - offset;
+    size_t to = std::min(last, offset + span.size()) - offset;
+    if (from == 0 && to == span.size()) {
+      result = monoid_.combine(result, summaries_[block]);
+    } else {
+      result = monoid_.combine(result, fold(span.subspan(from, to - from)));
+    }
+  }
+  return result;
+}
+
+template <typename T, typename Monoid, typename Allocator>
+template <typename BlockPred, typename Pred, typename Func>
+size_t SummaryDeque<T, Monoid, Allocator>::query(size_t first, size_t last,
+                                                 BlockPred may_match,
+                                                 Pred pred, Func func) const {
+  last = std::min(last, size());
+  if (first >= last) {
+    return 0;
+  }
+  sync();
+  size_t head = deque_.segment_index(first);
+  size_t tail = deque_.segment_index(last - 1);
+  size_t matched = 0;
+  for (size_t block = head; block <= tail; ++block) {
+    if (!may_match(summaries_[block])) {
+      continue;
+    }
+    size_t offset = deque_.segment_offset(block);
+    auto span = deque_.segment(block);
+    size_t from = std::max(first, offset) - offset;
+    size_t to = std::min(last, offset + span.size()) - offset;
+    for (const T& value : span.subspan(from, to - from)) {
+      if (pred(value)) {
+        func(value);
+        ++matched;
+      }
+    }
+  }
+  return matched;
+}
+
+template <typename T, typename Monoid, typename Allocator>
+typename SummaryDeque<T, Monoid, Allocator>::summary_type
+SummaryDeque<T, Monoid, Allocator>::fold(std::span<const T> span) const {
+  auto result = monoid_.identity();
+  for (const T& value : span) {
+    result = monoid_.combine(result, monoid_.lift(value));
+  }
+  return result;
+}
+
+// Recomputes the edge blocks left stale by pops.
+template <typename T, typename Monoid, typename Allocator>
+void SummaryDeque<T, Monoid, Allocator>::sync() const {
+  if (front_stale_) {
+    summaries_[0] = fold(deque_.segment(0));
+    front_stale_ = false;
+  }
+  if (back_stale_) {
+    size_t last = deque_.segment_count() - 1;
+    summaries_[last] = fold(deque_.segment(last));
+    back_stale_ = false;
+  }
+}
+
+template <typename T, typename Monoid, typename Allocator>
+void SummaryDeque<T, Monoid, Allocator>::refresh_from(size_t block) {
+  size_t blocks = deque_.segment_count();
+  for (size_t idx = block; idx < blocks; ++idx) {
+    summaries_[idx] = fold(deque_.segment(idx));
+  }
+  back_stale_ = false;
+  front_stale_ = front_stale_ && block != 0;
+}
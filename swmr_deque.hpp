@@ -0,0 +1,430 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "deque.hpp"
+
+// Deque with one writer thread and any number of reader threads that never
+// lock. Elements are addressed by absolute index, as in SequencedDeque, and
+// live in fixed-size blocks found through a block map. The writer publishes
+// begin_, end_ and the map with release stores. A reader pins the current
+// epoch and loads them once, and then owns a consistent view of [begin, end)
+// until it unpins.
+//
+// Nothing a reader can reach is freed or overwritten while it is pinned.
+// Elements are never modified after they are published, and popping only
+// moves begin_. A block leaves once begin_ has passed it, and a map leaves
+// once a bigger one replaces it. Both are retired with the epoch of the
+// moment they were unlinked and are reclaimed once the epoch has advanced
+// twice since. The writer advances the epoch only when every pinned reader
+// has seen the current one, so it never waits for readers. It does that
+// check once per retired block, and the per-element path is one release
+// store.
+template <typename T, typename Allocator = std::allocator<T>>
+class SwmrDeque {
+ private:
+  struct Map;
+  struct ReaderSlot;
+
+ public:
+  class Reader;
+  class Snapshot;
+
+  using value_type = T;
+
+  static constexpr size_t kBlockSize =
+      std::bit_floor(std::max<size_t>(16, 4096 / sizeof(T)));
+  static constexpr size_t kMaxReaders = 128;
+
+  SwmrDeque() : SwmrDeque(Allocator()) {}
+
+  explicit SwmrDeque(const Allocator& alloc);
+
+  SwmrDeque(const SwmrDeque&) = delete;
+  SwmrDeque& operator=(const SwmrDeque&) = delete;
+
+  // No Reader may outlive the deque.
+  ~SwmrDeque();
+
+  // Everything below is for the writer thread only.
+
+  [[nodiscard]] size_t size() const {
+    return end_.load(std::memory_order_relaxed) -
+           begin_.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] bool empty() const { return size() == 0; }
+
+  // Absolute index of the first element, and the one the next push gets.
+  [[nodiscard]] uint64_t first_index() const {
+    return begin_.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] uint64_t next_index() const {
+    return end_.load(std::memory_order_relaxed);
+  }
+
+  // Both require !empty().
+  const T& front() const { return element(first_index()); }
+  const T& back() const { return element(next_index() - 1); }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args);
+  void push_back(const T& value) { emplace_back(value); }
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+
+  // Popped elements are destroyed when their block is reclaimed.
+  void pop_front() { pop_front(1); }
+  // Pops min(count, size()) elements.
+  void pop_front(size_t count);
+
+ private:
+  using alloc_traits = std::allocator_traits<Allocator>;
+  using block_alloc = typename alloc_traits::template rebind_alloc<T*>;
+  using block_alloc_traits = std::allocator_traits<block_alloc>;
+  using map_alloc = typename alloc_traits::template rebind_alloc<Map>;
+  using map_alloc_traits = std::allocator_traits<map_alloc>;
+
+  static constexpr size_t kCacheLine = 64;
+  static constexpr size_t kMinMapBlocks = 16;
+  // Reclaimed blocks kept for reuse instead of being deallocated.
+  static constexpr size_t kSpareBlocks = 4;
+  static constexpr uint64_t kIdle = UINT64_MAX;
+
+  // Covers blocks [first_block, first_block + capacity). A slot is written
+  // once, before end_ first reaches its block, and never changes after.
+  struct Map {
+    uint64_t first_block;
+    size_t capacity;
+    T** blocks;
+  };
+
+  struct alignas(kCacheLine) ReaderSlot {
+    std::atomic<uint64_t> epoch{kIdle};
+    std::atomic<bool> claimed{false};
+  };
+
+  // Exactly one of block and map is set.
+  struct Retired {
+    uint64_t epoch;
+    T* block;
+    Map* map;
+  };
+
+  static T& Lookup(const Map* map, uint64_t idx) {
+    return map->blocks[(idx / kBlockSize) - map->first_block]
+                      [idx % kBlockSize];
+  }
+
+  T& element(uint64_t idx) const {
+    return Lookup(map_.load(std::memory_order_relaxed), idx);
+  }
+
+  void add_block(uint64_t block);
+  Map* make_map(uint64_t first_block, size_t capacity);
+  void free_map(Map* map);
+  void retire(Retired garbage);
+  void collect();
+  void reclaim(const Retired& garbage);
+
+  [[no_unique_address]] Allocator alloc_;
+
+  // Shared with readers.
+  alignas(kCacheLine) std::atomic<Map*> map_{nullptr};
+  std::atomic<uint64_t> begin_{0};
+  std::atomic<uint64_t> end_{0};
+  alignas(kCacheLine) std::atomic<uint64_t> epoch_{0};
+  ReaderSlot slots_[kMaxReaders];
+
+  // Writer only.
+  Deque<Retired> retired_;
+  Deque<T*> spare_blocks_;
+};
+
+// A reader thread's claim on one of the deque's kMaxReaders slots. Claim it
+// once per thread and take a snapshot for every pass over the contents.
+template <typename T, typename Allocator>
+class SwmrDeque<T, Allocator>::Reader {
+ public:
+  // Throws std::length_error if all slots are taken.
+  explicit Reader(SwmrDeque& deque);
+
+  Reader(const Reader&) = delete;
+  Reader& operator=(const Reader&) = delete;
+
+  ~Reader() { slot_->claimed.store(false, std::memory_order_release); }
+
+  // At most one snapshot per reader may be alive at a time.
+  Snapshot snapshot() { return Snapshot(*deque_, *slot_); }
+
+ private:
+  SwmrDeque* deque_;
+  ReaderSlot* slot_{nullptr};
+};
+
+// The elements [first_index(), first_index() + size()) as of the moment the
+// snapshot was taken. Holding one keeps the writer from reclaiming anything,
+// so keep it short-lived.
+template <typename T, typename Allocator>
+class SwmrDeque<T, Allocator>::Snapshot {
+ public:
+  class Iterator;
+
+  Snapshot(const Snapshot&) = delete;
+  Snapshot& operator=(const Snapshot&) = delete;
+
+  ~Snapshot() { slot_.epoch.store(kIdle, std::memory_order_release); }
+
+  Iterator begin() const { return Iterator(map_, begin_); }
+  Iterator end() const { return Iterator(map_, end_); }
+
+  [[nodiscard]] size_t size() const { return end_ - begin_; }
+  [[nodiscard]] bool empty() const { return end_ == begin_; }
+  [[nodiscard]] uint64_t first_index() const { return begin_; }
+
+  const T& operator[](size_t idx) const { return Lookup(map_, begin_ + idx); }
+  const T& at(size_t idx) const;
+
+ private:
+  friend Reader;
+
+  Snapshot(const SwmrDeque& deque, ReaderSlot& slot);
+
+  ReaderSlot& slot_;
+  const Map* map_{nullptr};
+  uint64_t begin_{0};
+  uint64_t end_{0};
+};
+
+template <typename T, typename Allocator>
+class SwmrDeque<T, Allocator>::Snapshot::Iterator {
+ public:
+  using value_type = T;
+  using reference = const T&;
+  using pointer = const T*;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  Iterator() = default;
+  Iterator(const Map* map, uint64_t idx) : map_(map), idx_(idx) {}
+
+  const T& operator*() const { return Lookup(map_, idx_); }
+  const T* operator->() const { return &Lookup(map_, idx_); }
+
+  Iterator& operator++() {
+    ++idx_;
+    return *this;
+  }
+  Iterator operator++(int) {
+    auto copy = *this;
+    ++idx_;
+    return copy;
+  }
+
+  bool operator==(const Iterator& other) const { return idx_ == other.idx_; }
+
+ private:
+  const Map* map_{nullptr};
+  uint64_t idx_{0};
+};
+
+template <typename T, typename Allocator>
+SwmrDeque<T, Allocator>::SwmrDeque(const Allocator& alloc)
+    : alloc_(alloc) {}
+
+template <typename T, typename Allocator>
+SwmrDeque<T, Allocator>::~SwmrDeque() {
+  for (const auto& garbage : retired_) {
+    reclaim(garbage);
+  }
+  Map* map = map_.load(std::memory_order_relaxed);
+  if (map != nullptr) {
+    uint64_t begin = begin_.load(std::memory_order_relaxed);
+    uint64_t end = end_.load(std::memory_order_relaxed);
+    // Popped elements in the front block are still alive.
+    for (uint64_t idx = begin - (begin % kBlockSize); idx < end; ++idx) {
+      alloc_traits::destroy(alloc_, &Lookup(map, idx));
+    }
+    for (uint64_t block = begin / kBlockSize;
+         block < map->first_block + map->capacity; ++block) {
+      T* data = map->blocks[block - map->first_block];
+      if (data != nullptr) {
+        alloc_traits::deallocate(alloc_, data, kBlockSize);
+      }
+    }
+    free_map(map);
+  }
+  for (T* block : spare_blocks_) {
+    alloc_traits::deallocate(alloc_, block, kBlockSize);
+  }
+}
+
+template <typename T, typename Allocator>
+template <typename... Args>
+void SwmrDeque<T, Allocator>::emplace_back(Args&&... args) {
+  uint64_t end = end_.load(std::memory_order_relaxed);
+  if (end % kBlockSize == 0) {
+    add_block(end / kBlockSize);
+  }
+  alloc_traits::construct(alloc_, &element(end),
+                          std::forward<Args>(args)...);
+  end_.store(end + 1, std::memory_order_release);
+}
+
+template <typename T, typename Allocator>
+void SwmrDeque<T, Allocator>::pop_front(size_t count) {
+  uint64_t begin = begin_.load(std::memory_order_relaxed);
+  count = std::min<uint64_t>(count, end_.load(std::memory_order_relaxed) -
+                                        begin);
+  begin_.store(begin + count, std::memory_order_release);
+  Map* map = map_.load(std::memory_order_relaxed);
+  for (uint64_t block = begin / kBlockSize;
+       block < (begin + count) / kBlockSize; ++block) {
+    retire({0, map->blocks[block - map->first_block], nullptr});
+  }
+}
+
+// Puts a block in the map slot for absolute block number block, first
+// replacing the map if it has no slot for it. A slot that already holds a
+// block is left alone: a push that threw after add_block() left it there.
+template <typename T, typename Allocator>
+void SwmrDeque<T, Allocator>::add_block(uint64_t block) {
+  Map* map = map_.load(std::memory_order_relaxed);
+  if (map == nullptr || block - map->first_block == map->capacity) {
+    uint64_t first = begin_.load(std::memory_order_relaxed) / kBlockSize;
+    size_t live = block - first;
+    Map* grown =
+        make_map(first, std::max(kMinMapBlocks, std::bit_ceil(2 * (live + 1))));
+    if (map != nullptr) {
+      std::copy_n(map->blocks + (first - map->first_block), live,
+                  grown->blocks);
+    }
+    map_.store(grown, std::memory_order_release);
+    if (map != nullptr) {
+      retire({0, nullptr, map});
+    }
+    map = grown;
+  }
+  T*& slot = map->blocks[block - map->first_block];
+  if (slot != nullptr) {
+    return;
+  }
+  if (spare_blocks_.empty()) {
+    slot = alloc_traits::allocate(alloc_, kBlockSize);
+  } else {
+    slot = *(spare_blocks_.end() - 1);
+    spare_blocks_.pop_back();
+  }
+}
+
+template <typename T, typename Allocator>
+typename SwmrDeque<T, Allocator>::Map* SwmrDeque<T, Allocator>::make_map(
+    uint64_t first_block, size_t capacity) {
+  map_alloc maps(alloc_);
+  block_alloc slots(alloc_);
+  Map* map = map_alloc_traits::allocate(maps, 1);
+  try {
+    T** blocks = block_alloc_traits::allocate(slots, capacity);
+    std::fill_n(blocks, capacity, nullptr);
+    map_alloc_traits::construct(maps, map, Map{first_block, capacity, blocks});
+  } catch (...) {
+    map_alloc_traits::deallocate(maps, map, 1);
+    throw;
+  }
+  return map;
+}
+
+template <typename T, typename Allocator>
+void SwmrDeque<T, Allocator>::free_map(Map* map) {
+  map_alloc maps(alloc_);
+  block_alloc slots(alloc_);
+  block_alloc_traits::deallocate(slots, map->blocks, map->capacity);
+  map_alloc_traits::deallocate(maps, map, 1);
+}
+
+// The fence orders the unlinking store before the epoch and slot loads, and
+// pairs with the one a reader issues after announcing its epoch: either this
+// thread sees the announcement, or the reader sees the unlinked state.
+template <typename T, typename Allocator>
+void SwmrDeque<T, Allocator>::retire(Retired garbage) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  garbage.epoch = epoch_.load(std::memory_order_relaxed);
+  retired_.push_back(garbage);
+  collect();
+}
+
+// Advances the epoch if every pinned reader has seen the current one, then
+// reclaims what was retired at least two epochs ago.
+template <typename T, typename Allocator>
+void SwmrDeque<T, Allocator>::collect() {
+  uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+  bool quiescent = std::all_of(
+      std::begin(slots_), std::end(slots_), [epoch](const ReaderSlot& slot) {
+        uint64_t seen = slot.epoch.load(std::memory_order_acquire);
+        return seen == kIdle || seen == epoch;
+      });
+  if (quiescent) {
+    epoch_.store(++epoch, std::memory_order_release);
+  }
+  while (!retired_.empty() && retired_.begin()->epoch + 2 <= epoch) {
+    reclaim(*retired_.begin());
+    retired_.pop_front();
+  }
+}
+
+template <typename T, typename Allocator>
+void SwmrDeque<T, Allocator>::reclaim(const Retired& garbage) {
+  if (garbage.map != nullptr) {
+    free_map(garbage.map);
+    return;
+  }
+  for (size_t idx = 0; idx < kBlockSize; ++idx) {
+    alloc_traits::destroy(alloc_, garbage.block + idx);
+  }
+  if (spare_blocks_.size() < kSpareBlocks) {
+    spare_blocks_.push_back(garbage.block);
+  } else {
+    alloc_traits::deallocate(alloc_, garbage.block, kBlockSize);
+  }
+}
+
+template <typename T, typename Allocator>
+SwmrDeque<T, Allocator>::Reader::Reader(SwmrDeque& deque) : deque_(&deque) {
+  for (auto& slot : deque.slots_) {
+    bool expected = false;
+    if (!slot.claimed.load(std::memory_order_relaxed) &&
+        slot.claimed.compare_exchange_strong(expected, true,
+                                             std::memory_order_acquire)) {
+      slot_ = &slot;
+      return;
+    }
+  }
+  throw std::length_error("no free reader slot");
+}
+
+// end_ is loaded before the map, so the map covers every block below it, and
+// begin_ after the map, so the map also covers the first block.
+template <typename T, typename Allocator>
+SwmrDeque<T, Allocator>::Snapshot::Snapshot(const SwmrDeque& deque,
+                                            ReaderSlot& slot)
+    : slot_(slot) {
+  slot_.epoch.store(deque.epoch_.load(std::memory_order_acquire),
+                    std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  end_ = deque.end_.load(std::memory_order_acquire);
+  map_ = deque.map_.load(std::memory_order_acquire);
+  begin_ = std::min(deque.begin_.load(std::memory_order_acquire), end_);
+}
+
+template <typename T, typename Allocator>
+const T& SwmrDeque<T, Allocator>::Snapshot::at(size_t idx) const {
+  if (idx >= size()) {
+    throw std::out_of_range("out of range");
+  }
+  return (*this)[idx];
+}
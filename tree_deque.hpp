@@ -0,0 +1,924 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+
+// Deque for editable sequences. Blocks of elements are kept in an implicit
+// treap ordered by position, every node carrying the element count of its
+// subtree, so indexing, insert and erase anywhere are O(log n). The first and
+// the last block stay outside the treap, which keeps push and pop at both
+// ends O(1) amortized: a block only enters or leaves the treap once an edge
+// block has filled up or run dry.
+template <typename T, typename Allocator = std::allocator<T>>
+class TreeDeque {
+ private:
+  struct Node;
+
+  template <bool IsConst>
+  class Iterator;
+
+ public:
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  TreeDeque() = default;
+
+  TreeDeque(const Allocator& alloc);
+
+  TreeDeque(std::initializer_list<T> init,
+            const Allocator& alloc = Allocator());
+
+  TreeDeque(const TreeDeque& other);
+  TreeDeque(TreeDeque&& other) noexcept;
+
+  ~TreeDeque();
+
+  TreeDeque& operator=(const TreeDeque& other);
+  TreeDeque& operator=(TreeDeque&& other);
+
+  iterator begin() { return make_iterator<false>(0); }
+  const_iterator begin() const { return make_iterator<true>(0); }
+  const_iterator cbegin() const { return begin(); }
+
+  iterator end() { return make_iterator<false>(size_); }
+  const_iterator end() const { return make_iterator<true>(size_); }
+  const_iterator cend() const { return end(); }
+
+  reverse_iterator rbegin() { return std::make_reverse_iterator(end()); }
+  const_reverse_iterator rbegin() const {
+    return std::make_reverse_iterator(end());
+  }
+  const_reverse_iterator crbegin() const { return rbegin(); }
+
+  reverse_iterator rend() { return std::make_reverse_iterator(begin()); }
+  const_reverse_iterator rend() const {
+    return std::make_reverse_iterator(begin());
+  }
+  const_reverse_iterator crend() const { return rend(); }
+
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+  [[nodiscard]] Allocator get_allocator() const { return alloc_; }
+
+  T& operator[](size_t idx);
+  const T& operator[](size_t idx) const;
+
+  T& at(size_t idx);
+  const T& at(size_t idx) const;
+
+  template <typename... Args>
+  void emplace_back(Args&&... args);
+
+  template <typename... Args>
+  void emplace_front(Args&&... args);
+
+  void push_back(const T& value) { emplace_back(value); }
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+  void push_front(const T& value) { emplace_front(value); }
+  void push_front(T&& value) { emplace_front(std::move(value)); }
+
+  void pop_back();
+  void pop_front();
+
+  void clear();
+
+  iterator insert(const_iterator pos, const T& value);
+  iterator insert(const_iterator pos, T&& value);
+
+  template <typename... Args>
+  iterator emplace(const_iterator pos, Args&&... args);
+
+  iterator erase(const_iterator pos);
+
+ private:
+  using alloc_traits = std::allocator_traits<Allocator>;
+  using node_alloc = typename alloc_traits::template rebind_alloc<Node>;
+  using node_alloc_traits = typename alloc_traits::template rebind_traits<Node>;
+
+  static constexpr size_t kBlockSize =
+      std::bit_floor(std::max<size_t>(16, 1024 / sizeof(T)));
+  static constexpr size_t kEdge = SIZE_MAX;
+
+  struct Node {
+    Node* left{nullptr};
+    Node* right{nullptr};
+    Node* prev{nullptr};
+    Node* next{nullptr};
+    size_t total{0};
+    size_t nodes{1};
+    size_t first{0};
+    size_t count{0};
+    uint64_t priority{0};
+    T* data{nullptr};
+  };
+
+  struct Location {
+    Node* node;
+    size_t offset;
+    size_t rank;
+  };
+
+  // Treap over block positions.
+  static size_t total(const Node* node) { return node ? node->total : 0; }
+  static size_t nodes(const Node* node) { return node ? node->nodes : 0; }
+  static void update(Node* node);
+  static Node* merge(Node* lhs, Node* rhs);
+  static void split(Node* node, size_t rank, Node*& lhs, Node*& rhs);
+  void insert_node(size_t rank, Node* node);
+  Node* remove_node(size_t rank);
+  void adjust(size_t rank, ptrdiff_t delta);
+  Location locate(size_t idx) const;
+
+  template <bool IsConst>
+  Iterator<IsConst> make_iterator(size_t idx) const;
+
+  // Blocks.
+  Node* create_node(size_t first);
+  void destroy_node(Node* node);
+  static void link_after(Node* pos, Node* node);
+  static void unlink(Node* node);
+  void init_edges();
+  void move_elements(T* from, size_t count, T* to);
+  void recenter(Node* node, size_t first);
+  void insert_in_block(Node* node, size_t offset, T&& value);
+  void erase_in_block(Node* node, size_t offset);
+  void split_back_edge();
+  void split_front_edge();
+  void split_tree_node(Node* node, size_t rank);
+  void merge_with_next(Node* node, size_t rank);
+  void steal(TreeDeque& other);
+
+  Node* root_{nullptr};
+  Node* front_{nullptr};
+  Node* back_{nullptr};
+  size_t size_{0};
+  uint64_t seed_{0x9E3779B97F4A7C15ULL};
+
+  [[no_unique_address]] Allocator alloc_;
+  [[no_unique_address]] node_alloc node_alloc_;
+};
+
+template <typename T, typename Allocator>
+template <bool IsConst>
+class TreeDeque<T, Allocator>::Iterator {
+ public:
+  using value_type = std::conditional_t<IsConst, const T, T>;
+  using pointer = value_type*;
+  using reference = value_type&;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::random_access_iterator_tag;
+  using iterator_concept = std::random_access_iterator_tag;
+
+  Iterator() = default;
+  Iterator(const TreeDeque* owner, Node* node, size_t offset, size_t idx)
+      : owner_(owner), node_(node), offset_(offset), idx_(idx) {}
+
+  reference operator*() const { return node_->data[node_->first + offset_]; }
+  pointer operator->() const { return &**this; }
+  reference operator[](difference_type value) const {
+    return *(*this + value);
+  }
+
+  Iterator& operator++();
+  Iterator operator++(int) {
+    auto copy = *this;
+    ++*this;
+    return copy;
+  }
+  Iterator& operator--();
+  Iterator operator--(int) {
+    auto copy = *this;
+    --*this;
+    return copy;
+  }
+
+  Iterator& operator+=(difference_type value);
+  Iterator& operator-=(difference_type value) { return *this += -value; }
+  Iterator operator+(difference_type value) const {
+    auto copy = *this;
+    copy += value;
+    return copy;
+  }
+  friend Iterator operator+(difference_type value, const Iterator& iter) {
+    return iter + value;
+  }
+  Iterator operator-(difference_type value) const {
+    auto copy = *this;
+    copy -= value;
+    return copy;
+  }
+  difference_type operator-(const Iterator& other) const {
+    return static_cast<difference_type>(idx_) -
+           static_cast<difference_type>(other.idx_);
+  }
+
+  bool operator==(const Iterator& other) const { return idx_ == other.idx_; }
+  auto operator<=>(const Iterator& other) const { return idx_ <=> other.idx_; }
+
+  operator Iterator<true>() const {
+    return Iterator<true>(owner_, node_, offset_, idx_);
+  }
+
+ private:
+  friend class TreeDeque;
+
+  const TreeDeque* owner_{nullptr};
+  Node* node_{nullptr};
+  size_t offset_{0};
+  size_t idx_{0};
+};
+
+// TreeDeque
+
+template <typename T, typename Allocator>
+TreeDeque<T, Allocator>::TreeDeque(const Allocator& alloc)
+    : alloc_(alloc), node_alloc_(alloc) {}
+
+template <typename T, typename Allocator>
+TreeDeque<T, Allocator>::TreeDeque(std::initializer_list<T> init,
+                                   const Allocator& alloc)
+    : alloc_(alloc), node_alloc_(alloc) {
+  try {
+    for (const auto& value : init) {
+      emplace_back(value);
+    }
+  } catch (...) {
+    clear();
+    throw;
+  }
+}
+
+template <typename T, typename Allocator>
+TreeDeque<T, Allocator>::TreeDeque(const TreeDeque& other)
+    : alloc_(alloc_traits::select_on_container_copy_construction(
+          other.alloc_)),
+      node_alloc_(alloc_) {
+  try {
+    for (const auto& value : other) {
+      emplace_back(value);
+    }
+  } catch (...) {
+    clear();
+    throw;
+  }
+}
+
+template <typename T, typename Allocator>
+TreeDeque<T, Allocator>::TreeDeque(TreeDeque&& other) noexcept
+    : alloc_(std::move(other.alloc_)), node_alloc_(alloc_) {
+  steal(other);
+}
+
+template <typename T, typename Allocator>
+TreeDeque<T, Allocator>::~TreeDeque() {
+  clear();
+}
+
+template <typename T, typename Allocator>
+TreeDeque<T, Allocator>& TreeDeque<T, Allocator>::operator=(
+    const TreeDeque& other) {
+  if (&other == this) {
+    return *this;
+  }
+  TreeDeque copy(other);
+  clear();
+  if (alloc_traits::propagate_on_container_copy_assignment::value) {
+    alloc_ = other.alloc_;
+    node_alloc_ = node_alloc(alloc_);
+  }
+  if (alloc_ == copy.alloc_) {
+    steal(copy);
+  } else {
+    for (auto& value : copy) {
+      emplace_back(std::move(value));
+    }
+  }
+  return *this;
+}
+
+template <typename T, typename Allocator>
+TreeDeque<T, Allocator>& TreeDeque<T, Allocator>::operator=(
+    TreeDeque&& other) {
+  if (&other == this) {
+    return *this;
+  }
+  clear();
+  if (alloc_traits::propagate_on_container_move_assignment::value) {
+    alloc_ = std::move(other.alloc_);
+    node_alloc_ = node_alloc(alloc_);
+  }
+  if (alloc_ == other.alloc_) {
+    steal(other);
+    return *this;
+  }
+  try {
+    for (auto& value : other) {
+      emplace_back(std::move(value));
+    }
+  } catch (...) {
+    clear();
+    throw;
+  }
+  other.clear();
+  return *this;
+}
+
+template <typename T, typename Allocator>
+T& TreeDeque<T, Allocator>::operator[](size_t idx) {
+  Location loc = locate(idx);
+  return loc.node->data[loc.node->first + loc.offset];
+}
+
+template <typename T, typename Allocator>
+const T& TreeDeque<T, Allocator>::operator[](size_t idx) const {
+  Location loc = locate(idx);
+  return loc.node->data[loc.node->first + loc.offset];
+}
+
+template <typename T, typename Allocator>
+T& TreeDeque<T, Allocator>::at(size_t idx) {
+  if (idx >= size_) {
+    throw std::out_of_range("out of range");
+  }
+  return (*this)[idx];
+}
+
+template <typename T, typename Allocator>
+const T& TreeDeque<T, Allocator>::at(size_t idx) const {
+  if (idx >= size_) {
+    throw std::out_of_range("out of range");
+  }
+  return (*this)[idx];
+}
+
+template <typename T, typename Allocator>
+template <typename... Args>
+void TreeDeque<T, Allocator>::emplace_back(Args&&... args) {
+  if (back_ == nullptr) {
+    init_edges();
+  }
+  if (back_->first + back_->count < kBlockSize) {
+    alloc_traits::construct(alloc_, back_->data + back_->first + back_->count,
+                            std::forward<Args>(args)...);
+    ++back_->count;
+  } else {
+    // Built first, since args may refer to an element about to be moved.
+    T value(std::forward<Args>(args)...);
+    if (back_->count == kBlockSize) {
+      split_back_edge();
+    }
+    insert_in_block(back_, back_->count, std::move(value));
+  }
+  ++size_;
+}
+
+template <typename T, typename Allocator>
+template <typename... Args>
+void TreeDeque<T, Allocator>::emplace_front(Args&&... args) {
+  if (front_ == nullptr) {
+    init_edges();
+  }
+  if (front_->first > 0) {
+    alloc_traits::construct(alloc_, front_->data + front_->first - 1,
+                            std::forward<Args>(args)...);
+    --front_->first;
+    ++front_->count;
+  } else {
+    // Built first, since args may refer to an element about to be moved.
+    T value(std::forward<Args>(args)...);
+    if (front_->count == kBlockSize) {
+      split_front_edge();
+    }
+    insert_in_block(front_, 0, std::move(value));
+  }
+  ++size_;
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::pop_back() {
+  if (size_ == 0) {
+    return;
+  }
+  if (back_->count == 0) {
+    if (root_ == nullptr) {
+      erase_in_block(front_, front_->count - 1);
+      --size_;
+      return;
+    }
+    Node* last = remove_node(nodes(root_) - 1);
+    unlink(back_);
+    destroy_node(back_);
+    back_ = last;
+  }
+  erase_in_block(back_, back_->count - 1);
+  --size_;
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::pop_front() {
+  if (size_ == 0) {
+    return;
+  }
+  if (front_->count == 0) {
+    if (root_ == nullptr) {
+      erase_in_block(back_, 0);
+      --size_;
+      return;
+    }
+    Node* first = remove_node(0);
+    unlink(front_);
+    destroy_node(front_);
+    front_ = first;
+  }
+  erase_in_block(front_, 0);
+  --size_;
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::clear() {
+  for (Node* node = front_; node != nullptr;) {
+    Node* next = node->next;
+    destroy_node(node);
+    node = next;
+  }
+  root_ = nullptr;
+  front_ = nullptr;
+  back_ = nullptr;
+  size_ = 0;
+}
+
+template <typename T, typename Allocator>
+typename TreeDeque<T, Allocator>::iterator TreeDeque<T, Allocator>::insert(
+    const_iterator pos, const T& value) {
+  return emplace(pos, value);
+}
+
+template <typename T, typename Allocator>
+typename TreeDeque<T, Allocator>::iterator TreeDeque<T, Allocator>::insert(
+    const_iterator pos, T&& value) {
+  return emplace(pos, std::move(value));
+}
+
+template <typename T, typename Allocator>
+template <typename... Args>
+typename TreeDeque<T, Allocator>::iterator TreeDeque<T, Allocator>::emplace(
+    const_iterator pos, Args&&... args) {
+  size_t idx = pos.idx_;
+  if (idx == 0) {
+    emplace_front(std::forward<Args>(args)...);
+    return begin();
+  }
+  if (idx == size_) {
+    emplace_back(std::forward<Args>(args)...);
+    return end() - 1;
+  }
+  // Built first, since args may refer to an element about to be shifted.
+  T value(std::forward<Args>(args)...);
+  Location loc = locate(idx);
+  if (loc.node->count == kBlockSize) {
+    if (loc.node == back_) {
+      split_back_edge();
+    } else if (loc.node == front_) {
+      split_front_edge();
+    } else {
+      split_tree_node(loc.node, loc.rank);
+    }
+    loc = locate(idx);
+  }
+  insert_in_block(loc.node, loc.offset, std::move(value));
+  if (loc.rank != kEdge) {
+    adjust(loc.rank, 1);
+  }
+  ++size_;
+  return make_iterator<false>(idx);
+}
+
+template <typename T, typename Allocator>
+typename TreeDeque<T, Allocator>::iterator TreeDeque<T, Allocator>::erase(
+    const_iterator pos) {
+  size_t idx = pos.idx_;
+  if (idx >= size_) {
+    throw std::out_of_range("erase at end");
+  }
+  Location loc = locate(idx);
+  erase_in_block(loc.node, loc.offset);
+  --size_;
+  if (loc.rank != kEdge) {
+    adjust(loc.rank, -1);
+    if (loc.node->count == 0) {
+      remove_node(loc.rank);
+      unlink(loc.node);
+      destroy_node(loc.node);
+    } else {
+      merge_with_next(loc.node, loc.rank);
+    }
+  }
+  return make_iterator<false>(idx);
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::update(Node* node) {
+  node->total = node->count + total(node->left) + total(node->right);
+  node->nodes = 1 + nodes(node->left) + nodes(node->right);
+}
+
+template <typename T, typename Allocator>
+typename TreeDeque<T, Allocator>::Node* TreeDeque<T, Allocator>::merge(
+    Node* lhs, Node* rhs) {
+  if (lhs == nullptr) {
+    return rhs;
+  }
+  if (rhs == nullptr) {
+    return lhs;
+  }
+  if (lhs->priority > rhs->priority) {
+    lhs->right = merge(lhs->right, rhs);
+    update(lhs);
+    return lhs;
+  }
+  rhs->left = merge(lhs, rhs->left);
+  update(rhs);
+  return rhs;
+}
+
+// lhs receives the first `rank` blocks of node, rhs the rest.
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::split(Node* node, size_t rank, Node*& lhs,
+                                    Node*& rhs) {
+  if (node == nullptr) {
+    lhs = nullptr;
+    rhs = nullptr;
+    return;
+  }
+  if (nodes(node->left) >= rank) {
+    split(node->left, rank, lhs, node->left);
+    update(node);
+    rhs = node;
+  } else {
+    split(node->right, rank - nodes(node->left) - 1, node->right, rhs);
+    update(node);
+    lhs = node;
+  }
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::insert_node(size_t rank, Node* node) {
+  Node* lhs = nullptr;
+  Node* rhs = nullptr;
+  split(root_, rank, lhs, rhs);
+  root_ = merge(merge(lhs, node), rhs);
+}
+
+template <typename T, typename Allocator>
+typename TreeDeque<T, Allocator>::Node* TreeDeque<T, Allocator>::remove_node(
+    size_t rank) {
+  Node* lhs = nullptr;
+  Node* mid = nullptr;
+  Node* rhs = nullptr;
+  split(root_, rank, lhs, rhs);
+  split(rhs, 1, mid, rhs);
+  root_ = merge(lhs, rhs);
+  return mid;
+}
+
+// Adds delta to the subtree totals on the path to the block at rank.
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::adjust(size_t rank, ptrdiff_t delta) {
+  Node* node = root_;
+  while (true) {
+    node->total += delta;
+    size_t left = nodes(node->left);
+    if (rank == left) {
+      return;
+    }
+    if (rank < left) {
+      node = node->left;
+    } else {
+      rank -= left + 1;
+      node = node->right;
+    }
+  }
+}
+
+template <typename T, typename Allocator>
+typename TreeDeque<T, Allocator>::Location TreeDeque<T, Allocator>::locate(
+    size_t idx) const {
+  if (idx < front_->count) {
+    return {front_, idx, kEdge};
+  }
+  idx -= front_->count;
+  if (idx >= total(root_)) {
+    return {back_, idx - total(root_), kEdge};
+  }
+  Node* node = root_;
+  size_t rank = 0;
+  while (true) {
+    size_t left = total(node->left);
+    if (idx < left) {
+      node = node->left;
+    } else if (idx < left + node->count) {
+      return {node, idx - left, rank + nodes(node->left)};
+    } else {
+      idx -= left + node->count;
+      rank += nodes(node->left) + 1;
+      node = node->right;
+    }
+  }
+}
+
+template <typename T, typename Allocator>
+template <bool IsConst>
+typename TreeDeque<T, Allocator>::template Iterator<IsConst>
+TreeDeque<T, Allocator>::make_iterator(size_t idx) const {
+  if (idx == size_) {
+    return Iterator<IsConst>(this, nullptr, 0, idx);
+  }
+  Location loc = locate(idx);
+  return Iterator<IsConst>(this, loc.node, loc.offset, idx);
+}
+
+template <typename T, typename Allocator>
+typename TreeDeque<T, Allocator>::Node* TreeDeque<T, Allocator>::create_node(
+    size_t first) {
+  Node* node = node_alloc_traits::allocate(node_alloc_, 1);
+  try {
+    node_alloc_traits::construct(node_alloc_, node);
+    node->data = alloc_traits::allocate(alloc_, kBlockSize);
+  } catch (...) {
+    node_alloc_traits::deallocate(node_alloc_, node, 1);
+    throw;
+  }
+  seed_ ^= seed_ << 13;
+  seed_ ^= seed_ >> 7;
+  seed_ ^= seed_ << 17;
+  node->priority = seed_;
+  node->first = first;
+  return node;
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::destroy_node(Node* node) {
+  for (size_t idx = 0; idx < node->count; ++idx) {
+    alloc_traits::destroy(alloc_, node->data + node->first + idx);
+  }
+  alloc_traits::deallocate(alloc_, node->data, kBlockSize);
+  node_alloc_traits::destroy(node_alloc_, node);
+  node_alloc_traits::deallocate(node_alloc_, node, 1);
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::link_after(Node* pos, Node* node) {
+  node->prev = pos;
+  node->next = pos->next;
+  if (pos->next != nullptr) {
+    pos->next->prev = node;
+  }
+  pos->next = node;
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::unlink(Node* node) {
+  if (node->prev != nullptr) {
+    node->prev->next = node->next;
+  }
+  if (node->next != nullptr) {
+    node->next->prev = node->prev;
+  }
+  node->prev = nullptr;
+  node->next = nullptr;
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::init_edges() {
+  front_ = create_node(kBlockSize);
+  try {
+    back_ = create_node(0);
+  } catch (...) {
+    destroy_node(front_);
+    front_ = nullptr;
+    throw;
+  }
+  link_after(front_, back_);
+}
+
+// Moves count elements from `from` to `to`; the ranges may overlap.
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::move_elements(T* from, size_t count, T* to) {
+  if (to < from) {
+    for (size_t idx = 0; idx < count; ++idx) {
+      alloc_traits::construct(alloc_, to + idx, std::move(from[idx]));
+      alloc_traits::destroy(alloc_, from + idx);
+    }
+  } else if (to > from) {
+    for (size_t idx = count; idx > 0; --idx) {
+      alloc_traits::construct(alloc_, to + idx - 1, std::move(from[idx - 1]));
+      alloc_traits::destroy(alloc_, from + idx - 1);
+    }
+  }
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::recenter(Node* node, size_t first) {
+  move_elements(node->data + node->first, node->count, node->data + first);
+  node->first = first;
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::insert_in_block(Node* node, size_t offset,
+                                              T&& value) {
+  bool left_room = node->first > 0;
+  bool right_room = node->first + node->count < kBlockSize;
+  bool use_left = false;
+  if (offset == 0 && left_room) {
+    use_left = true;
+  } else if (offset == node->count && right_room) {
+    use_left = false;
+  } else if (offset == 0) {
+    recenter(node, kBlockSize - node->count);
+    use_left = true;
+  } else if (offset == node->count) {
+    recenter(node, 0);
+    use_left = false;
+  } else {
+    use_left = !right_room || (left_room && offset < node->count / 2);
+  }
+  T* base = node->data + node->first;
+  if (use_left) {
+    if (offset == 0) {
+      alloc_traits::construct(alloc_, base - 1, std::move(value));
+    } else {
+      alloc_traits::construct(alloc_, base - 1, std::move(base[0]));
+      std::move(base + 1, base + offset, base);
+      base[offset - 1] = std::move(value);
+    }
+    --node->first;
+  } else {
+    if (offset == node->count) {
+      alloc_traits::construct(alloc_, base + offset, std::move(value));
+    } else {
+      alloc_traits::construct(alloc_, base + node->count,
+                              std::move(base[node->count - 1]));
+      std::move_backward(base + offset, base + node->count - 1,
+                         base + node->count);
+      base[offset] = std::move(value);
+    }
+  }
+  ++node->count;
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::erase_in_block(Node* node, size_t offset) {
+  T* base = node->data + node->first;
+  if (offset < node->count / 2) {
+    std::move_backward(base, base + offset, base + offset + 1);
+    alloc_traits::destroy(alloc_, base);
+    ++node->first;
+  } else {
+    std::move(base + offset + 1, base + node->count, base + offset);
+    alloc_traits::destroy(alloc_, base + node->count - 1);
+  }
+  --node->count;
+  if (node->count == 0) {
+    node->first = node == front_ ? kBlockSize : 0;
+  }
+}
+
+// Turns the full back block into a treap block and starts a new back block
+// with its upper half.
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::split_back_edge() {
+  size_t keep = kBlockSize / 2;
+  Node* edge = create_node(0);
+  move_elements(back_->data + back_->first + keep, back_->count - keep,
+                edge->data);
+  edge->count = back_->count - keep;
+  back_->count = keep;
+  update(back_);
+  root_ = merge(root_, back_);
+  link_after(back_, edge);
+  back_ = edge;
+}
+
+// Turns the full front block into a treap block and starts a new front block
+// with its lower half.
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::split_front_edge() {
+  size_t moved = kBlockSize / 2;
+  Node* edge = create_node(kBlockSize - moved);
+  move_elements(front_->data + front_->first, moved, edge->data + edge->first);
+  edge->count = moved;
+  front_->first += moved;
+  front_->count -= moved;
+  update(front_);
+  root_ = merge(front_, root_);
+  link_after(front_, edge);
+  unlink(front_);
+  link_after(edge, front_);
+  front_ = edge;
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::split_tree_node(Node* node, size_t rank) {
+  size_t keep = kBlockSize / 2;
+  Node* upper = create_node(0);
+  move_elements(node->data + node->first + keep, node->count - keep,
+                upper->data);
+  upper->count = node->count - keep;
+  node->count = keep;
+  adjust(rank, -static_cast<ptrdiff_t>(upper->count));
+  update(upper);
+  insert_node(rank + 1, upper);
+  link_after(node, upper);
+}
+
+// Folds a sparse treap block into its successor's elements when both fit in
+// half a block, so that erasures do not leave long runs of tiny blocks.
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::merge_with_next(Node* node, size_t rank) {
+  if (node->count >= kBlockSize / 4 || rank + 1 >= nodes(root_)) {
+    return;
+  }
+  Node* next = node->next;
+  if (node->count + next->count > kBlockSize / 2) {
+    return;
+  }
+  recenter(node, 0);
+  move_elements(next->data + next->first, next->count,
+                node->data + node->count);
+  auto moved = static_cast<ptrdiff_t>(next->count);
+  node->count += next->count;
+  next->count = 0;
+  adjust(rank, moved);
+  adjust(rank + 1, -moved);
+  remove_node(rank + 1);
+  unlink(next);
+  destroy_node(next);
+}
+
+template <typename T, typename Allocator>
+void TreeDeque<T, Allocator>::steal(TreeDeque& other) {
+  root_ = other.root_;
+  front_ = other.front_;
+  back_ = other.back_;
+  size_ = other.size_;
+  other.root_ = nullptr;
+  other.front_ = nullptr;
+  other.back_ = nullptr;
+  other.size_ = 0;
+}
+
+// Iterator
+
+template <typename T, typename Allocator>
+template <bool IsConst>
+typename TreeDeque<T, Allocator>::template Iterator<IsConst>&
+TreeDeque<T, Allocator>::Iterator<IsConst>::operator++() {
+  ++idx_;
+  ++offset_;
+  if (offset_ == node_->count) {
+    offset_ = 0;
+    do {
+      node_ = node_->next;
+    } while (node_ != nullptr && node_->count == 0);
+  }
+  return *this;
+}
+
+template <typename T, typename Allocator>
+template <bool IsConst>
+typename TreeDeque<T, Allocator>::template Iterator<IsConst>&
+TreeDeque<T, Allocator>::Iterator<IsConst>::operator--() {
+  --idx_;
+  if (node_ != nullptr && offset_ > 0) {
+    --offset_;
+    return *this;
+  }
+  node_ = node_ == nullptr ? owner_->back_ : node_->prev;
+  while (node_->count == 0) {
+    node_ = node_->prev;
+  }
+  offset_ = node_->count - 1;
+  return *this;
+}
+
+template <typename T, typename Allocator>
+template <bool IsConst>
+typename TreeDeque<T, Allocator>::template Iterator<IsConst>&
+TreeDeque<T, Allocator>::Iterator<IsConst>::operator+=(
+    difference_type value) {
+  auto offset = static_cast<difference_type>(offset_) + value;
+  idx_ += value;
+  if (node_ != nullptr && offset >= 0 &&
+      offset < static_cast<difference_type>(node_->count)) {
+    offset_ = offset;
+    return *this;
+  }
+  *this = owner_->template make_iterator<IsConst>(idx_);
+  return *this;
+}
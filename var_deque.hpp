@@ -0,0 +1,485 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "deque.hpp"
+
+// How VarDeque treats a record that does not fit in the rest of its block.
+enum class RecordLayout {
+  // Pad the rest of the block and start the record in the next one, so
+  // every record is one contiguous span.
+  kPad,
+  // Continue the record in the next block, wasting no space. Views are
+  // then two spans, the second empty unless the record was split.
+  kSplit,
+};
+
+// Deque of variable-length byte records packed into large blocks. Like
+// Deque, it keeps a map of fixed-size blocks (here a Deque of block
+// pointers) and grows at both ends by adding blocks, but the blocks hold a
+// byte stream rather than elements. Each record is its length, the bytes
+// padded to 4, and its length again, so it can be stepped over from either
+// end. Pushing a record costs no allocation unless it opens a new block, and
+// one emptied block is kept back for the next one that is needed.
+//
+// Records may be at most max_record_size() bytes, so that a split record
+// spans two blocks at most.
+template <RecordLayout Layout = RecordLayout::kPad,
+          typename Allocator = std::allocator<std::byte>>
+class VarDeque {
+ private:
+  class Iterator;
+
+ public:
+  // A record that may continue in the next block. tail is empty unless it
+  // does.
+  struct SplitRecord {
+    std::span<const std::byte> head;
+    std::span<const std::byte> tail;
+
+    [[nodiscard]] size_t size() const { return head.size() + tail.size(); }
+    void copy_to(std::byte* out) const {
+      std::copy(head.begin(), head.end(), out);
+      std::copy(tail.begin(), tail.end(), out + head.size());
+    }
+  };
+
+  using value_type =
+      std::conditional_t<Layout == RecordLayout::kPad,
+                         std::span<const std::byte>, SplitRecord>;
+  using const_iterator = Iterator;
+  using iterator = const_iterator;
+
+  static constexpr size_t kDefaultBlockBytes = size_t{64} << 10;
+
+  // block_bytes is rounded up to a power of two, and to at least 16.
+  explicit VarDeque(size_t block_bytes = kDefaultBlockBytes,
+                    const Allocator& alloc = Allocator());
+
+  VarDeque(const VarDeque& other);
+  VarDeque(VarDeque&& other) noexcept;
+
+  ~VarDeque();
+
+  VarDeque& operator=(const VarDeque& other);
+  VarDeque& operator=(VarDeque&& other) noexcept;
+
+  const_iterator begin() const { return Iterator(this, head_); }
+  const_iterator end() const { return Iterator(this, tail_); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  // Number of records.
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+
+  [[nodiscard]] size_t block_bytes() const { return block_bytes_; }
+  [[nodiscard]] size_t max_record_size() const {
+    return block_bytes_ - (2 * kWord);
+  }
+
+  // Both require !empty(). Views stay valid until the record is popped.
+  value_type front() const { return view(head_); }
+  value_type back() const {
+    return view(tail_ - footprint(load(tail_ - kWord)));
+  }
+
+  // Both throw std::length_error for records over max_record_size().
+  void push_back(std::span<const std::byte> record);
+  void push_front(std::span<const std::byte> record);
+
+  void pop_back();
+  void pop_front();
+
+  void clear();
+
+  void swap(VarDeque& other) noexcept;
+
+ private:
+  using alloc_traits = std::allocator_traits<Allocator>;
+  using map_alloc = typename alloc_traits::template rebind_alloc<std::byte*>;
+
+  static constexpr size_t kWord = sizeof(uint32_t);
+  // Marks the length words of padding, which iteration steps over.
+  static constexpr uint32_t kPadBit = uint32_t{1} << 31;
+
+  static size_t footprint(uint32_t length) {
+    if (length & kPadBit) {
+      return length & ~kPadBit;
+    }
+    return (2 * kWord) + ((length + kWord - 1) & ~(kWord - 1));
+  }
+
+  size_t block_of(size_t pos) const {
+    return pos >> std::countr_zero(block_bytes_);
+  }
+  size_t offset_of(size_t pos) const { return pos & (block_bytes_ - 1); }
+
+  uint32_t load(size_t pos) const;
+  void store(size_t pos, const void* src, size_t count);
+  void store_word(size_t pos, uint32_t word) { store(pos, &word, kWord); }
+  void store_record(size_t pos, std::span<const std::byte> record);
+  void store_pad(size_t pos, size_t count);
+
+  value_type view(size_t pos) const;
+  size_t skip_pad_forward(size_t pos) const;
+  size_t skip_pad_backward(size_t pos) const;
+  size_t next(size_t pos) const;
+  size_t prev(size_t pos) const;
+
+  std::byte* take_block();
+  void give_block(std::byte* block);
+  void release_blocks();
+  void trim();
+
+  [[no_unique_address]] Allocator alloc_;
+  Deque<std::byte*, map_alloc> map_;
+  std::byte* spare_{nullptr};
+  size_t block_bytes_;
+  // Byte positions counted from the start of the first block in map_.
+  // Neither ever rests on padding.
+  size_t head_{0};
+  size_t tail_{0};
+  size_t size_{0};
+};
+
+template <RecordLayout Layout, typename Allocator>
+class VarDeque<Layout, Allocator>::Iterator {
+ public:
+  using value_type = VarDeque::value_type;
+  using reference = value_type;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::input_iterator_tag;
+  using iterator_concept = std::bidirectional_iterator_tag;
+
+  Iterator() = default;
+  Iterator(const VarDeque* owner, size_t pos) : owner_(owner), pos_(pos) {}
+
+  value_type operator*() const { return owner_->view(pos_); }
+
+  Iterator& operator++() {
+    pos_ = owner_->next(pos_);
+    return *this;
+  }
+  Iterator operator++(int) {
+    auto copy = *this;
+    ++*this;
+    return copy;
+  }
+  Iterator& operator--() {
+    pos_ = owner_->prev(pos_);
+    return *this;
+  }
+  Iterator operator--(int) {
+    auto copy = *this;
+    --*this;
+    return copy;
+  }
+
+  bool operator==(const Iterator& other) const { return pos_ == other.pos_; }
+
+ private:
+  const VarDeque* owner_{nullptr};
+  size_t pos_{0};
+};
+
+template <RecordLayout Layout, typename Allocator>
+VarDeque<Layout, Allocator>::VarDeque(size_t block_bytes,
+                                      const Allocator& alloc)
+    : alloc_(alloc),
+      map_(map_alloc(alloc)),
+      block_bytes_(std::bit_ceil(std::max<size_t>(16, block_bytes))) {}
+
+template <RecordLayout Layout, typename Allocator>
+VarDeque<Layout, Allocator>::VarDeque(const VarDeque& other)
+    : alloc_(alloc_traits::select_on_container_copy_construction(
+          other.alloc_)),
+      map_(map_alloc(alloc_)),
+      block_bytes_(other.block_bytes_),
+      head_(other.head_),
+      tail_(other.tail_),
+      size_(other.size_) {
+  try {
+    for (std::byte* block : other.map_) {
+      std::byte* copy = take_block();
+      std::memcpy(copy, block, block_bytes_);
+      try {
+        map_.push_back(copy);
+      } catch (...) {
+        give_block(copy);
+        throw;
+      }
+    }
+  } catch (...) {
+    release_blocks();
+    throw;
+  }
+}
+
+template <RecordLayout Layout, typename Allocator>
+VarDeque<Layout, Allocator>::VarDeque(VarDeque&& other) noexcept
+    : alloc_(std::move(other.alloc_)),
+      map_(std::move(other.map_)),
+      spare_(std::exchange(other.spare_, nullptr)),
+      block_bytes_(other.block_bytes_),
+      head_(std::exchange(other.head_, 0)),
+      tail_(std::exchange(other.tail_, 0)),
+      size_(std::exchange(other.size_, 0)) {}
+
+template <RecordLayout Layout, typename Allocator>
+VarDeque<Layout, Allocator>::~VarDeque() {
+  release_blocks();
+}
+
+template <RecordLayout Layout, typename Allocator>
+VarDeque<Layout, Allocator>& VarDeque<Layout, Allocator>::operator=(
+    const VarDeque& other) {
+  if (this != &other) {
+    VarDeque copy(other);
+    swap(copy);
+  }
+  return *this;
+}
+
+template <RecordLayout Layout, typename Allocator>
+VarDeque<Layout, Allocator>& VarDeque<Layout, Allocator>::operator=(
+    VarDeque&& other) noexcept {
+  VarDeque moved(std::move(other));
+  swap(moved);
+  return *this;
+}
+
+template <RecordLayout Layout, typename Allocator>
+void VarDeque<Layout, Allocator>::swap(VarDeque& other) noexcept {
+  std::swap(alloc_, other.alloc_);
+  std::swap(map_, other.map_);
+  std::swap(spare_, other.spare_);
+  std::swap(block_bytes_, other.block_bytes_);
+  std::swap(head_, other.head_);
+  std::swap(tail_, other.tail_);
+  std::swap(size_, other.size_);
+}
+
+template <RecordLayout Layout, typename Allocator>
+void VarDeque<Layout, Allocator>::push_back(
+    std::span<const std::byte> record) {
+  if (record.size() > max_record_size()) {
+    throw std::length_error("record larger than a block");
+  }
+  size_t total = footprint(record.size());
+  if constexpr (Layout == RecordLayout::kPad) {
+    size_t used = offset_of(tail_);
+    if (used != 0 && block_bytes_ - used < total) {
+      store_pad(tail_, block_bytes_ - used);
+      tail_ += block_bytes_ - used;
+    }
+  }
+  while (tail_ + total > map_.size() * block_bytes_) {
+    map_.push_back(take_block());
+  }
+  store_record(tail_, record);
+  tail_ += total;
+  ++size_;
+}
+
+template <RecordLayout Layout, typename Allocator>
+void VarDeque<Layout, Allocator>::push_front(
+    std::span<const std::byte> record) {
+  if (record.size() > max_record_size()) {
+    throw std::length_error("record larger than a block");
+  }
+  size_t total = footprint(record.size());
+  if constexpr (Layout == RecordLayout::kPad) {
+    size_t free = offset_of(head_);
+    if (free != 0 && free < total) {
+      head_ -= free;
+      store_pad(head_, free);
+    }
+  }
+  while (head_ < total) {
+    map_.push_front(take_block());
+    head_ += block_bytes_;
+    tail_ += block_bytes_;
+  }
+  head_ -= total;
+  store_record(head_, record);
+  ++size_;
+}
+
+template <RecordLayout Layout, typename Allocator>
+void VarDeque<Layout, Allocator>::pop_back() {
+  if (size_ == 0) {
+    return;
+  }
+  tail_ = skip_pad_backward(tail_ - footprint(load(tail_ - kWord)));
+  --size_;
+  trim();
+}
+
+template <RecordLayout Layout, typename Allocator>
+void VarDeque<Layout, Allocator>::pop_front() {
+  if (size_ == 0) {
+    return;
+  }
+  head_ = next(head_);
+  --size_;
+  trim();
+}
+
+template <RecordLayout Layout, typename Allocator>
+void VarDeque<Layout, Allocator>::clear() {
+  size_ = 0;
+  trim();
+}
+
+// Length words never straddle blocks: every position is a multiple of 4, and
+// so is block_bytes_.
+template <RecordLayout Layout, typename Allocator>
+uint32_t VarDeque<Layout, Allocator>::load(size_t pos) const {
+  uint32_t word = 0;
+  std::memcpy(&word, map_[block_of(pos)] + offset_of(pos), kWord);
+  return word;
+}
+
+template <RecordLayout Layout, typename Allocator>
+void VarDeque<Layout, Allocator>::store(size_t pos, const void* src,
+                                        size_t count) {
+  const auto* bytes = static_cast<const std::byte*>(src);
+  while (count > 0) {
+    size_t offset = offset_of(pos);
+    size_t step = std::min(count, block_bytes_ - offset);
+    std::memcpy(map_[block_of(pos)] + offset, bytes, step);
+    pos += step;
+    bytes += step;
+    count -= step;
+  }
+}
+
+template <RecordLayout Layout, typename Allocator>
+void VarDeque<Layout, Allocator>::store_record(
+    size_t pos, std::span<const std::byte> record) {
+  auto length = static_cast<uint32_t>(record.size());
+  store_word(pos, length);
+  store(pos + kWord, record.data(), record.size());
+  store_word(pos + footprint(length) - kWord, length);
+}
+
+// A pad of one word is its own head and tail.
+template <RecordLayout Layout, typename Allocator>
+void VarDeque<Layout, Allocator>::store_pad(size_t pos, size_t count) {
+  auto word = static_cast<uint32_t>(count) | kPadBit;
+  store_word(pos, word);
+  store_word(pos + count - kWord, word);
+}
+
+template <RecordLayout Layout, typename Allocator>
+typename VarDeque<Layout, Allocator>::value_type
+VarDeque<Layout, Allocator>::view(size_t pos) const {
+  size_t length = load(pos);
+  size_t first = pos + kWord;
+  const std::byte* data = map_[block_of(first)] + offset_of(first);
+  if constexpr (Layout == RecordLayout::kPad) {
+    return {data, length};
+  } else {
+    size_t head = std::min(length, block_bytes_ - offset_of(first));
+    if (head == length) {
+      return {{data, length}, {}};
+    }
+    return {{data, head}, {map_[block_of(first) + 1], length - head}};
+  }
+}
+
+template <RecordLayout Layout, typename Allocator>
+size_t VarDeque<Layout, Allocator>::skip_pad_forward(size_t pos) const {
+  if constexpr (Layout == RecordLayout::kPad) {
+    while (pos != tail_ && (load(pos) & kPadBit)) {
+      pos += footprint(load(pos));
+    }
+  }
+  return pos;
+}
+
+template <RecordLayout Layout, typename Allocator>
+size_t VarDeque<Layout, Allocator>::skip_pad_backward(size_t pos) const {
+  if constexpr (Layout == RecordLayout::kPad) {
+    while (pos != head_ && (load(pos - kWord) & kPadBit)) {
+      pos -= footprint(load(pos - kWord));
+    }
+  }
+  return pos;
+}
+
+// Start of the record after the one at pos.
+template <RecordLayout Layout, typename Allocator>
+size_t VarDeque<Layout, Allocator>::next(size_t pos) const {
+  return skip_pad_forward(pos + footprint(load(pos)));
+}
+
+// Start of the record before pos, which is a record start or tail_.
+template <RecordLayout Layout, typename Allocator>
+size_t VarDeque<Layout, Allocator>::prev(size_t pos) const {
+  pos = skip_pad_backward(pos);
+  return pos - footprint(load(pos - kWord));
+}
+
+template <RecordLayout Layout, typename Allocator>
+std::byte* VarDeque<Layout, Allocator>::take_block() {
+  if (spare_ != nullptr) {
+    return std::exchange(spare_, nullptr);
+  }
+  return alloc_traits::allocate(alloc_, block_bytes_);
+}
+
+template <RecordLayout Layout, typename Allocator>
+void VarDeque<Layout, Allocator>::give_block(std::byte* block) {
+  if (spare_ == nullptr) {
+    spare_ = block;
+  } else {
+    alloc_traits::deallocate(alloc_, block, block_bytes_);
+  }
+}
+
+template <RecordLayout Layout, typename Allocator>
+void VarDeque<Layout, Allocator>::release_blocks() {
+  for (std::byte* block : map_) {
+    alloc_traits::deallocate(alloc_, block, block_bytes_);
+  }
+  map_.clear();
+  if (spare_ != nullptr) {
+    alloc_traits::deallocate(alloc_, std::exchange(spare_, nullptr),
+                             block_bytes_);
+  }
+  head_ = 0;
+  tail_ = 0;
+  size_ = 0;
+}
+
+// Gives back the blocks that no longer hold any of [head_, tail_). An empty
+// deque starts over at position 0, so pushes never need padding there.
+template <RecordLayout Layout, typename Allocator>
+void VarDeque<Layout, Allocator>::trim() {
+  if (size_ == 0) {
+    head_ = 0;
+    tail_ = 0;
+  }
+  while (head_ >= block_bytes_) {
+    give_block(*map_.begin());
+    map_.pop_front();
+    head_ -= block_bytes_;
+    tail_ -= block_bytes_;
+  }
+  while ((map_.size() * block_bytes_) - tail_ >= block_bytes_) {
+    give_block(*(map_.end() - 1));
+    map_.pop_back();
+  }
+}
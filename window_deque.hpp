@@ -0,0 +1,165 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+#include "deque.hpp"
+#include "monoids.hpp"
+
+// FIFO window with a running aggregate. push_back(), pop_front() and
+// aggregate() are O(1) amortized.
+//
+// General monoids use the two-stack scheme: the older part of the window
+// carries suffix aggregates, the newer part one running aggregate, and when
+// the older part runs out the whole window is re-folded from the back.
+// Selective monoids (min, max) keep the classic monotonic deque of elements
+// that no newer element beats.
+template <typename T, typename Monoid, typename Allocator = std::allocator<T>>
+class WindowDeque {
+ public:
+  using value_type = T;
+  using summary_type = typename Monoid::value_type;
+  using const_iterator = typename Deque<T, Allocator>::const_iterator;
+
+  static constexpr bool kMonotonic = monoids::is_selective<Monoid>::value;
+
+  WindowDeque() = default;
+
+  explicit WindowDeque(Monoid monoid, const Allocator& alloc = Allocator());
+
+  const_iterator begin() const { return items_.begin(); }
+  const_iterator end() const { return items_.end(); }
+
+  [[nodiscard]] size_t size() const { return items_.size(); }
+  [[nodiscard]] bool empty() const { return items_.empty(); }
+
+  const T& operator[](size_t idx) const { return items_[idx]; }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args);
+
+  void push_back(const T& value) { emplace_back(value); }
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+
+  void pop_front();
+
+  // Pushes value, then drops the oldest elements until at most window
+  // remain.
+  void slide(T value, size_t window);
+
+  void clear();
+
+  // Fold of the whole window; identity() when empty.
+  [[nodiscard]] summary_type aggregate() const;
+
+ private:
+  using summary_alloc = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<summary_type>;
+  using index_alloc =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<size_t>;
+
+  void flip();
+
+  Deque<T, Allocator> items_;
+  // Two-stack: aggregates of items_[idx, older_.size()) for each idx.
+  Deque<summary_type, summary_alloc> older_;
+  summary_type newer_{Monoid().identity()};
+  // Monotonic: sequence numbers of the remaining candidates, oldest first.
+  Deque<size_t, index_alloc> candidates_;
+  size_t popped_{0};
+
+  [[no_unique_address]] Monoid monoid_;
+};
+
+template <typename T, typename Monoid, typename Allocator>
+WindowDeque<T, Monoid, Allocator>::WindowDeque(Monoid monoid,
+                                               const Allocator& alloc)
+    : items_(alloc),
+      older_(summary_alloc(alloc)),
+      newer_(monoid.identity()),
+      candidates_(index_alloc(alloc)),
+      monoid_(std::move(monoid)) {}
+
+template <typename T, typename Monoid, typename Allocator>
+template <typename... Args>
+void WindowDeque<T, Monoid, Allocator>::emplace_back(Args&&... args) {
+  items_.emplace_back(std::forward<Args>(args)...);
+  auto lifted = monoid_.lift(*(items_.end() - 1));
+  if constexpr (kMonotonic) {
+    while (!candidates_.empty()) {
+      auto last = monoid_.lift(items_[*(candidates_.end() - 1) - popped_]);
+      if (!(monoid_.combine(last, lifted) == lifted)) {
+        break;
+      }
+      candidates_.pop_back();
+    }
+    candidates_.push_back(popped_ + items_.size() - 1);
+  } else {
+    newer_ = monoid_.combine(newer_, lifted);
+  }
+}
+
+template <typename T, typename Monoid, typename Allocator>
+void WindowDeque<T, Monoid, Allocator>::pop_front() {
+  if (empty()) {
+    return;
+  }
+  if constexpr (kMonotonic) {
+    if (*candidates_.begin() == popped_) {
+      candidates_.pop_front();
+    }
+  } else {
+    if (older_.empty()) {
+      flip();
+    }
+    older_.pop_front();
+  }
+  items_.pop_front();
+  ++popped_;
+}
+
+template <typename T, typename Monoid, typename Allocator>
+void WindowDeque<T, Monoid, Allocator>::slide(T value, size_t window) {
+  emplace_back(std::move(value));
+  while (items_.size() > window) {
+    pop_front();
+  }
+}
+
+template <typename T, typename Monoid, typename Allocator>
+void WindowDeque<T, Monoid, Allocator>::clear() {
+  items_.clear();
+  older_.clear();
+  newer_ = monoid_.identity();
+  candidates_.clear();
+  popped_ = 0;
+}
+
+template <typename T, typename Monoid, typename Allocator>
+typename WindowDeque<T, Monoid, Allocator>::summary_type
+WindowDeque<T, Monoid, Allocator>::aggregate() const {
+  if constexpr (kMonotonic) {
+    if (candidates_.empty()) {
+      return monoid_.identity();
+    }
+    return monoid_.lift(items_[*candidates_.begin() - popped_]);
+  } else {
+    if (older_.empty()) {
+      return newer_;
+    }
+    return monoid_.combine(*older_.begin(), newer_);
+  }
+}
+
+// Moves every element to the older part, folding suffix aggregates from the
+// back.
+template <typename T, typename Monoid, typename Allocator>
+void WindowDeque<T, Monoid, Allocator>::flip() {
+  auto suffix = monoid_.identity();
+  for (auto iter = items_.end(); iter != items_.begin();) {
+    --iter;
+    suffix = monoid_.combine(monoid_.lift(*iter), suffix);
+    older_.push_front(suffix);
+  }
+  newer_ = monoid_.identity();
+}